@@ -0,0 +1,38 @@
+import sys
+
+import river
+
+# Echoes every record of one River stream into another, as soon as it arrives. Used to measure the round-trip latency
+# of the Redis path: put River Output in "Latency Probe" mode, run
+#
+#   python latency_echo.py <River Output stream name> <echo stream name>
+#
+# and point a River Events processor in the same signal chain at the echo stream. River Events logs a histogram of the
+# round trip, in samples and microseconds, when acquisition stops.
+if len(sys.argv) != 3:
+  print(f"Usage: {sys.argv[0]} <input stream> <output stream>")
+  sys.exit(1)
+
+input_stream, output_stream = sys.argv[1], sys.argv[2]
+
+connection = river.RedisConnection("127.0.0.1", 6379)
+r = river.StreamReader(connection)
+r.initialize(input_stream, 10000)
+
+# The echo keeps the probe schema, including the sent_us stamp, so the receiver can compute the round trip.
+w = river.StreamWriter(connection)
+w.initialize(output_stream, r.schema)
+
+# Read one record at a time: batching here would add to the latency being measured.
+data = r.new_buffer(1)
+
+with r, w:
+  while True:
+    num_read = r.read(data, 100)
+    if num_read > 0:
+      w.write(data[:num_read])
+    elif num_read == 0:
+      continue
+    else:
+      print('EOF encountered for stream', r.stream_name)
+      break
@@ -26,6 +26,9 @@
 #include <PluginInfo.h>
 
 #include "RiverOutput.h"
+#include "RiverInput.h"
+#include "RiverEventInput.h"
+#include "RiverReplay.h"
 
 #include <string>
 
@@ -38,7 +41,7 @@
 
 using namespace Plugin;
 //Number of plugins defined on the library. Can be of different types (Processors, RecordEngines, etc...)
-#define NUM_PLUGINS 1
+#define NUM_PLUGINS 4
 
 extern "C" EXPORT void getLibInfo(Plugin::LibraryInfo* info)
 {
@@ -66,6 +69,25 @@ extern "C" EXPORT int getPluginInfo(int index, Plugin::PluginInfo* info)
             info->processor.type = Plugin::Processor::SINK; //Type of processor. Can be FilterProcessor, SourceProcessor, SinkProcessor or UtilityProcessor. Specifies where on the processor list will appear
             info->processor.creator = &(Plugin::createProcessor<RiverOutput>); //Class factory pointer. Replace "ExampleProcessor" with the name of your class.
             break;
+
+        case 1:
+            info->type = Plugin::Type::DATA_THREAD;
+            info->dataThread.name = "River Input"; //Source name shown in the GUI
+            info->dataThread.creator = &(Plugin::createDataThread<RiverInput>); //Data thread factory pointer
+            break;
+
+        case 2:
+            info->type = Plugin::Type::PROCESSOR;
+            info->processor.name = "River Events";
+            info->processor.type = Plugin::Processor::FILTER;
+            info->processor.creator = &(Plugin::createProcessor<RiverEventInput>);
+            break;
+
+        case 3:
+            info->type = Plugin::Type::DATA_THREAD;
+            info->dataThread.name = "River Replay";
+            info->dataThread.creator = &(Plugin::createDataThread<RiverReplay>);
+            break;
             
         default:
             return -1;
@@ -0,0 +1,121 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "RiverChannels.h"
+
+#include <cstring>
+
+std::vector<RiverChannelField> RiverChannelField::fromSchema(const river::StreamSchema& schema,
+                                                             float bit_volts,
+                                                             const std::vector<float>& channel_bit_volts)
+{
+    std::vector<RiverChannelField> channels;
+    int offset = 0;
+    for (const auto& field : schema.field_definitions)
+    {
+        if (field.type == river::FieldDefinition::FLOAT)
+        {
+            channels.push_back({ field.name, offset, FLOAT32, 1.0f });
+        }
+        else if (field.type == river::FieldDefinition::DOUBLE)
+        {
+            channels.push_back({ field.name, offset, FLOAT64, 1.0f });
+        }
+        else if (field.type == river::FieldDefinition::FIXED_WIDTH_BYTES && field.size == 2)
+        {
+            size_t index = channels.size();
+            float scale = index < channel_bit_volts.size() ? channel_bit_volts[index] : bit_volts;
+            channels.push_back({ field.name, offset, INT16, scale });
+        }
+        offset += field.size;
+    }
+    return channels;
+}
+
+std::vector<float> RiverChannelField::parseScales(const std::string& list)
+{
+    std::vector<float> scales;
+    for (const String& token : StringArray::fromTokens(String(list), ",", ""))
+    {
+        scales.push_back(token.trim().getFloatValue());
+    }
+    return scales;
+}
+
+std::string RiverChannelField::formatScales(const std::vector<float>& scales)
+{
+    String list;
+    for (size_t i = 0; i < scales.size(); i++)
+    {
+        if (i > 0)
+        {
+            list << ",";
+        }
+        // Full precision, so readers reconstruct exactly the values that were quantized.
+        list << String(scales[i], 9);
+    }
+    return list.toStdString();
+}
+
+void RiverChannelField::convert(const std::vector<RiverChannelField>& channels,
+                                const char* records,
+                                int sample_size,
+                                int num_samples,
+                                float* frames)
+{
+    const int numChans = (int) channels.size();
+    for (int c = 0; c < numChans; c++)
+    {
+        const RiverChannelField& channel = channels[c];
+        const char* src = records + channel.offset;
+        float* dst = frames + c;
+
+        switch (channel.kind)
+        {
+            case FLOAT32:
+                for (int i = 0; i < num_samples; i++)
+                {
+                    float value;
+                    memcpy(&value, src + (size_t) i * sample_size, sizeof(value));
+                    dst[(size_t) i * numChans] = value;
+                }
+                break;
+            case FLOAT64:
+                for (int i = 0; i < num_samples; i++)
+                {
+                    double value;
+                    memcpy(&value, src + (size_t) i * sample_size, sizeof(value));
+                    dst[(size_t) i * numChans] = (float) value;
+                }
+                break;
+            case INT16:
+                for (int i = 0; i < num_samples; i++)
+                {
+                    int16 value;
+                    memcpy(&value, src + (size_t) i * sample_size, sizeof(value));
+                    dst[(size_t) i * numChans] = channel.scale * value;
+                }
+                break;
+        }
+    }
+}
@@ -0,0 +1,79 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __RIVERCHANNELS_H_8D3F2A96__
+#define __RIVERCHANNELS_H_8D3F2A96__
+
+#include <JuceHeader.h>
+#include "river/river.h"
+
+/** User metadata keys that the River sources read from a stream */
+namespace RiverMetadata
+{
+    inline constexpr char samplingRate[] = "sampling_rate";
+    inline constexpr char bitVolts[] = "bit_volts";
+
+    /** Comma-separated bit_volts of each channel, in field order; overrides bit_volts where present */
+    inline constexpr char channelBitVolts[] = "channel_bit_volts";
+}
+
+/**
+
+    Where one continuous channel is stored in a River stream sample, and how to turn it into a float.
+
+    Every FLOAT or DOUBLE field of a schema, and every 2-byte FIXED_WIDTH_BYTES field (read as int16 and scaled by
+    its channel's entry in `channel_bit_volts`, else by `bit_volts`), is a channel; other fields are ignored.
+
+*/
+struct RiverChannelField
+{
+    enum Kind { FLOAT32, FLOAT64, INT16 };
+
+    std::string name;
+    int offset;
+    Kind kind;
+    float scale;
+
+    /** The channels of `schema`, in field order */
+    static std::vector<RiverChannelField> fromSchema(const river::StreamSchema& schema,
+                                                     float bit_volts,
+                                                     const std::vector<float>& channel_bit_volts = {});
+
+    /** Parses a comma-separated list of scales, as stored under RiverMetadata::channelBitVolts */
+    static std::vector<float> parseScales(const std::string& list);
+
+    /** Formats scales for RiverMetadata::channelBitVolts */
+    static std::string formatScales(const std::vector<float>& scales);
+
+    /**
+     *  Converts `num_samples` consecutive stream samples of `sample_size` bytes each into `num_samples` frames of
+     *  interleaved floats, one per channel.
+     */
+    static void convert(const std::vector<RiverChannelField>& channels,
+                        const char* records,
+                        int sample_size,
+                        int num_samples,
+                        float* frames);
+};
+
+#endif  // __RIVERCHANNELS_H_8D3F2A96__
@@ -0,0 +1,432 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "RiverDsp.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RIVER_DSP_SSE2 1
+#endif
+
+// Four channels' worth of floats, for the kernels that vectorise across channels.
+#if defined(RIVER_DSP_SSE2)
+typedef __m128 Lanes;
+
+static inline Lanes lanesSplat(float x) { return _mm_set1_ps(x); }
+static inline Lanes lanesLoad(const float* p) { return _mm_loadu_ps(p); }
+static inline void lanesStore(float* p, Lanes a) { _mm_storeu_ps(p, a); }
+static inline Lanes lanesAdd(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+static inline Lanes lanesSub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+static inline Lanes lanesMul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+static inline Lanes lanesSqrt(Lanes a) { return _mm_sqrt_ps(a); }
+
+/** 1 in each lane where a > b, else 0 */
+static inline Lanes lanesGreater(Lanes a, Lanes b) { return _mm_and_ps(_mm_cmpgt_ps(a, b), _mm_set1_ps(1.0f)); }
+
+/** Sample `i` of each of the four channels */
+static inline Lanes lanesGather(const float* const* channels, int i)
+{
+    return _mm_setr_ps(channels[0][i], channels[1][i], channels[2][i], channels[3][i]);
+}
+#else
+struct Lanes
+{
+    float v[4];
+};
+
+template <typename Op>
+static inline Lanes lanesMap(Lanes a, Lanes b, Op op)
+{
+    Lanes r;
+    for (int k = 0; k < 4; k++)
+    {
+        r.v[k] = op(a.v[k], b.v[k]);
+    }
+    return r;
+}
+
+static inline Lanes lanesSplat(float x) { return Lanes{{x, x, x, x}}; }
+static inline Lanes lanesLoad(const float* p) { return Lanes{{p[0], p[1], p[2], p[3]}}; }
+static inline void lanesStore(float* p, Lanes a) { memcpy(p, a.v, sizeof(a.v)); }
+static inline Lanes lanesAdd(Lanes a, Lanes b) { return lanesMap(a, b, [](float x, float y) { return x + y; }); }
+static inline Lanes lanesSub(Lanes a, Lanes b) { return lanesMap(a, b, [](float x, float y) { return x - y; }); }
+static inline Lanes lanesMul(Lanes a, Lanes b) { return lanesMap(a, b, [](float x, float y) { return x * y; }); }
+static inline Lanes lanesSqrt(Lanes a) { return lanesMap(a, a, [](float x, float) { return std::sqrt(x); }); }
+static inline Lanes lanesGreater(Lanes a, Lanes b)
+{
+    return lanesMap(a, b, [](float x, float y) { return x > y ? 1.0f : 0.0f; });
+}
+static inline Lanes lanesGather(const float* const* channels, int i)
+{
+    return Lanes{{channels[0][i], channels[1][i], channels[2][i], channels[3][i]}};
+}
+#endif
+
+/** Dot product of `n` floats, `n` a multiple of 4 */
+static float dot4(const float* a, const float* b, int n)
+{
+#if defined(RIVER_DSP_SSE2)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    int k = 0;
+    for (; k + 8 <= n; k += 8)
+    {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + k), _mm_loadu_ps(b + k)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + k + 4), _mm_loadu_ps(b + k + 4)));
+    }
+    if (k < n)
+    {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + k), _mm_loadu_ps(b + k)));
+    }
+    acc0 = _mm_add_ps(acc0, acc1);
+    acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+    acc0 = _mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, 1));
+    return _mm_cvtss_f32(acc0);
+#else
+    float sum = 0.0f;
+    for (int k = 0; k < n; k++)
+    {
+        sum += a[k] * b[k];
+    }
+    return sum;
+#endif
+}
+
+PolyphaseDecimator::PolyphaseDecimator(int factor, int num_channels, int max_block_size)
+        : factor_(jmax(1, factor)),
+          num_channels_(num_channels),
+          max_block_size_(max_block_size),
+          num_taps_(kTapsPerFactor * jmax(1, factor) + 1)
+{
+    const int paddedTaps = (num_taps_ + 3) / 4 * 4;
+    history_size_ = paddedTaps - 1;
+
+    // Windowed sinc with its cutoff at 80% of the output Nyquist frequency, in cycles per input sample.
+    const double cutoff = 0.4 / factor_;
+    const double centre = (num_taps_ - 1) / 2.0;
+    std::vector<double> taps(num_taps_);
+    double sum = 0.0;
+    for (int n = 0; n < num_taps_; n++)
+    {
+        double x = n - centre;
+        double sinc = x == 0.0
+                      ? 2.0 * cutoff
+                      : std::sin(2.0 * MathConstants<double>::pi * cutoff * x) / (MathConstants<double>::pi * x);
+        double phase = 2.0 * MathConstants<double>::pi * n / (num_taps_ - 1);
+        double window = 0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2.0 * phase);
+        taps[n] = sinc * window;
+        sum += taps[n];
+    }
+
+    // Reverse the taps, so each output is a forward dot product over the most recent inputs, and normalise to unit
+    // gain at DC.
+    coefficients_.assign(paddedTaps, 0.0f);
+    for (int n = 0; n < num_taps_; n++)
+    {
+        coefficients_[paddedTaps - 1 - n] = (float) (taps[n] / sum);
+    }
+
+    work_.assign((size_t) num_channels_ * (history_size_ + max_block_size_), 0.0f);
+    outputs_.assign((size_t) num_channels_ * maxOutputs(), 0.0f);
+    for (int c = 0; c < num_channels_; c++)
+    {
+        output_pointers_.push_back(output(c));
+    }
+}
+
+void PolyphaseDecimator::reset()
+{
+    std::fill(work_.begin(), work_.end(), 0.0f);
+}
+
+int PolyphaseDecimator::process(const float* const* input, int num_samples, int64 first_sample,
+                                int64* first_output_sample)
+{
+    jassert(num_samples <= max_block_size_);
+
+    // Index within this block of the first sample whose number is a multiple of the factor.
+    const int firstOutput = (int) ((factor_ - first_sample % factor_) % factor_);
+    const int numOutputs = num_samples > firstOutput ? (num_samples - firstOutput + factor_ - 1) / factor_ : 0;
+    *first_output_sample = first_sample + firstOutput;
+
+    const int paddedTaps = (int) coefficients_.size();
+    const size_t stride = (size_t) history_size_ + max_block_size_;
+
+    for (int c = 0; c < num_channels_; c++)
+    {
+        float* work = work_.data() + c * stride;
+        memcpy(work + history_size_, input[c], sizeof(float) * num_samples);
+
+        float* out = outputs_.data() + (size_t) c * maxOutputs();
+        for (int j = 0; j < numOutputs; j++)
+        {
+            // The window ends at (and includes) the output's own input sample.
+            int end = history_size_ + firstOutput + j * factor_;
+            out[j] = dot4(coefficients_.data(), work + end - (paddedTaps - 1), paddedTaps);
+        }
+
+        // Keep the newest samples as history for the next block.
+        memmove(work, work + num_samples, sizeof(float) * history_size_);
+    }
+
+    return numOutputs;
+}
+
+/** RBJ cookbook Butterworth (Q = 1/sqrt(2)) biquad at `cutoff_hz`, as b0, b1, b2, a1, a2 normalised by a0 */
+static void butterworthBiquad(double cutoff_hz, double sample_rate, bool highpass, float* coefficients)
+{
+    const double w0 = 2.0 * MathConstants<double>::pi * cutoff_hz / sample_rate;
+    const double cosw = std::cos(w0);
+    const double alpha = std::sin(w0) / MathConstants<double>::sqrt2;
+    const double a0 = 1.0 + alpha;
+    const double b = highpass ? (1.0 + cosw) / 2.0 : (1.0 - cosw) / 2.0;
+
+    coefficients[0] = (float) (b / a0);
+    coefficients[1] = (float) ((highpass ? -2.0 * b : 2.0 * b) / a0);
+    coefficients[2] = (float) (b / a0);
+    coefficients[3] = (float) (-2.0 * cosw / a0);
+    coefficients[4] = (float) ((1.0 - alpha) / a0);
+}
+
+FeatureExtractor::FeatureExtractor(int num_channels,
+                                   double sample_rate,
+                                   int window_samples,
+                                   double band_low_hz,
+                                   double band_high_hz,
+                                   float threshold,
+                                   int max_block_size)
+        : num_channels_(num_channels),
+          padded_channels_((num_channels + 3) / 4 * 4),
+          window_samples_(jmax(1, window_samples)),
+          max_block_size_(max_block_size)
+{
+    // Keep both corners strictly inside (0, Nyquist), where the bilinear designs are stable.
+    const double nyquist = sample_rate / 2.0;
+    butterworthBiquad(jlimit(0.1, 0.95 * nyquist, band_low_hz), sample_rate, true, highpass_);
+    butterworthBiquad(jlimit(0.1, 0.95 * nyquist, band_high_hz), sample_rate, false, lowpass_);
+
+    threshold_sign_ = threshold < 0.0f ? -1.0f : 1.0f;
+    threshold_magnitude_ = std::abs(threshold);
+
+    state_.assign((size_t) padded_channels_ / 4 * kNumStates * 4, 0.0f);
+
+    // Padding channels read silence, so every group has four real inputs.
+    silence_.assign(max_block_size_, 0.0f);
+    inputs_.assign(padded_channels_, silence_.data());
+
+    outputs_.assign((size_t) kNumFeatures * padded_channels_ * maxOutputs(), 0.0f);
+    for (int f = 0; f < kNumFeatures; f++)
+    {
+        for (int c = 0; c < num_channels_; c++)
+        {
+            output_pointers_.push_back(output(f, c));
+        }
+    }
+}
+
+void FeatureExtractor::reset()
+{
+    std::fill(state_.begin(), state_.end(), 0.0f);
+    window_fill_ = 0;
+}
+
+int FeatureExtractor::process(const float* const* input, int num_samples, int64 first_sample,
+                              int64* first_output_sample)
+{
+    jassert(num_samples <= max_block_size_);
+
+    const int w = window_samples_;
+
+    // Index within this block of the first sample that ends a window.
+    const int firstEnd = (int) ((w - 1 - first_sample % w + w) % w);
+    const int numOutputs = num_samples > firstEnd ? (num_samples - 1 - firstEnd) / w + 1 : 0;
+    *first_output_sample = first_sample + firstEnd;
+
+    for (int c = 0; c < num_channels_; c++)
+    {
+        inputs_[c] = input[c];
+    }
+
+    const Lanes hb0 = lanesSplat(highpass_[0]), hb1 = lanesSplat(highpass_[1]), hb2 = lanesSplat(highpass_[2]);
+    const Lanes ha1 = lanesSplat(highpass_[3]), ha2 = lanesSplat(highpass_[4]);
+    const Lanes lb0 = lanesSplat(lowpass_[0]), lb1 = lanesSplat(lowpass_[1]), lb2 = lanesSplat(lowpass_[2]);
+    const Lanes la1 = lanesSplat(lowpass_[3]), la2 = lanesSplat(lowpass_[4]);
+    const Lanes sign = lanesSplat(threshold_sign_);
+    const Lanes magnitude = lanesSplat(threshold_magnitude_);
+    const Lanes one = lanesSplat(1.0f);
+    const Lanes zero = lanesSplat(0.0f);
+    const size_t featureStride = (size_t) padded_channels_ * maxOutputs();
+
+    for (int g = 0; g < padded_channels_; g += 4)
+    {
+        float* state = state_.data() + (size_t) g / 4 * kNumStates * 4;
+        Lanes hz1 = lanesLoad(state + 4 * kHighpassZ1), hz2 = lanesLoad(state + 4 * kHighpassZ2);
+        Lanes lz1 = lanesLoad(state + 4 * kLowpassZ1), lz2 = lanesLoad(state + 4 * kLowpassZ2);
+        Lanes sumSquares = lanesLoad(state + 4 * kSumSquares);
+        Lanes sumBandSquares = lanesLoad(state + 4 * kSumBandSquares);
+        Lanes crossings = lanesLoad(state + 4 * kNumCrossings);
+        Lanes wasBeyond = lanesLoad(state + 4 * kWasBeyond);
+
+        const float* const* channels = inputs_.data() + g;
+        float* groupOutputs = outputs_.data() + (size_t) g * maxOutputs();
+        int fill = window_fill_;
+        int nextEnd = firstEnd;
+        int j = 0;
+
+        auto step = [&](Lanes x, int i)
+        {
+            Lanes y = lanesAdd(lanesMul(hb0, x), hz1);
+            hz1 = lanesAdd(lanesSub(lanesMul(hb1, x), lanesMul(ha1, y)), hz2);
+            hz2 = lanesSub(lanesMul(hb2, x), lanesMul(ha2, y));
+
+            Lanes band = lanesAdd(lanesMul(lb0, y), lz1);
+            lz1 = lanesAdd(lanesSub(lanesMul(lb1, y), lanesMul(la1, band)), lz2);
+            lz2 = lanesSub(lanesMul(lb2, y), lanesMul(la2, band));
+
+            sumSquares = lanesAdd(sumSquares, lanesMul(x, x));
+            sumBandSquares = lanesAdd(sumBandSquares, lanesMul(band, band));
+
+            Lanes beyond = lanesGreater(lanesMul(sign, x), magnitude);
+            crossings = lanesAdd(crossings, lanesMul(beyond, lanesSub(one, wasBeyond)));
+            wasBeyond = beyond;
+
+            fill++;
+            if (i == nextEnd)
+            {
+                // Windows cut short by reset() are averaged over the samples they have.
+                Lanes scale = lanesSplat(1.0f / fill);
+                float values[kNumFeatures][4];
+                lanesStore(values[kRms], lanesSqrt(lanesMul(sumSquares, scale)));
+                lanesStore(values[kBandPower], lanesMul(sumBandSquares, scale));
+                lanesStore(values[kCrossings], crossings);
+                for (int f = 0; f < kNumFeatures; f++)
+                {
+                    for (int k = 0; k < 4; k++)
+                    {
+                        groupOutputs[f * featureStride + (size_t) k * maxOutputs() + j] = values[f][k];
+                    }
+                }
+
+                sumSquares = zero;
+                sumBandSquares = zero;
+                crossings = zero;
+                fill = 0;
+                nextEnd += w;
+                j++;
+            }
+        };
+
+        int i = 0;
+#if defined(RIVER_DSP_SSE2)
+        // Transpose 4x4 tiles so that each vector holds one sample of four channels.
+        for (; i + 4 <= num_samples; i += 4)
+        {
+            __m128 r0 = _mm_loadu_ps(channels[0] + i);
+            __m128 r1 = _mm_loadu_ps(channels[1] + i);
+            __m128 r2 = _mm_loadu_ps(channels[2] + i);
+            __m128 r3 = _mm_loadu_ps(channels[3] + i);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            step(r0, i);
+            step(r1, i + 1);
+            step(r2, i + 2);
+            step(r3, i + 3);
+        }
+#endif
+        for (; i < num_samples; i++)
+        {
+            step(lanesGather(channels, i), i);
+        }
+
+        lanesStore(state + 4 * kHighpassZ1, hz1);
+        lanesStore(state + 4 * kHighpassZ2, hz2);
+        lanesStore(state + 4 * kLowpassZ1, lz1);
+        lanesStore(state + 4 * kLowpassZ2, lz2);
+        lanesStore(state + 4 * kSumSquares, sumSquares);
+        lanesStore(state + 4 * kSumBandSquares, sumBandSquares);
+        lanesStore(state + 4 * kNumCrossings, crossings);
+        lanesStore(state + 4 * kWasBeyond, wasBeyond);
+    }
+
+    window_fill_ = numOutputs > 0 ? num_samples - 1 - (firstEnd + (numOutputs - 1) * w) : window_fill_ + num_samples;
+    return numOutputs;
+}
+
+ChannelHistory::ChannelHistory(int num_channels, int capacity)
+        : num_channels_(num_channels),
+          capacity_(jmax(1, capacity))
+{
+    data_.assign((size_t) num_channels_ * capacity_, 0.0f);
+}
+
+void ChannelHistory::reset()
+{
+    oldest_sample_ = 0;
+    end_sample_ = 0;
+}
+
+void ChannelHistory::write(const float* const* input, int num_samples, int64 first_sample)
+{
+    if (first_sample != end_sample_) {
+        oldest_sample_ = first_sample;
+    }
+    end_sample_ = first_sample + num_samples;
+    oldest_sample_ = jmax(oldest_sample_, end_sample_ - capacity_);
+
+    // Only the newest `capacity_` samples of a long block survive.
+    const int skip = jmax(0, num_samples - capacity_);
+    const int64 start = first_sample + skip;
+    const int n = num_samples - skip;
+    const int index = (int) (start % capacity_);
+    const int firstRun = jmin(n, capacity_ - index);
+
+    for (int c = 0; c < num_channels_; c++)
+    {
+        float* channel = data_.data() + (size_t) c * capacity_;
+        memcpy(channel + index, input[c] + skip, sizeof(float) * firstRun);
+        memcpy(channel, input[c] + skip + firstRun, sizeof(float) * (n - firstRun));
+    }
+}
+
+void ChannelHistory::read(int c, int64 first_sample, int num_samples, float* output) const
+{
+    const int64 start = jmax(first_sample, oldest_sample_);
+    const int64 end = jmin(first_sample + num_samples, end_sample_);
+    if (start >= end) {
+        std::fill(output, output + num_samples, 0.0f);
+        return;
+    }
+
+    const int before = (int) (start - first_sample);
+    const int n = (int) (end - start);
+    std::fill(output, output + before, 0.0f);
+    std::fill(output + before + n, output + num_samples, 0.0f);
+
+    const float* channel = data_.data() + (size_t) c * capacity_;
+    const int index = (int) (start % capacity_);
+    const int firstRun = jmin(n, capacity_ - index);
+    memcpy(output + before, channel + index, sizeof(float) * firstRun);
+    memcpy(output + before + firstRun, channel, sizeof(float) * (n - firstRun));
+}
@@ -0,0 +1,262 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __RIVERDSP_H_51C08E3D__
+#define __RIVERDSP_H_51C08E3D__
+
+#include <JuceHeader.h>
+
+#include <vector>
+
+/**
+
+    Anti-aliased decimation of a fixed set of planar float channels by an integer factor.
+
+    Each output is a dot product of a windowed-sinc lowpass (cutoff at 80% of the output Nyquist, Blackman window,
+    16 taps per unit of decimation) with the most recent inputs, and only every `factor`th output is computed: the
+    polyphase form, costing 16 multiply-adds per input sample and channel whatever the factor. The dot products use SSE
+    where available. Filter history carries over between calls, so a stream can be fed in blocks of any size up to
+    `max_block_size`.
+
+    Outputs are aligned to absolute sample numbers: one is produced for every input sample number that is a multiple
+    of `factor`, and lags the input by delaySamples() samples.
+
+*/
+class PolyphaseDecimator
+{
+public:
+    /** Filter length per unit of decimation */
+    static constexpr int kTapsPerFactor = 16;
+
+    /** Constructor */
+    PolyphaseDecimator(int factor, int num_channels, int max_block_size);
+
+    int factor() const {
+        return factor_;
+    }
+
+    /** Group delay of the filter, in input samples */
+    int delaySamples() const {
+        return (num_taps_ - 1) / 2;
+    }
+
+    /** Group delay of the filter used for `factor`, in input samples */
+    static int delaySamplesFor(int factor) {
+        return kTapsPerFactor * jmax(1, factor) / 2;
+    }
+
+    /** Largest number of outputs one call to process() can produce */
+    int maxOutputs() const {
+        return max_block_size_ / factor_ + 1;
+    }
+
+    /** Clears the filter history */
+    void reset();
+
+    /**
+     *  Filters `num_samples` (at most `max_block_size`) consecutive samples of every channel, the first being sample
+     *  `first_sample`. Writes the decimated samples to output(c) and returns how many there are; the first of them is
+     *  aligned to input sample `*first_output_sample`.
+     */
+    int process(const float* const* input, int num_samples, int64 first_sample, int64* first_output_sample);
+
+    /** Decimated samples of channel `c` from the last call to process() */
+    const float* output(int c) const {
+        return outputs_.data() + (size_t) c * maxOutputs();
+    }
+
+    /** Pointers to every channel's decimated samples, e.g. for river::internal::InterleaveFrames */
+    const float* const* outputs() const {
+        return output_pointers_.data();
+    }
+
+private:
+    const int factor_;
+    const int num_channels_;
+    const int max_block_size_;
+    const int num_taps_;
+
+    // Taps in reverse order, zero-padded at the front to a multiple of 4 so the dot product needs no scalar tail.
+    std::vector<float> coefficients_;
+    int history_size_;
+
+    // Per channel: history_size_ samples of history followed by room for one block.
+    std::vector<float> work_;
+    std::vector<float> outputs_;
+    std::vector<const float*> output_pointers_;
+
+    JUCE_DECLARE_NON_COPYABLE(PolyphaseDecimator)
+};
+
+/**
+
+    Per-channel features of planar float channels over fixed windows: RMS, mean power in a frequency band, and the
+    number of threshold crossings.
+
+    The band is a 2nd-order Butterworth highpass at `band_low_hz` followed by a 2nd-order Butterworth lowpass at
+    `band_high_hz`. A crossing is a sample beyond `threshold` (below it if negative, above it otherwise) whose
+    predecessor was not. Channels are processed four at a time with SSE where available, and filter state and partial
+    windows carry over between calls, so a stream can be fed in blocks of any size up to `max_block_size`.
+
+    Windows are aligned to absolute sample numbers: each covers `window_samples` samples starting at a multiple of
+    `window_samples`, and its features are labelled with the number of its last sample.
+
+*/
+class FeatureExtractor
+{
+public:
+    /** Features computed for each channel, in the order outputs() lists them */
+    enum Feature
+    {
+        kRms = 0,
+        kBandPower,
+        kCrossings,
+        kNumFeatures
+    };
+
+    /** Constructor */
+    FeatureExtractor(int num_channels,
+                     double sample_rate,
+                     int window_samples,
+                     double band_low_hz,
+                     double band_high_hz,
+                     float threshold,
+                     int max_block_size);
+
+    int windowSamples() const {
+        return window_samples_;
+    }
+
+    /** Largest number of windows one call to process() can complete */
+    int maxOutputs() const {
+        return max_block_size_ / window_samples_ + 1;
+    }
+
+    /** Clears the filter state and the partial window */
+    void reset();
+
+    /**
+     *  Consumes `num_samples` (at most `max_block_size`) consecutive samples of every channel, the first being sample
+     *  `first_sample`. Writes the features of every window completed by them to output() and returns how many windows
+     *  there are; the first of them ends at sample `*first_output_sample`.
+     */
+    int process(const float* const* input, int num_samples, int64 first_sample, int64* first_output_sample);
+
+    /** Values of `feature` for channel `c`, one per window completed by the last call to process() */
+    const float* output(int feature, int c) const {
+        return outputs_.data() + ((size_t) feature * padded_channels_ + c) * maxOutputs();
+    }
+
+    /**
+     *  Pointers to the outputs of every feature and channel, feature-major (all RMS values, then all band powers, then
+     *  all crossing counts), e.g. for river::internal::InterleaveFrames
+     */
+    const float* const* outputs() const {
+        return output_pointers_.data();
+    }
+
+private:
+    // Per-group state: 4 lanes each of highpass and lowpass biquad state, sums of squares and crossings.
+    enum State
+    {
+        kHighpassZ1 = 0,
+        kHighpassZ2,
+        kLowpassZ1,
+        kLowpassZ2,
+        kSumSquares,
+        kSumBandSquares,
+        kNumCrossings,
+        kWasBeyond,
+        kNumStates
+    };
+
+    const int num_channels_;
+    const int padded_channels_;
+    const int window_samples_;
+    const int max_block_size_;
+
+    // Transposed direct form II coefficients, normalised by a0: b0, b1, b2, a1, a2.
+    float highpass_[5];
+    float lowpass_[5];
+
+    // Crossings are counted on sign * sample > magnitude, so that one comparison handles either polarity.
+    float threshold_sign_;
+    float threshold_magnitude_;
+
+    std::vector<float> state_;
+    int window_fill_ = 0;
+
+    std::vector<float> silence_;
+    std::vector<const float*> inputs_;
+    std::vector<float> outputs_;
+    std::vector<const float*> output_pointers_;
+
+    JUCE_DECLARE_NON_COPYABLE(FeatureExtractor)
+};
+
+/**
+
+    The most recent `capacity` samples of a fixed set of planar float channels, indexed by absolute sample number, so
+    that a window around an event can be copied out once its later samples have arrived.
+
+*/
+class ChannelHistory
+{
+public:
+    /** Constructor */
+    ChannelHistory(int num_channels, int capacity);
+
+    int capacity() const {
+        return capacity_;
+    }
+
+    /** One past the number of the newest sample held */
+    int64 endSample() const {
+        return end_sample_;
+    }
+
+    /** Forgets every sample */
+    void reset();
+
+    /**
+     *  Appends `num_samples` consecutive samples of every channel, the first being sample `first_sample`. A gap in the
+     *  sample numbers discards everything held before it.
+     */
+    void write(const float* const* input, int num_samples, int64 first_sample);
+
+    /** Copies samples [`first_sample`, `first_sample` + `num_samples`) of channel `c`; samples not held read as 0 */
+    void read(int c, int64 first_sample, int num_samples, float* output) const;
+
+private:
+    const int num_channels_;
+    const int capacity_;
+
+    // Per channel, sample n is at index n % capacity_.
+    std::vector<float> data_;
+    int64 oldest_sample_ = 0;
+    int64 end_sample_ = 0;
+
+    JUCE_DECLARE_NON_COPYABLE(ChannelHistory)
+};
+
+#endif  // __RIVERDSP_H_51C08E3D__
@@ -0,0 +1,313 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "RiverEventInput.h"
+#include "RiverEventInputEditor.h"
+
+#include <cstring>
+
+using TtlRecord = RiverOutput::TtlEventSchema::Record;
+using ProbeRecord = RiverOutput::LatencyProbeSchema::Record;
+
+// Records buffered between the reader thread and the audio thread.
+static const int kQueueCapacity = 4096;
+
+// Records read per XREAD.
+static const int kReadBatchSize = 256;
+
+// How long a read waits for records before checking whether the thread should exit.
+static const int kReadTimeoutMs = 50;
+
+RiverEventReaderThread::RiverEventReaderThread(
+        const river::RedisConnection& connection,
+        const std::string& stream_name,
+        int capacity_records)
+        : juce::Thread("RiverEventReader"),
+          cursor_(connection, kReadBatchSize),
+          stream_name_(stream_name) {
+    reading_queue_ = std::make_unique<AbstractFifo>(capacity_records);
+    buffer_.resize(capacity_records);
+    incoming_.resize(kReadBatchSize);
+    raw_.resize((size_t) kReadBatchSize * sizeof(ProbeRecord));
+}
+
+void RiverEventReaderThread::initialize() {
+    cursor_.Initialize(stream_name_, 1000);
+    is_probe_stream_ = RiverOutput::LatencyProbeSchema::Matches(cursor_.schema());
+    if (!is_probe_stream_ && !RiverOutput::TtlEventSchema::Matches(cursor_.schema())) {
+        throw river::StreamReaderException("Stream " + stream_name_ + " does not have the River Output TTL schema.");
+    }
+}
+
+void RiverEventReaderThread::run() {
+    int start1, size1, start2, size2;
+    while (!threadShouldExit()) {
+        // Returns as soon as any record arrives, rather than waiting to fill the batch.
+        int64 n;
+        try {
+            n = cursor_.ReadAvailable(raw_.data(), kReadBatchSize, nullptr, kReadTimeoutMs);
+        } catch (const std::exception& e) {
+            LOGC("River Event Input: read failed: ", e.what());
+            return;
+        }
+        if (n < 0) {
+            // End of stream.
+            return;
+        }
+        if (n == 0) {
+            continue;
+        }
+
+        if (is_probe_stream_) {
+            memcpy(incoming_.data(), raw_.data(), (size_t) n * sizeof(ProbeRecord));
+        } else {
+            for (int64 i = 0; i < n; i++) {
+                TtlRecord ttl;
+                memcpy(&ttl, raw_.data() + i * sizeof(TtlRecord), sizeof(TtlRecord));
+                incoming_[i].Set<RiverFields::channelIndex>(ttl.Get<RiverFields::channelIndex>());
+                incoming_[i].Set<RiverFields::state>(ttl.Get<RiverFields::state>());
+                incoming_[i].Set<RiverFields::sampleNumber>(ttl.Get<RiverFields::sampleNumber>());
+                incoming_[i].Set<RiverFields::sentUs>(-1);
+            }
+        }
+
+        reading_queue_->prepareToWrite((int) n, start1, size1, start2, size2);
+        if (size1 > 0) {
+            std::copy(incoming_.begin(), incoming_.begin() + size1, buffer_.begin() + start1);
+        }
+        if (size2 > 0) {
+            std::copy(incoming_.begin() + size1, incoming_.begin() + size1 + size2, buffer_.begin() + start2);
+        }
+        reading_queue_->finishedWrite(size1 + size2);
+        dropped_count_ += n - (size1 + size2);
+    }
+}
+
+int RiverEventReaderThread::dequeue(ProbeRecord* records, int max_records) {
+    int start1, size1, start2, size2;
+    reading_queue_->prepareToRead(max_records, start1, size1, start2, size2);
+
+    if (size1 > 0) {
+        std::copy(buffer_.begin() + start1, buffer_.begin() + start1 + size1, records);
+    }
+    if (size2 > 0) {
+        std::copy(buffer_.begin() + start2, buffer_.begin() + start2 + size2, records + size1);
+    }
+    reading_queue_->finishedRead(size1 + size2);
+    return size1 + size2;
+}
+
+RiverEventInput::RiverEventInput()
+        : GenericProcessor("River Events")
+{
+    // Start with some sane defaults.
+    redis_connection_hostname_ = "127.0.0.1";
+    redis_connection_port_ = 6379;
+
+    pending_.resize(kQueueCapacity);
+}
+
+RiverEventInput::~RiverEventInput()
+{
+    if (reader_thread_) {
+        reader_thread_->stopThread(1000);
+    }
+}
+
+river::RedisConnection RiverEventInput::connection() const
+{
+    return river::RedisConnection(
+        redis_connection_hostname_,
+        redis_connection_port_,
+        redis_connection_password_);
+}
+
+void RiverEventInput::updateSettings()
+{
+    event_channels_.clear();
+
+    for (auto stream : getDataStreams())
+    {
+        EventChannel::Settings settings{
+            EventChannel::Type::TTL,
+            "River Events",
+            "TTL events read from a River stream",
+            "river.events",
+            getDataStream(stream->getStreamId()),
+            kNumLines
+        };
+
+        eventChannels.add(new EventChannel(settings));
+        eventChannels.getLast()->addProcessor(processorInfo.get());
+        event_channels_[stream->getStreamId()] = eventChannels.getLast();
+    }
+
+    isEnabled = !stream_name_.empty() && !getDataStreams().isEmpty();
+}
+
+AudioProcessorEditor *RiverEventInput::createEditor() {
+    editor = std::make_unique<RiverEventInputEditor>(this);
+    return editor.get();
+}
+
+bool RiverEventInput::startAcquisition()
+{
+    reader_thread_ = std::make_unique<RiverEventReaderThread>(connection(), stream_name_, kQueueCapacity);
+    try {
+        reader_thread_->initialize();
+    } catch (const std::exception& e) {
+        LOGC("River Event Input: failed to open stream ", stream_name_, ": ", e.what());
+        CoreServices::sendStatusMessage("River Events: failed to open stream.");
+        reader_thread_.reset();
+        return false;
+    }
+
+    events_received_ = 0;
+    last_latency_samples_ = 0;
+    round_trip_samples_.reset();
+    round_trip_us_.reset();
+    reader_thread_->startThread(Thread::realtimeAudioPriority);
+    return true;
+}
+
+bool RiverEventInput::stopAcquisition()
+{
+    if (reader_thread_) {
+        reader_thread_->stopThread(1000);
+        reader_thread_.reset();
+    }
+
+    if (round_trip_us_.count() > 0) {
+        LOGC("River Events: ", round_trip_us_.count(), " latency probes; round trip p50 ",
+             round_trip_us_.percentile(50), " us, p99 ", round_trip_us_.percentile(99), " us, max ",
+             round_trip_us_.maximum(), " us; p50 ", round_trip_samples_.percentile(50), " samples, p99 ",
+             round_trip_samples_.percentile(99), " samples");
+        LOGC("River Events: round trip histogram (us):\n", round_trip_us_.toCsv());
+        LOGC("River Events: round trip histogram (samples):\n", round_trip_samples_.toCsv());
+    }
+    return true;
+}
+
+void RiverEventInput::process(AudioSampleBuffer &buffer)
+{
+    if (!reader_thread_) {
+        return;
+    }
+
+    int n = reader_thread_->dequeue(pending_.data(), (int) pending_.size());
+    if (n == 0) {
+        return;
+    }
+    const int64 nowUs = RiverLatency::nowMicros();
+
+    bool isFirstStream = true;
+    for (auto stream : getDataStreams())
+    {
+        EventChannel* channel = event_channels_.at(stream->getStreamId());
+        int64 blockStart = getFirstSampleNumberForBlock(stream->getStreamId());
+
+        for (int i = 0; i < n; i++)
+        {
+            // RiverOutput encodes (line + 1), negated for an off transition.
+            int state = pending_[i].Get<RiverFields::state>();
+            int line = std::abs(state) - 1;
+            if (line < 0 || line >= kNumLines) {
+                continue;
+            }
+
+            TTLEventPtr event = TTLEvent::createTTLEvent(channel, blockStart, (uint8) line, state > 0);
+            addEvent(event, 0);
+        }
+
+        if (isFirstStream) {
+            last_latency_samples_ = blockStart - pending_[n - 1].Get<RiverFields::sampleNumber>();
+            for (int i = 0; i < n; i++)
+            {
+                int64 sentUs = pending_[i].Get<RiverFields::sentUs>();
+                if (sentUs >= 0) {
+                    round_trip_samples_.record(blockStart - pending_[i].Get<RiverFields::sampleNumber>());
+                    round_trip_us_.record(nowUs - sentUs);
+                }
+            }
+            isFirstStream = false;
+        }
+    }
+    events_received_ += n;
+}
+
+const std::string &RiverEventInput::redisConnectionHostname() const {
+    return redis_connection_hostname_;
+}
+
+void RiverEventInput::setRedisConnectionHostname(const std::string &redisConnectionHostname) {
+    redis_connection_hostname_ = redisConnectionHostname;
+}
+
+int RiverEventInput::redisConnectionPort() const {
+    return redis_connection_port_;
+}
+
+void RiverEventInput::setRedisConnectionPort(int redisConnectionPort) {
+    redis_connection_port_ = redisConnectionPort;
+}
+
+const std::string &RiverEventInput::redisConnectionPassword() const {
+    return redis_connection_password_;
+}
+
+void RiverEventInput::setRedisConnectionPassword(const std::string &redisConnectionPassword) {
+    redis_connection_password_ = redisConnectionPassword;
+}
+
+const std::string &RiverEventInput::streamName() const {
+    return stream_name_;
+}
+
+void RiverEventInput::setStreamName(const std::string &streamName) {
+    stream_name_ = streamName;
+}
+
+void RiverEventInput::saveCustomParametersToXml(XmlElement *parentElement) {
+    XmlElement *mainNode = parentElement->createNewChildElement("RiverEventInput");
+    mainNode->setAttribute("hostname", redisConnectionHostname());
+    mainNode->setAttribute("port", redisConnectionPort());
+    mainNode->setAttribute("password", redisConnectionPassword());
+    mainNode->setAttribute("stream_name", streamName());
+}
+
+void RiverEventInput::loadCustomParametersFromXml(XmlElement* xml) {
+
+    forEachXmlChildElement(*xml, mainNode)
+    {
+        if (!mainNode->hasTagName("RiverEventInput")) {
+            continue;
+        }
+
+        redis_connection_hostname_ = mainNode->getStringAttribute("hostname", "127.0.0.1").toStdString();
+        redis_connection_port_ = mainNode->getIntAttribute("port", 6379);
+        redis_connection_password_ = mainNode->getStringAttribute("password", "").toStdString();
+        stream_name_ = mainNode->getStringAttribute("stream_name", "").toStdString();
+    }
+
+    ((RiverEventInputEditor *) editor.get())->refreshLabelsFromProcessor();
+}
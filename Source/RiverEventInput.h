@@ -0,0 +1,190 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __RIVEREVENTINPUT_H_9A4C7D12__
+#define __RIVEREVENTINPUT_H_9A4C7D12__
+
+#include <ProcessorHeaders.h>
+#include "RiverOutput.h"
+
+#include <atomic>
+
+/**
+
+    Reads TTL records from a River stream inside a thread and hands them to the audio thread. Streams with the
+    River Output latency probe layout are accepted too; plain TTL records are handed over with a sent_us of -1.
+
+*/
+class RiverEventReaderThread : public Thread
+{
+public:
+
+    /** Constructor */
+    RiverEventReaderThread(const river::RedisConnection& connection,
+                           const std::string& stream_name,
+                           int capacity_records);
+
+    /** Destructor */
+    ~RiverEventReaderThread() override = default;
+
+    /** Opens the stream; throws if it cannot be read */
+    void initialize();
+
+    /** Run thread */
+    void run() override;
+
+    /** Moves up to `max_records` records into `records`, without blocking. Called from the audio thread. */
+    int dequeue(RiverOutput::LatencyProbeSchema::Record* records, int max_records);
+
+    /** Number of records dropped because the audio thread fell behind */
+    int64 droppedCount() const {
+        return dropped_count_;
+    }
+
+private:
+
+    river::internal::StreamCursor cursor_;
+    const std::string stream_name_;
+
+    std::unique_ptr<AbstractFifo> reading_queue_;
+    std::vector<RiverOutput::LatencyProbeSchema::Record> buffer_;
+    std::vector<RiverOutput::LatencyProbeSchema::Record> incoming_;
+
+    // Raw records as read, in whichever of the two layouts the stream has.
+    std::vector<char> raw_;
+    bool is_probe_stream_ = false;
+
+    std::atomic<int64> dropped_count_{0};
+};
+
+/**
+ *  A filter that injects TTL events read from a River stream into the signal chain, for closed-loop experiments
+ *  where an external decoder makes the decisions. The stream uses the TTL layout RiverOutput writes
+ *  (channel_index/state/sample_number); each record becomes a TTL event on this processor's event channel at the
+ *  start of the next block of every data stream.
+ *
+ *  When the stream carries River Output latency probes (usually echoed back by Resources/scripts/latency_echo.py),
+ *  the round trip from River Output's audio thread to this one is recorded in a histogram, in samples and in
+ *  microseconds, and logged when acquisition stops.
+ *
+    @see GenericProcessor, RiverOutput
+ */
+class RiverEventInput : public GenericProcessor
+{
+public:
+    /** Number of TTL lines on the event channel this processor adds */
+    static constexpr int kNumLines = 8;
+
+    /** Constructor */
+    RiverEventInput();
+
+    /** Destructor */
+    ~RiverEventInput() override;
+
+    /** Adds one TTL event channel per data stream */
+    void updateSettings() override;
+
+    /** Emits the TTL events received since the last block */
+    void process(AudioSampleBuffer &buffer) override;
+
+    /** Called immediately prior to the start of data acquisition. */
+    bool startAcquisition() override;
+
+    /** Called immediately after the end of data acquisition. */
+    bool stopAcquisition() override;
+
+    /** Creates the RiverEventInputEditor. */
+    AudioProcessorEditor *createEditor() override;
+
+    /** Convert parameters to XML */
+    void saveCustomParametersToXml(XmlElement* xml) override;
+
+    /** Load custom parameters from XML*/
+    void loadCustomParametersFromXml(XmlElement* xml) override;
+
+    //
+    // Non-override methods:
+    //
+    const std::string &redisConnectionHostname() const;
+    void setRedisConnectionHostname(const std::string &redisConnectionHostname);
+    int redisConnectionPort() const;
+    void setRedisConnectionPort(int redisConnectionPort);
+    const std::string &redisConnectionPassword() const;
+    void setRedisConnectionPassword(const std::string &redisConnectionPassword);
+
+    const std::string &streamName() const;
+    void setStreamName(const std::string &streamName);
+
+    int64 eventsReceived() const {
+        return events_received_;
+    }
+
+    int64 eventsDropped() const {
+        return reader_thread_ ? reader_thread_->droppedCount() : 0;
+    }
+
+    /**
+     * Samples between the sample_number carried by the last record and the sample it was emitted at, on the first
+     * data stream. Only meaningful if the record's sample numbers come from this signal chain.
+     */
+    int64 lastLatencySamples() const {
+        return last_latency_samples_;
+    }
+
+    /** Round trip of each latency probe, in samples of the first data stream */
+    const LatencyHistogram& roundTripSamples() const {
+        return round_trip_samples_;
+    }
+
+    /** Round trip of each latency probe, in microseconds */
+    const LatencyHistogram& roundTripMicros() const {
+        return round_trip_us_;
+    }
+
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RiverEventInput)
+
+    river::RedisConnection connection() const;
+
+    std::unique_ptr<RiverEventReaderThread> reader_thread_;
+
+    // Scratch for records dequeued in process(), so the audio thread does not allocate for them.
+    std::vector<RiverOutput::LatencyProbeSchema::Record> pending_;
+
+    // Event channel added for each data stream, by stream ID.
+    std::map<uint16, EventChannel*> event_channels_;
+
+    std::string redis_connection_hostname_;
+    int redis_connection_port_;
+    std::string redis_connection_password_;
+    std::string stream_name_;
+
+    std::atomic<int64> events_received_{0};
+    std::atomic<int64> last_latency_samples_{0};
+
+    LatencyHistogram round_trip_samples_;
+    LatencyHistogram round_trip_us_;
+};
+
+
+#endif  // __RIVEREVENTINPUT_H_9A4C7D12__
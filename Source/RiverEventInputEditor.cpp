@@ -0,0 +1,123 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "RiverEventInputEditor.h"
+
+RiverEventInputEditor::RiverEventInputEditor(GenericProcessor *parentNode)
+        : GenericEditor(parentNode), eventInput((RiverEventInput *) parentNode) {
+
+    desiredWidth = 300;
+
+    hostnameLabel = newStaticLabel("Hostname", 10, 25, 80, 20);
+    hostnameLabelValue = newInputLabel("hostnameLabelValue", "Set the hostname for River", 15, 42, 80, 18);
+
+    portLabel = newStaticLabel("Port", 10, 65, 80, 20);
+    portLabelValue = newInputLabel("portLabelValue", "Set the port for River", 15, 82, 60, 18);
+
+    streamNameLabel = newStaticLabel("Stream Name", 105, 25, 100, 20);
+    streamNameLabelValue = newInputLabel("streamNameLabelValue",
+                                         "Name of the River stream of TTL records to read",
+                                         110, 42, 90, 18);
+
+    passwordLabel = newStaticLabel("Password", 205, 25, 90, 20);
+    passwordLabelValue = newInputLabel("passwordLabelValue", "Set the password for River", 210, 42, 80, 18);
+
+    connectButton = new UtilityButton("Connect", titleFont);
+    connectButton->setBounds(210, 80, 80, 20);
+    connectButton->addListener(this);
+    addAndMakeVisible(connectButton);
+
+    statusLabel = newStaticLabel("", 10, 104, 280, 18);
+
+    refreshLabelsFromProcessor();
+}
+
+void RiverEventInputEditor::buttonClicked(Button *button) {
+    if (button == connectButton) {
+        CoreServices::updateSignalChain(this);
+        refreshLabelsFromProcessor();
+    }
+}
+
+void RiverEventInputEditor::labelTextChanged(Label *label) {
+    if (label == hostnameLabelValue) {
+        eventInput->setRedisConnectionHostname(label->getText().toStdString());
+    } else if (label == portLabelValue) {
+        int port = label->getText().getIntValue();
+        if (port > 0) {
+            eventInput->setRedisConnectionPort(port);
+            lastPortValue = label->getText().toStdString();
+        } else {
+            label->setText(juce::String(lastPortValue), dontSendNotification);
+        }
+    } else if (label == passwordLabelValue) {
+        eventInput->setRedisConnectionPassword(label->getText().toStdString());
+    } else if (label == streamNameLabelValue) {
+        eventInput->setStreamName(label->getText().toStdString());
+    }
+}
+
+void RiverEventInputEditor::startAcquisition() {
+    for (Label *label : {hostnameLabelValue.get(), portLabelValue.get(), passwordLabelValue.get(),
+                         streamNameLabelValue.get()}) {
+        label->setEditable(false);
+    }
+    connectButton->setEnabled(false);
+    startTimer(250);
+}
+
+void RiverEventInputEditor::stopAcquisition() {
+    stopTimer();
+    for (Label *label : {hostnameLabelValue.get(), portLabelValue.get(), passwordLabelValue.get(),
+                         streamNameLabelValue.get()}) {
+        label->setEditable(true);
+    }
+    connectButton->setEnabled(true);
+    refreshLabelsFromProcessor();
+}
+
+void RiverEventInputEditor::timerCallback() {
+    refreshLabelsFromProcessor();
+}
+
+void RiverEventInputEditor::refreshLabelsFromProcessor() {
+    lastPortValue = std::to_string(eventInput->redisConnectionPort());
+
+    hostnameLabelValue->setText(eventInput->redisConnectionHostname(), dontSendNotification);
+    portLabelValue->setText(lastPortValue, dontSendNotification);
+    passwordLabelValue->setText(eventInput->redisConnectionPassword(), dontSendNotification);
+    streamNameLabelValue->setText(eventInput->streamName(), dontSendNotification);
+
+    const LatencyHistogram& roundTrip = eventInput->roundTripMicros();
+    if (roundTrip.count() > 0) {
+        statusLabel->setText("probes " + juce::String(roundTrip.count())
+                             + "   round trip p50 " + juce::String(roundTrip.percentile(50))
+                             + " us   p99 " + juce::String(roundTrip.percentile(99)) + " us",
+                             dontSendNotification);
+    } else {
+        statusLabel->setText("events " + juce::String(eventInput->eventsReceived())
+                             + "   dropped " + juce::String(eventInput->eventsDropped())
+                             + "   latency " + juce::String(eventInput->lastLatencySamples()) + " samples",
+                             dontSendNotification);
+    }
+}
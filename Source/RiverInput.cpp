@@ -0,0 +1,369 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "RiverInput.h"
+#include "RiverInputEditor.h"
+
+// Maximum number of samples handed to the signal chain in one update.
+static const int kMaxSamplesPerUpdate = 4096;
+
+// How long to wait for the stream's metadata when looking it up.
+static const int kConnectTimeoutMs = 500;
+
+DataThread* RiverInput::createDataThread(SourceNode* sn)
+{
+    return new RiverInput(sn);
+}
+
+RiverInput::RiverInput(SourceNode* sn)
+        : DataThread(sn)
+{
+    // Start with some sane defaults.
+    redis_connection_hostname_ = "127.0.0.1";
+    redis_connection_port_ = 6379;
+    latency_ms_ = 50;
+
+    sample_rate_ = 30000.0f;
+    bit_volts_ = 0.195f;
+
+    sample_numbers_.allocate(kMaxSamplesPerUpdate, true);
+    timestamps_.allocate(kMaxSamplesPerUpdate, true);
+    event_codes_.allocate(kMaxSamplesPerUpdate, true);
+
+    sourceBuffers.add(new DataBuffer(1, 10000));
+}
+
+RiverInput::~RiverInput()
+{
+    if (reader_)
+    {
+        reader_->Stop();
+    }
+}
+
+std::unique_ptr<GenericEditor> RiverInput::createEditor(SourceNode* sn)
+{
+    return std::make_unique<RiverInputEditor>(sn, this);
+}
+
+river::RedisConnection RiverInput::connection() const
+{
+    return river::RedisConnection(
+        redis_connection_hostname_,
+        redis_connection_port_,
+        redis_connection_password_);
+}
+
+bool RiverInput::connectToStream()
+{
+    channels_.clear();
+    found_stream_ = false;
+
+    if (stream_name_.empty())
+    {
+        return false;
+    }
+
+    try {
+        river::StreamReader reader(connection());
+        reader.Initialize(stream_name_, kConnectTimeoutMs);
+
+        auto metadata = reader.Metadata();
+        auto rate = metadata.find(RiverMetadata::samplingRate);
+        if (rate != metadata.end())
+        {
+            sample_rate_ = String(rate->second).getFloatValue();
+        }
+        else
+        {
+            LOGC("River Input: stream ", stream_name_, " has no ", RiverMetadata::samplingRate, " metadata; assuming ",
+                 sample_rate_, " Hz.");
+        }
+        auto bit_volts = metadata.find(RiverMetadata::bitVolts);
+        if (bit_volts != metadata.end())
+        {
+            bit_volts_ = String(bit_volts->second).getFloatValue();
+        }
+
+        std::vector<float> channelBitVolts;
+        auto channel_bit_volts = metadata.find(RiverMetadata::channelBitVolts);
+        if (channel_bit_volts != metadata.end())
+        {
+            channelBitVolts = RiverChannelField::parseScales(channel_bit_volts->second);
+        }
+
+        channels_ = RiverChannelField::fromSchema(reader.schema(), bit_volts_, channelBitVolts);
+        sample_size_ = reader.schema().sample_size();
+        found_stream_ = sample_rate_ > 0 && !channels_.empty() && !reader.schema().has_variable_width_field();
+    } catch (const std::exception& e) {
+        LOGC("River Input: could not read stream ", stream_name_, ": ", e.what());
+    }
+
+    if (!found_stream_)
+    {
+        channels_.clear();
+    }
+    return found_stream_;
+}
+
+void RiverInput::updateSettings(OwnedArray<ContinuousChannel>* continuousChannels,
+                                OwnedArray<EventChannel>* eventChannels,
+                                OwnedArray<SpikeChannel>* spikeChannels,
+                                OwnedArray<DataStream>* sourceStreams,
+                                OwnedArray<DeviceInfo>* devices,
+                                OwnedArray<ConfigurationObject>* configurationObjects)
+{
+    continuousChannels->clear();
+    eventChannels->clear();
+    spikeChannels->clear();
+    sourceStreams->clear();
+    devices->clear();
+    configurationObjects->clear();
+
+    if (!connectToStream())
+    {
+        CoreServices::sendStatusMessage("River Input: stream not found.");
+        return;
+    }
+
+    DataStream::Settings streamSettings
+    {
+        String(stream_name_),
+        "Continuous data read from a River stream",
+        "river.input." + String(stream_name_),
+        sample_rate_
+    };
+    DataStream* stream = new DataStream(streamSettings);
+    sourceStreams->add(stream);
+
+    // Hold at least a few times the jitter buffer, so the signal chain is never waiting on a full DataBuffer.
+    int bufferSize = jmax(10000, (int) (4 * targetBufferedSamples()));
+    sourceBuffers[0]->resize(numChannels(), bufferSize);
+
+    for (const auto& channel : channels_)
+    {
+        ContinuousChannel::Settings channelSettings
+        {
+            ContinuousChannel::Type::ELECTRODE,
+            String(channel.name),
+            "River field " + String(channel.name),
+            "river.input.field",
+            channel.kind == RiverChannelField::INT16 ? channel.scale : bit_volts_,
+            stream
+        };
+        continuousChannels->add(new ContinuousChannel(channelSettings));
+    }
+
+    records_.resize((size_t) kMaxSamplesPerUpdate * sample_size_);
+    samples_.allocate((size_t) kMaxSamplesPerUpdate * numChannels(), true);
+
+    CoreServices::sendStatusMessage("River Input: reading " + String(numChannels()) + " channels at "
+                                    + String(sample_rate_) + " Hz.");
+}
+
+bool RiverInput::foundInputSource()
+{
+    return found_stream_;
+}
+
+int64 RiverInput::targetBufferedSamples() const
+{
+    return jmax((int64) 1, (int64) (latency_ms_ * (double) sample_rate_ / 1000.0));
+}
+
+bool RiverInput::startAcquisition()
+{
+    if (!found_stream_)
+    {
+        return false;
+    }
+
+    // Leave the prefetcher room for the overrun threshold (twice the target) plus a full update.
+    int64 ringDepth = jmax((int64) 65536, 2 * targetBufferedSamples() + 2 * kMaxSamplesPerUpdate);
+
+    try {
+        reader_ = std::make_unique<river::PrefetchingStreamReader>(connection(), ringDepth);
+        reader_->Initialize(stream_name_, kConnectTimeoutMs, true);
+    } catch (const std::exception& e) {
+        LOGC("River Input: failed to open stream ", stream_name_, ": ", e.what());
+        CoreServices::sendStatusMessage("River Input: failed to open stream.");
+        reader_.reset();
+        return false;
+    }
+
+    // The channels and records_ were sized for the schema read in updateSettings; the stream may have been recreated.
+    if (reader_->schema().sample_size() != sample_size_)
+    {
+        LOGC("River Input: schema of stream ", stream_name_, " changed since settings were updated (sample size ",
+             reader_->schema().sample_size(), ", expected ", sample_size_, ")");
+        CoreServices::sendStatusMessage("River Input: stream schema changed; refresh the settings.");
+        reader_.reset();
+        return false;
+    }
+
+    total_samples_ = 0;
+    underrun_count_ = 0;
+    overrun_count_ = 0;
+    is_priming_ = true;
+
+    sourceBuffers[0]->clear();
+    startThread();
+    return true;
+}
+
+bool RiverInput::stopAcquisition()
+{
+    if (isThreadRunning())
+    {
+        signalThreadShouldExit();
+    }
+
+    if (reader_)
+    {
+        // Unblocks any read in progress.
+        reader_->Stop();
+    }
+
+    waitForThreadToExit(500);
+
+    reader_.reset();
+    sourceBuffers[0]->clear();
+    return true;
+}
+
+bool RiverInput::updateBuffer()
+{
+    const int64 target = targetBufferedSamples();
+
+    // Fill the jitter buffer before (re)starting playout.
+    if (is_priming_)
+    {
+        if (reader_->num_buffered() < target && reader_->Good())
+        {
+            sleep(1);
+            return true;
+        }
+        is_priming_ = false;
+        playout_start_ms_ = Time::getMillisecondCounterHiRes();
+        samples_since_playout_start_ = 0;
+    }
+
+    double elapsed_ms = Time::getMillisecondCounterHiRes() - playout_start_ms_;
+    int64 due = (int64) (elapsed_ms * sample_rate_ / 1000.0) - samples_since_playout_start_;
+    if (due <= 0)
+    {
+        sleep(1);
+        return true;
+    }
+    int numToRead = (int) jmin(due, (int64) kMaxSamplesPerUpdate);
+
+    // Drop what has piled up beyond twice the target, back down to the target.
+    int64 buffered = reader_->num_buffered();
+    if (buffered > 2 * target + numToRead)
+    {
+        int64 excess = buffered - target - numToRead;
+        while (excess > 0)
+        {
+            int64 n = reader_->ReadBytes(records_.data(), jmin(excess, (int64) kMaxSamplesPerUpdate), 1);
+            if (n <= 0)
+            {
+                break;
+            }
+            excess -= n;
+            total_samples_ += n;
+        }
+        overrun_count_++;
+    }
+
+    int64 numRead = reader_->ReadBytes(records_.data(), numToRead, 1);
+    if (numRead < 0)
+    {
+        // The stream has ended; keep the thread alive so acquisition can be stopped normally.
+        sleep(10);
+        return true;
+    }
+
+    if (numRead < numToRead)
+    {
+        underrun_count_++;
+        is_priming_ = true;
+    }
+    samples_since_playout_start_ += numToRead;
+
+    if (numRead > 0)
+    {
+        convertSamples((int) numRead);
+        int64 first = total_samples_;
+        for (int i = 0; i < numRead; i++)
+        {
+            sample_numbers_[i] = first + i;
+            timestamps_[i] = (double) (first + i) / sample_rate_;
+            event_codes_[i] = 0;
+        }
+        sourceBuffers[0]->addToBuffer(samples_.getData(),
+                                      sample_numbers_.getData(),
+                                      timestamps_.getData(),
+                                      event_codes_.getData(),
+                                      (int) numRead,
+                                      1);
+        total_samples_ += numRead;
+    }
+    return true;
+}
+
+void RiverInput::convertSamples(int num_samples)
+{
+    RiverChannelField::convert(channels_, records_.data(), sample_size_, num_samples, samples_.getData());
+}
+
+const std::string &RiverInput::redisConnectionHostname() const {
+    return redis_connection_hostname_;
+}
+
+void RiverInput::setRedisConnectionHostname(const std::string &redisConnectionHostname) {
+    redis_connection_hostname_ = redisConnectionHostname;
+}
+
+int RiverInput::redisConnectionPort() const {
+    return redis_connection_port_;
+}
+
+void RiverInput::setRedisConnectionPort(int redisConnectionPort) {
+    redis_connection_port_ = redisConnectionPort;
+}
+
+const std::string &RiverInput::redisConnectionPassword() const {
+    return redis_connection_password_;
+}
+
+void RiverInput::setRedisConnectionPassword(const std::string &redisConnectionPassword) {
+    redis_connection_password_ = redisConnectionPassword;
+}
+
+const std::string &RiverInput::streamName() const {
+    return stream_name_;
+}
+
+void RiverInput::setStreamName(const std::string &streamName) {
+    stream_name_ = streamName;
+}
@@ -0,0 +1,170 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __RIVERINPUT_H_3B1E6F0A__
+#define __RIVERINPUT_H_3B1E6F0A__
+
+#include <DataThreadHeaders.h>
+#include "river/river.h"
+#include "RiverChannels.h"
+
+#include <atomic>
+
+/**
+ *  A source that reads a River stream into the signal chain as continuous channels.
+ *
+ *  Every FLOAT or DOUBLE field of the stream's schema, and every 2-byte FIXED_WIDTH_BYTES field (read as int16 and
+ *  scaled by the stream's "bit_volts" metadata), becomes one channel; other fields are ignored. The sample rate comes
+ *  from the stream's "sampling_rate" metadata.
+ *
+ *  Samples are prefetched in the background and played out against a local clock at the stream's sample rate, through
+ *  a jitter buffer that holds about `latency` of data. If the buffer runs dry (an underrun) playback pauses until it
+ *  has refilled; if it grows to twice its target (an overrun, e.g. after a stall or clock drift) the oldest samples
+ *  are dropped to bring the latency back down.
+ *
+ *  Playback starts at the live end of the stream when acquisition starts; samples written before then are not read.
+ *
+    @see DataThread
+ */
+class RiverInput : public DataThread
+{
+public:
+    /** Constructor */
+    RiverInput(SourceNode* sn);
+
+    /** Destructor */
+    ~RiverInput() override;
+
+    /** Creates a RiverInput data thread */
+    static DataThread* createDataThread(SourceNode* sn);
+
+    /** Creates the RiverInputEditor */
+    std::unique_ptr<GenericEditor> createEditor(SourceNode* sn) override;
+
+    /** Plays out the samples that are due according to the stream's sample rate */
+    bool updateBuffer() override;
+
+    /** True if the configured stream was found */
+    bool foundInputSource() override;
+
+    /** Connects to the stream and starts prefetching */
+    bool startAcquisition() override;
+
+    /** Stops prefetching */
+    bool stopAcquisition() override;
+
+    /** Reads the stream's schema and metadata and creates one continuous channel per numeric field */
+    void updateSettings(OwnedArray<ContinuousChannel>* continuousChannels,
+                        OwnedArray<EventChannel>* eventChannels,
+                        OwnedArray<SpikeChannel>* spikeChannels,
+                        OwnedArray<DataStream>* sourceStreams,
+                        OwnedArray<DeviceInfo>* devices,
+                        OwnedArray<ConfigurationObject>* configurationObjects) override;
+
+    //
+    // Non-override methods:
+    //
+    const std::string &redisConnectionHostname() const;
+    void setRedisConnectionHostname(const std::string &redisConnectionHostname);
+    int redisConnectionPort() const;
+    void setRedisConnectionPort(int redisConnectionPort);
+    const std::string &redisConnectionPassword() const;
+    void setRedisConnectionPassword(const std::string &redisConnectionPassword);
+
+    const std::string &streamName() const;
+    void setStreamName(const std::string &streamName);
+
+    int latencyMs() const {
+        return latency_ms_;
+    }
+
+    void setLatencyMs(int latencyMs) {
+        latency_ms_ = latencyMs;
+    }
+
+    float sampleRate() const {
+        return sample_rate_;
+    }
+
+    int numChannels() const {
+        return (int) channels_.size();
+    }
+
+    int64 underrunCount() const {
+        return underrun_count_;
+    }
+
+    int64 overrunCount() const {
+        return overrun_count_;
+    }
+
+    int64 totalSamplesRead() const {
+        return total_samples_;
+    }
+
+private:
+    /** Reads the stream's schema and metadata; returns false if the stream cannot be found */
+    bool connectToStream();
+
+    /** Converts `num_samples` stream samples in records_ to interleaved floats in samples_ */
+    void convertSamples(int num_samples);
+
+    /** Number of samples the jitter buffer aims to hold */
+    int64 targetBufferedSamples() const;
+
+    river::RedisConnection connection() const;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RiverInput)
+
+    std::string redis_connection_hostname_;
+    int redis_connection_port_;
+    std::string redis_connection_password_;
+    std::string stream_name_;
+    int latency_ms_;
+
+    // Set by updateSettings() from the stream's schema and metadata.
+    bool found_stream_ = false;
+    float sample_rate_;
+    float bit_volts_;
+    int sample_size_ = 0;
+    std::vector<RiverChannelField> channels_;
+
+    std::unique_ptr<river::PrefetchingStreamReader> reader_;
+
+    // Playout state, only touched on the data thread.
+    bool is_priming_ = true;
+    double playout_start_ms_ = 0;
+    int64 samples_since_playout_start_ = 0;
+
+    std::vector<char> records_;
+    HeapBlock<float> samples_;
+    HeapBlock<int64> sample_numbers_;
+    HeapBlock<double> timestamps_;
+    HeapBlock<uint64> event_codes_;
+
+    std::atomic<int64> total_samples_{0};
+    std::atomic<int64> underrun_count_{0};
+    std::atomic<int64> overrun_count_{0};
+};
+
+#endif  // __RIVERINPUT_H_3B1E6F0A__
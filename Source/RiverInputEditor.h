@@ -0,0 +1,128 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __RIVERINPUTEDITOR_H_5C2D8E41__
+#define __RIVERINPUTEDITOR_H_5C2D8E41__
+
+#include <EditorHeaders.h>
+#include "RiverInput.h"
+
+/**
+
+  User interface for the RiverInput source.
+
+  @see RiverInput
+*/
+class RiverInputEditor : public GenericEditor,
+                         public Label::Listener,
+                         public Button::Listener,
+                         public Timer
+{
+public:
+
+    /** Constructor*/
+    RiverInputEditor(GenericProcessor *parentNode, RiverInput *thread);
+
+    /** Destructor */
+    ~RiverInputEditor() override = default;
+
+    /** UI listeners */
+    void labelTextChanged(Label* label) override;
+    void buttonClicked(Button* button) override;
+
+    /** Refreshes the underrun/overrun counters while acquiring */
+    void timerCallback() override;
+
+    /** Called when acquisition starts/stops */
+    void startAcquisition() override;
+    void stopAcquisition() override;
+
+    /** Convert parameters to XML */
+    void saveCustomParametersToXml(XmlElement* xml) override;
+
+    /** Load custom parameters from XML*/
+    void loadCustomParametersFromXml(XmlElement* xml) override;
+
+    /** Non-overrides */
+    void refreshLabelsFromThread();
+
+private:
+    RiverInput* thread;
+
+    ScopedPointer<Label> hostnameLabel;
+    ScopedPointer<Label> hostnameLabelValue;
+
+    ScopedPointer<Label> portLabel;
+    ScopedPointer<Label> portLabelValue;
+    std::string lastPortValue;
+
+    ScopedPointer<Label> passwordLabel;
+    ScopedPointer<Label> passwordLabelValue;
+
+    ScopedPointer<Label> streamNameLabel;
+    ScopedPointer<Label> streamNameLabelValue;
+
+    ScopedPointer<Label> latencyMsLabel;
+    ScopedPointer<Label> latencyMsLabelValue;
+
+    ScopedPointer<Label> statusLabel;
+
+    ScopedPointer<UtilityButton> connectButton;
+
+    Label *newStaticLabel(
+            const std::string& labelText,
+            int boundsX,
+            int boundsY,
+            int boundsWidth,
+            int boundsHeight) {
+        auto *label = new Label(labelText, labelText);
+        label->setBounds(boundsX, boundsY, boundsWidth, boundsHeight);
+        label->setFont(Font("Small Text", 12, Font::plain));
+        label->setColour(Label::textColourId, Colours::darkgrey);
+        addAndMakeVisible(label);
+        return label;
+    }
+
+    Label *newInputLabel(
+            const std::string &componentName,
+            const std::string &tooltip,
+            int boundsX,
+            int boundsY,
+            int boundsWidth,
+            int boundsHeight) {
+        auto *label = new Label(componentName, "");
+        label->setBounds(boundsX, boundsY, boundsWidth, boundsHeight);
+        label->setFont(Font("Default", 15, Font::plain));
+        label->setColour(Label::textColourId, Colours::white);
+        label->setColour(Label::backgroundColourId, Colours::grey);
+        label->setEditable(true);
+        label->setTooltip(tooltip);
+        label->addListener(this);
+        addAndMakeVisible(label);
+        return label;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RiverInputEditor)
+};
+
+#endif  // __RIVERINPUTEDITOR_H_5C2D8E41__
@@ -0,0 +1,167 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __RIVERLATENCY_H_6E1B0A57__
+#define __RIVERLATENCY_H_6E1B0A57__
+
+#include <JuceHeader.h>
+
+#include <array>
+#include <atomic>
+
+namespace RiverLatency
+{
+    /** Monotonic wall clock shared by every processor in this process, in microseconds */
+    inline int64 nowMicros()
+    {
+        return (int64) (Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks()) * 1e6);
+    }
+}
+
+/**
+
+    Histogram of non-negative latencies with log-linear buckets: exact below 8, then 8 buckets per power of two
+    (at most 12.5% relative error). Recording is lock-free and allocation-free, so it can be called from the audio
+    thread while the editor reads it.
+
+*/
+class LatencyHistogram
+{
+public:
+    static constexpr int kSubBuckets = 8;
+    static constexpr int kNumBuckets = kSubBuckets * 62;
+
+    /** Constructor */
+    LatencyHistogram()
+    {
+        reset();
+    }
+
+    /** Adds one observation; negative values are counted as 0 */
+    void record(int64 value)
+    {
+        value = jmax((int64) 0, value);
+        counts_[bucketFor(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+
+        int64 previous = max_.load(std::memory_order_relaxed);
+        while (value > previous && !max_.compare_exchange_weak(previous, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    /** Clears every bucket */
+    void reset()
+    {
+        for (auto& c : counts_) {
+            c.store(0, std::memory_order_relaxed);
+        }
+        count_ = 0;
+        sum_ = 0;
+        max_ = 0;
+    }
+
+    int64 count() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    int64 maximum() const {
+        return max_.load(std::memory_order_relaxed);
+    }
+
+    double mean() const {
+        int64 n = count();
+        return n > 0 ? (double) sum_.load(std::memory_order_relaxed) / n : 0.0;
+    }
+
+    /** Upper bound of the bucket holding the `p`th percentile, `p` in [0, 100]; 0 if nothing was recorded */
+    int64 percentile(double p) const
+    {
+        int64 n = count();
+        if (n == 0) {
+            return 0;
+        }
+        int64 rank = jmax((int64) 1, (int64) std::ceil(p / 100.0 * n));
+        int64 seen = 0;
+        for (int i = 0; i < kNumBuckets; i++) {
+            seen += counts_[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                return jmin(bucketUpperBound(i), maximum());
+            }
+        }
+        return maximum();
+    }
+
+    /** Writes one "lower,upper,count" line per non-empty bucket, preceded by a header line */
+    String toCsv() const
+    {
+        String csv = "lower,upper,count\n";
+        for (int i = 0; i < kNumBuckets; i++) {
+            int64 c = counts_[i].load(std::memory_order_relaxed);
+            if (c > 0) {
+                csv << bucketLowerBound(i) << "," << bucketUpperBound(i) << "," << c << "\n";
+            }
+        }
+        return csv;
+    }
+
+    static int bucketFor(int64 value)
+    {
+        if (value < kSubBuckets) {
+            return (int) value;
+        }
+        int msb = 3;
+        while ((value >> (msb + 1)) != 0) {
+            msb++;
+        }
+        return kSubBuckets * (msb - 2) + (int) ((value >> (msb - 3)) & (kSubBuckets - 1));
+    }
+
+    static int64 bucketLowerBound(int bucket)
+    {
+        if (bucket < kSubBuckets) {
+            return bucket;
+        }
+        int msb = bucket / kSubBuckets + 2;
+        return (int64) (kSubBuckets + bucket % kSubBuckets) << (msb - 3);
+    }
+
+    static int64 bucketUpperBound(int bucket)
+    {
+        if (bucket < kSubBuckets) {
+            return bucket;
+        }
+        int msb = bucket / kSubBuckets + 2;
+        return bucketLowerBound(bucket) + ((int64) 1 << (msb - 3)) - 1;
+    }
+
+private:
+    std::array<std::atomic<int64>, kNumBuckets> counts_;
+    std::atomic<int64> count_;
+    std::atomic<int64> sum_;
+    std::atomic<int64> max_;
+
+    JUCE_DECLARE_NON_COPYABLE(LatencyHistogram)
+};
+
+#endif  // __RIVERLATENCY_H_6E1B0A57__
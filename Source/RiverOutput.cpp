@@ -24,18 +24,29 @@
 #include "RiverOutput.h"
 #include "RiverOutputEditor.h"
 #include "nlohmann/json.hpp"
+#include <algorithm>
 #include <memory>
 #include <unordered_map>
 
 using json = nlohmann::json;
 
+// Continuous frames interleaved per call to the kernel; longer blocks are written in several chunks.
+static const int kContinuousFramesPerChunk = 1024;
+
+// TTL events waiting for the end of their snippet; further events are dropped until some are written.
+static const int kMaxPendingSnippets = 256;
+
+// Memory allowed for snippets queued for writing, counting both the queue and its XADD scratch, which each hold a
+// copy of every queued snippet. Each snippet can be up to a few megabytes.
+static const int kSnippetQueueBytes = 16 << 20;
+
+// channel_index, state and sample_number, ahead of the snippet's channels.
+static const int kSnippetHeaderSize = 16;
+
 RiverOutput::RiverOutput()
         : GenericProcessor("River Output"),
     
-          spike_schema_({river::FieldDefinition("channel_index", river::FieldDefinition::INT32, 4),
-                         river::FieldDefinition("unit_index", river::FieldDefinition::INT32, 4),
-                         river::FieldDefinition("sample_number", river::FieldDefinition::INT64, 8)
-              }) 
+          spike_schema_(SpikeSchema::Schema())
 {
 
     // Start with some sane defaults.
@@ -45,6 +56,7 @@ RiverOutput::RiverOutput()
     // Give some defaults
     writer_max_latency_ms_ = 5;
     writer_max_batch_size_ = 4096;
+    latency_probe_interval_ms_ = 100;
 
     createStreamName();
 
@@ -53,10 +65,18 @@ RiverOutput::RiverOutput()
 
 RiverOutput::~RiverOutput()
 {
-    if (createdWriter)
+    destroySinks();
+    if (continuous_writer_)
+    {
+        continuous_writer_->Stop();
+    }
+    if (feature_writer_)
+    {
+        feature_writer_->Stop();
+    }
+    if (snippet_writer_)
     {
-        writer_->Stop();
-        delete writer_;
+        snippet_writer_->Stop();
     }
 }
 
@@ -110,38 +130,49 @@ AudioProcessorEditor *RiverOutput::createEditor() {
 
 void RiverOutput::handleSpike(SpikePtr spike) 
 {
-    
-    RiverSpike river_spike;
-    int channel_index = spike->getChannelIndex();
-    
-    river_spike.channel_index = channel_index;
-    river_spike.sample_number = spike->getSampleNumber();
-    river_spike.unit_index = spike->getSortedId();
-
-    if (writing_thread_) {
-        writing_thread_->enqueue(reinterpret_cast<const char *>(&river_spike), 1);
-    } else {
-        writer_->WriteBytes(reinterpret_cast<const char *>(&river_spike), 1);
+    Sink* sink = sinkFor(spike->getStreamId());
+    if (!sink) {
+        return;
     }
+
+    SpikeSchema::Record river_spike;
+
+    river_spike.Set<RiverFields::channelIndex>(spike->getChannelIndex());
+    river_spike.Set<RiverFields::sampleNumber>(spike->getSampleNumber());
+    river_spike.Set<RiverFields::unitIndex>(spike->getSortedId());
+
+    sink->write(river_spike.data());
 }
 
 void RiverOutput::handleTTLEvent(TTLEventPtr event) 
 {
-
-    RiverEvent river_event;
-
     TTLEvent* ttl = static_cast<TTLEvent*>(event.get());
 
-    river_event.channel_index = event->getChannelIndex();
-    river_event.state = (ttl->getLine() + 1) * (ttl->getState() ? 1 : -1);
-    river_event.sample_number = event->getSampleNumber();
+    if (snippet_thread_ && ttl->getState() && event->getStreamId() == snippet_stream_id_) {
+        if ((int) pending_snippets_.size() < kMaxPendingSnippets) {
+            pending_snippets_.push_back(PendingSnippet{
+                (int32) event->getChannelIndex(),
+                (int32) ttl->getLine() + 1,
+                event->getSampleNumber()
+            });
+        } else {
+            snippets_dropped_++;
+        }
+    }
 
-    if (writing_thread_) {
-        writing_thread_->enqueue(reinterpret_cast<const char *>(&river_event), 1);
-    } else {
-        writer_->WriteBytes(reinterpret_cast<const char *>(&river_event), 1);
+    Sink* sink = sinkFor(event->getStreamId());
+    if (!sink) {
+        return;
     }
 
+    TtlEventSchema::Record river_event;
+
+    river_event.Set<RiverFields::channelIndex>(event->getChannelIndex());
+    river_event.Set<RiverFields::state>((ttl->getLine() + 1) * (ttl->getState() ? 1 : -1));
+    river_event.Set<RiverFields::sampleNumber>(event->getSampleNumber());
+
+    sink->write(river_event.data());
+
     /*const char* ptr = (const char*)event->getBinaryDataPointer();
     size_t data_size = eventInfo->getDataSize();
 
@@ -173,10 +204,13 @@ bool RiverOutput::startAcquisition()
 
         LOGD("River Output Connection: ", redis_connection_hostname_, ":", redis_connection_port_);
 
-        try {
-            writer_ = new river::StreamWriter(connection);
-        } catch (const std::exception& e) {
-            LOGC("Failed to connect to Redis: ", e.what());
+        if (shouldConsumeSpikes() && spikeChannels.size() == 0) {
+            // Can't consume spikes if there are no spike channels.
+            CoreServices::sendStatusMessage("River Output has no spike channels.");
+            return false;
+        }
+
+        if (!createSinks(connection)) {
             CoreServices::sendStatusMessage("Failed to connect to Redis.");
             CoreServices::setAcquisitionStatus(false);
             isEnabled = false;
@@ -184,29 +218,157 @@ bool RiverOutput::startAcquisition()
             return false;
         }
 
-        LOGD("Created StreamWriter.");
-
-
-        std::unordered_map<std::string, std::string> metadata;
-
-        if (shouldConsumeSpikes())
-        {
-            if (spikeChannels.size() == 0) {
-                // Can't consume spikes if there are no spike channels.
-                CoreServices::sendStatusMessage("River Output has no spike channels.");
-                return false;
-            }
-
-            // Assume that all spike channels have the same details.
-            auto spike_channel = getSpikeChannel(0);
-            metadata["prepeak_samples"] = std::to_string(spike_channel->getPrePeakSamples());
-            metadata["postpeak_samples"] = std::to_string(spike_channel->getPostPeakSamples());
-            metadata["sampling_rate"] = std::to_string(CoreServices::getGlobalSampleRate());
-        }
-
        LOGD("Initialized StreamWriter.");
-       writer_->Initialize(sn, getSchema(), metadata);
        createdWriter = true;
+
+       if (continuous_writer_)
+       {
+           continuous_writer_->Stop();
+           continuous_writer_.reset();
+       }
+       continuous_buffer_channels_.clear();
+       continuous_inv_scales_.clear();
+
+       if (!continuous_channels_.empty() && !getDataStreams().isEmpty())
+       {
+           const DataStream* stream = getDataStreams()[0];
+           auto channels = stream->getContinuousChannels();
+
+           std::vector<river::FieldDefinition> fields;
+           std::vector<float> bitVolts;
+           fields.emplace_back(RiverFields::sampleNumber, river::FieldDefinition::INT64, 8);
+           for (int c : parseChannelList(continuous_channels_, channels.size()))
+           {
+               if (export_int16_) {
+                   // Int16 fields are stored as 2-byte FIXED_WIDTH_BYTES, which River Input reads back as int16.
+                   fields.emplace_back(channels[c]->getName().toStdString(),
+                                       river::FieldDefinition::FIXED_WIDTH_BYTES,
+                                       2);
+               } else {
+                   fields.emplace_back(channels[c]->getName().toStdString(), river::FieldDefinition::FLOAT, 4);
+               }
+               continuous_buffer_channels_.push_back(channels[c]->getGlobalIndex());
+               bitVolts.push_back(channels[c]->getBitVolts() > 0 ? channels[c]->getBitVolts() : 1.0f);
+               continuous_inv_scales_.push_back(1.0f / bitVolts.back());
+           }
+
+           std::unordered_map<std::string, std::string> continuous_metadata;
+           if (export_int16_ && !bitVolts.empty()) {
+               continuous_metadata[RiverMetadata::bitVolts] = std::to_string(bitVolts[0]);
+               continuous_metadata[RiverMetadata::channelBitVolts] = RiverChannelField::formatScales(bitVolts);
+           }
+           continuous_metadata["sampling_rate"] = std::to_string(stream->getSampleRate() / jmax(1, decimation_factor_));
+           if (decimation_factor_ > 1) {
+               // Frames keep the input's sample numbers, so they line up with spikes and events.
+               continuous_metadata["decimation_factor"] = std::to_string(decimation_factor_);
+               continuous_metadata["decimation_delay_samples"] =
+                       std::to_string(PolyphaseDecimator::delaySamplesFor(decimation_factor_));
+           }
+
+           try {
+               continuous_writer_ = std::make_unique<river::StreamWriter>(connection);
+               continuous_writer_->Initialize(continuousStreamName(), river::StreamSchema(fields), continuous_metadata);
+           } catch (const std::exception& e) {
+               LOGC("Failed to create continuous stream: ", e.what());
+               CoreServices::sendStatusMessage("River Output: continuous export disabled.");
+               continuous_writer_.reset();
+               continuous_buffer_channels_.clear();
+           }
+       }
+
+       if (feature_writer_)
+       {
+           feature_writer_->Stop();
+           feature_writer_.reset();
+       }
+       feature_buffer_channels_.clear();
+
+       if (!feature_channels_.empty() && feature_window_ms_ > 0 && !getDataStreams().isEmpty())
+       {
+           const DataStream* stream = getDataStreams()[0];
+           auto channels = stream->getContinuousChannels();
+           auto selected = parseChannelList(feature_channels_, channels.size());
+           const int windowSamples = jmax(1, roundToInt(feature_window_ms_ * stream->getSampleRate() / 1000.0));
+
+           // Grouped by feature, matching the order of FeatureExtractor::outputs().
+           std::vector<river::FieldDefinition> fields;
+           fields.emplace_back(RiverFields::sampleNumber, river::FieldDefinition::INT64, 8);
+           for (const char *suffix : { "_rms", "_band_power", "_crossings" })
+           {
+               for (int c : selected)
+               {
+                   fields.emplace_back(channels[c]->getName().toStdString() + suffix,
+                                       river::FieldDefinition::FLOAT,
+                                       4);
+               }
+           }
+           for (int c : selected)
+           {
+               feature_buffer_channels_.push_back(channels[c]->getGlobalIndex());
+           }
+
+           // Each frame is labelled with the sample number of the last sample in its window.
+           std::unordered_map<std::string, std::string> feature_metadata;
+           feature_metadata["sampling_rate"] = std::to_string(stream->getSampleRate() / windowSamples);
+           feature_metadata["window_samples"] = std::to_string(windowSamples);
+           feature_metadata["band_low_hz"] = std::to_string(feature_band_low_hz_);
+           feature_metadata["band_high_hz"] = std::to_string(feature_band_high_hz_);
+           feature_metadata["threshold_uv"] = std::to_string(feature_threshold_uv_);
+
+           try {
+               feature_writer_ = std::make_unique<river::StreamWriter>(connection);
+               feature_writer_->Initialize(featureStreamName(), river::StreamSchema(fields), feature_metadata);
+           } catch (const std::exception& e) {
+               LOGC("Failed to create feature stream: ", e.what());
+               CoreServices::sendStatusMessage("River Output: feature export disabled.");
+               feature_writer_.reset();
+               feature_buffer_channels_.clear();
+           }
+       }
+
+       if (snippet_writer_)
+       {
+           snippet_writer_->Stop();
+           snippet_writer_.reset();
+       }
+       snippet_buffer_channels_.clear();
+
+       if (!snippet_channels_.empty() && !getDataStreams().isEmpty())
+       {
+           const DataStream* stream = getDataStreams()[0];
+           auto channels = stream->getContinuousChannels();
+           snippet_pre_samples_ = jmax(0, roundToInt(snippet_pre_ms_ * stream->getSampleRate() / 1000.0));
+           snippet_post_samples_ = jmax(1, roundToInt(snippet_post_ms_ * stream->getSampleRate() / 1000.0));
+           const int length = snippet_pre_samples_ + snippet_post_samples_;
+
+           // The header matches TtlEventSchema, so snippets can be matched to the events River Output also writes.
+           std::vector<river::FieldDefinition> fields;
+           fields.emplace_back(RiverFields::channelIndex, river::FieldDefinition::INT32, 4);
+           fields.emplace_back(RiverFields::state, river::FieldDefinition::INT32, 4);
+           fields.emplace_back(RiverFields::sampleNumber, river::FieldDefinition::INT64, 8);
+           for (int c : parseChannelList(snippet_channels_, channels.size()))
+           {
+               fields.emplace_back(channels[c]->getName().toStdString(),
+                                   river::FieldDefinition::FIXED_WIDTH_BYTES,
+                                   length * (int) sizeof(float));
+               snippet_buffer_channels_.push_back(channels[c]->getGlobalIndex());
+           }
+
+           std::unordered_map<std::string, std::string> snippet_metadata;
+           snippet_metadata["sampling_rate"] = std::to_string(stream->getSampleRate());
+           snippet_metadata["pre_samples"] = std::to_string(snippet_pre_samples_);
+           snippet_metadata["post_samples"] = std::to_string(snippet_post_samples_);
+
+           try {
+               snippet_writer_ = std::make_unique<river::StreamWriter>(connection);
+               snippet_writer_->Initialize(snippetStreamName(), river::StreamSchema(fields), snippet_metadata);
+           } catch (const std::exception& e) {
+               LOGC("Failed to create snippet stream: ", e.what());
+               CoreServices::sendStatusMessage("River Output: snippet export disabled.");
+               snippet_writer_.reset();
+               snippet_buffer_channels_.clear();
+           }
+       }
     }
         
     if (editor) {
@@ -216,22 +378,118 @@ bool RiverOutput::startAcquisition()
 
     // If latency or batch size are nonpositive, write everything synchronously.
     if (maxLatencyMs() > 0 && maxBatchSize() > 0) {
-        writing_thread_ = std::make_unique<RiverWriterThread>(writer_, maxBatchSize(), maxLatencyMs());
-        writing_thread_->startThread();
+        for (auto& sink : sinks_) {
+            sink->thread = std::make_unique<RiverWriterThread>(sink->writer.get(),
+                                                               *sink->layout,
+                                                               maxBatchSize(),
+                                                               maxLatencyMs());
+            sink->thread->startThread();
+        }
         std::cout << "Writing to River asynchronously with stream name " << sn << std::endl;
     } else {
         std::cout << "Writing to River synchronously with stream name " << sn << std::endl;
     }
 
+    next_probe_sample_ = -1;
+    num_probes_written_ = 0;
+
+    // Continuous frames always go through a writer thread: one block can hold far more samples than events.
+    decimator_.reset();
+    continuous_frames_dropped_ = 0;
+    if (continuous_writer_) {
+        if (decimation_factor_ > 1) {
+            decimator_ = std::make_unique<PolyphaseDecimator>(decimation_factor_,
+                                                              (int) continuous_buffer_channels_.size(),
+                                                              kContinuousFramesPerChunk);
+        }
+        int framesPerSecond = (int) getDataStreams()[0]->getSampleRate() / jmax(1, decimation_factor_);
+        int capacity = jmax(maxBatchSize(), framesPerSecond);
+        continuous_thread_ = std::make_unique<RiverWriterThread>(continuous_writer_.get(),
+                                                                 river::StreamLayout(continuous_writer_->schema()),
+                                                                 capacity,
+                                                                 jmax(1, maxLatencyMs()));
+        continuous_thread_->startThread();
+        continuous_sources_.resize(continuous_buffer_channels_.size());
+        continuous_frames_.resize((size_t) kContinuousFramesPerChunk * continuous_writer_->schema().sample_size());
+    }
+
+    // Features start afresh each acquisition, so no window straddles a restart of the sample clock.
+    feature_extractor_.reset();
+    feature_windows_dropped_ = 0;
+    if (feature_writer_) {
+        const DataStream* stream = getDataStreams()[0];
+        const int windowSamples = jmax(1, roundToInt(feature_window_ms_ * stream->getSampleRate() / 1000.0));
+        feature_extractor_ = std::make_unique<FeatureExtractor>((int) feature_buffer_channels_.size(),
+                                                                stream->getSampleRate(),
+                                                                windowSamples,
+                                                                feature_band_low_hz_,
+                                                                feature_band_high_hz_,
+                                                                feature_threshold_uv_,
+                                                                kContinuousFramesPerChunk);
+        int windowsPerSecond = jmax(1, (int) stream->getSampleRate() / windowSamples);
+        feature_thread_ = std::make_unique<RiverWriterThread>(feature_writer_.get(),
+                                                              river::StreamLayout(feature_writer_->schema()),
+                                                              jmax(maxBatchSize(), windowsPerSecond),
+                                                              jmax(1, maxLatencyMs()));
+        feature_thread_->startThread();
+        feature_sources_.resize(feature_buffer_channels_.size());
+        feature_frames_.resize((size_t) feature_extractor_->maxOutputs() * feature_writer_->schema().sample_size());
+    }
+
+    snippet_history_.reset();
+    pending_snippets_.clear();
+    snippets_dropped_ = 0;
+    if (snippet_writer_) {
+        const DataStream* stream = getDataStreams()[0];
+        const int length = snippet_pre_samples_ + snippet_post_samples_;
+        const int sampleSize = snippet_writer_->schema().sample_size();
+        snippet_stream_id_ = stream->getStreamId();
+
+        // Blocks are far shorter than a second, so a pending snippet's first sample is still held when its last
+        // arrives.
+        snippet_history_ = std::make_unique<ChannelHistory>((int) snippet_buffer_channels_.size(),
+                                                            length + (int) stream->getSampleRate());
+        // The queue keeps one slot free, so two slots always fit one snippet, even one larger than the budget.
+        const size_t bytesPerSnippet = sampleSize + river::WriteScratch::BytesPerSample(sampleSize);
+        const int queueCapacity = jmax(2, (int) (kSnippetQueueBytes / bytesPerSnippet));
+        snippet_thread_ = std::make_unique<RiverWriterThread>(snippet_writer_.get(),
+                                                              river::StreamLayout(snippet_writer_->schema()),
+                                                              queueCapacity,
+                                                              jmax(1, maxLatencyMs()));
+        snippet_thread_->startThread();
+        snippet_sources_.resize(snippet_buffer_channels_.size());
+        snippet_record_.resize(sampleSize);
+        snippet_samples_.resize(length);
+        pending_snippets_.reserve(kMaxPendingSnippets);
+    }
+
     return true;
 }
 
 
 bool RiverOutput::stopAcquisition() 
 {
-    if (writing_thread_) {
-        writing_thread_->stopThread(1000);
-        writing_thread_.reset();
+    for (auto& sink : sinks_) {
+        if (sink->thread) {
+            sink->thread->stopThread(1000);
+            sink->thread.reset();
+        }
+    }
+
+    if (continuous_thread_) {
+        continuous_thread_->stopThread(1000);
+        continuous_thread_.reset();
+    }
+
+    if (feature_thread_) {
+        feature_thread_->stopThread(1000);
+        feature_thread_.reset();
+    }
+
+    // Snippets still waiting for samples are dropped.
+    if (snippet_thread_) {
+        snippet_thread_->stopThread(1000);
+        snippet_thread_.reset();
     }
 
     if (editor) {
@@ -245,23 +503,294 @@ bool RiverOutput::stopAcquisition()
 
 void RiverOutput::process(AudioSampleBuffer &buffer) 
 {
-    if (createdWriter) {
+    if (!createdWriter) {
+        return;
+    }
+
+    if (continuous_thread_) {
+        writeContinuous(buffer);
+    }
+
+    if (feature_thread_) {
+        writeFeatures(buffer);
+    }
+
+    if (snippet_thread_) {
+        writeSnippetHistory(buffer);
+    }
+
+    if (isLatencyProbe()) {
+        writeLatencyProbes();
+    } else {
         checkForEvents(shouldConsumeSpikes());
     }
+
+    // Events of this block whose snippets end within it.
+    if (snippet_thread_) {
+        flushSnippets();
+    }
+}
+
+void RiverOutput::writeLatencyProbes()
+{
+    if (getDataStreams().isEmpty() || latency_probe_interval_ms_ <= 0) {
+        return;
+    }
+
+    const DataStream* stream = getDataStreams()[0];
+    Sink* sink = sinkFor(stream->getStreamId());
+    if (!sink) {
+        return;
+    }
+
+    const int64 blockStart = getFirstSampleNumberForBlock(stream->getStreamId());
+    const int64 blockEnd = blockStart + getNumSamplesInBlock(stream->getStreamId());
+    const int64 interval = jmax((int64) 1, (int64) (latency_probe_interval_ms_ * stream->getSampleRate() / 1000.0));
+
+    if (next_probe_sample_ < blockStart) {
+        next_probe_sample_ = blockStart;
+    }
+
+    for (; next_probe_sample_ < blockEnd; next_probe_sample_ += interval) {
+        LatencyProbeSchema::Record probe;
+
+        // Alternates line 0 on and off, so the echoed stream also reads as ordinary TTL events.
+        probe.Set<RiverFields::channelIndex>(0);
+        probe.Set<RiverFields::state>(num_probes_written_ % 2 == 0 ? 1 : -1);
+        probe.Set<RiverFields::sampleNumber>(next_probe_sample_);
+        probe.Set<RiverFields::sentUs>(RiverLatency::nowMicros());
+
+        sink->write(probe.data());
+        num_probes_written_++;
+    }
+}
+
+void RiverOutput::writeContinuous(AudioSampleBuffer &buffer)
+{
+    const uint16 streamId = getDataStreams()[0]->getStreamId();
+    const int numSamples = getNumSamplesInBlock(streamId);
+    const int64 firstSample = getFirstSampleNumberForBlock(streamId);
+    const int numChannels = (int) continuous_buffer_channels_.size();
+
+    for (int k = 0; k < numChannels; k++) {
+        continuous_sources_[k] = buffer.getReadPointer(continuous_buffer_channels_[k]);
+    }
+
+    for (int offset = 0; offset < numSamples; offset += kContinuousFramesPerChunk) {
+        int n = jmin(kContinuousFramesPerChunk, numSamples - offset);
+        if (decimator_) {
+            int64 firstOutput;
+            int numOutputs = decimator_->process(continuous_sources_.data(), n, firstSample + offset, &firstOutput);
+            if (numOutputs > 0) {
+                enqueueFrames(decimator_->outputs(), numOutputs, firstOutput, decimator_->factor());
+            }
+        } else {
+            enqueueFrames(continuous_sources_.data(), n, firstSample + offset, 1);
+        }
+
+        for (auto &source : continuous_sources_) {
+            source += n;
+        }
+    }
+}
+
+void RiverOutput::writeFeatures(AudioSampleBuffer &buffer)
+{
+    const uint16 streamId = getDataStreams()[0]->getStreamId();
+    const int numSamples = getNumSamplesInBlock(streamId);
+    const int64 firstSample = getFirstSampleNumberForBlock(streamId);
+    const int numChannels = (int) feature_buffer_channels_.size();
+
+    for (int k = 0; k < numChannels; k++) {
+        feature_sources_[k] = buffer.getReadPointer(feature_buffer_channels_[k]);
+    }
+
+    for (int offset = 0; offset < numSamples; offset += kContinuousFramesPerChunk) {
+        int n = jmin(kContinuousFramesPerChunk, numSamples - offset);
+        int64 firstWindow;
+        int numWindows = feature_extractor_->process(feature_sources_.data(), n, firstSample + offset, &firstWindow);
+        if (numWindows > 0) {
+            river::internal::InterleaveFrames(feature_extractor_->outputs(),
+                                              FeatureExtractor::kNumFeatures * numChannels,
+                                              numWindows,
+                                              firstWindow,
+                                              feature_frames_.data(),
+                                              feature_extractor_->windowSamples());
+            // As for continuous frames, drop what doesn't fit while the writer is behind, and count it.
+            int numToEnqueue = jmin(numWindows, feature_thread_->freeSpace());
+            if (numToEnqueue > 0) {
+                feature_thread_->enqueue(feature_frames_.data(), numToEnqueue);
+            }
+            feature_windows_dropped_ += numWindows - numToEnqueue;
+        }
+
+        for (auto &source : feature_sources_) {
+            source += n;
+        }
+    }
+}
+
+void RiverOutput::writeSnippetHistory(AudioSampleBuffer &buffer)
+{
+    const uint16 streamId = getDataStreams()[0]->getStreamId();
+    const int numSamples = getNumSamplesInBlock(streamId);
+    const int64 firstSample = getFirstSampleNumberForBlock(streamId);
+    const int numChannels = (int) snippet_buffer_channels_.size();
+
+    for (int k = 0; k < numChannels; k++) {
+        snippet_sources_[k] = buffer.getReadPointer(snippet_buffer_channels_[k]);
+    }
+
+    // Flushing after every chunk keeps pending snippets from outliving their first samples, however long the block.
+    for (int offset = 0; offset < numSamples; offset += kContinuousFramesPerChunk) {
+        int n = jmin(kContinuousFramesPerChunk, numSamples - offset);
+        snippet_history_->write(snippet_sources_.data(), n, firstSample + offset);
+        flushSnippets();
+
+        for (auto &source : snippet_sources_) {
+            source += n;
+        }
+    }
+}
+
+void RiverOutput::flushSnippets()
+{
+    const int length = snippet_pre_samples_ + snippet_post_samples_;
+    const int numChannels = (int) snippet_buffer_channels_.size();
+    char* record = snippet_record_.data();
+
+    size_t written = 0;
+    for (; written < pending_snippets_.size(); written++) {
+        const PendingSnippet &snippet = pending_snippets_[written];
+        if (snippet.sample_number + snippet_post_samples_ > snippet_history_->endSample()) {
+            // Events arrive in order, so later snippets aren't complete either.
+            break;
+        }
+        if (snippet_thread_->freeSpace() < 1) {
+            // The writer is behind; drop rather than wait, since the history would move past the snippet.
+            snippets_dropped_++;
+            continue;
+        }
+
+        memcpy(record, &snippet.channel_index, 4);
+        memcpy(record + 4, &snippet.state, 4);
+        memcpy(record + 8, &snippet.sample_number, 8);
+        for (int c = 0; c < numChannels; c++) {
+            snippet_history_->read(c, snippet.sample_number - snippet_pre_samples_, length, snippet_samples_.data());
+            memcpy(record + kSnippetHeaderSize + (size_t) c * length * sizeof(float),
+                   snippet_samples_.data(),
+                   (size_t) length * sizeof(float));
+        }
+        snippet_thread_->enqueue(record, 1);
+    }
+    pending_snippets_.erase(pending_snippets_.begin(), pending_snippets_.begin() + written);
+}
+
+void RiverOutput::enqueueFrames(const float *const *channels, int num_frames, int64 first_sample, int sample_step)
+{
+    const int numChannels = (int) continuous_buffer_channels_.size();
+    if (export_int16_) {
+        river::internal::InterleaveFramesInt16(channels,
+                                               continuous_inv_scales_.data(),
+                                               numChannels,
+                                               num_frames,
+                                               first_sample,
+                                               continuous_frames_.data(),
+                                               sample_step);
+    } else {
+        river::internal::InterleaveFrames(channels,
+                                          numChannels,
+                                          num_frames,
+                                          first_sample,
+                                          continuous_frames_.data(),
+                                          sample_step);
+    }
+
+    // The queue holds about a second of frames; if Redis stalls for longer, drop what doesn't fit and count it.
+    int numToEnqueue = jmin(num_frames, continuous_thread_->freeSpace());
+    if (numToEnqueue > 0) {
+        continuous_thread_->enqueue(continuous_frames_.data(), numToEnqueue);
+    }
+    continuous_frames_dropped_ += num_frames - numToEnqueue;
+}
+
+std::vector<int> RiverOutput::parseChannelList(const std::string &spec, int num_channels)
+{
+    std::vector<int> channels;
+    for (const String &token : StringArray::fromTokens(String(spec), ",", ""))
+    {
+        String range = token.trim();
+        if (range.isEmpty()) {
+            continue;
+        }
+        int first = range.upToFirstOccurrenceOf("-", false, false).getIntValue();
+        int last = range.contains("-") ? range.fromFirstOccurrenceOf("-", false, false).getIntValue() : first;
+        for (int c = jmax(1, first); c <= jmin(last, num_channels); c++) {
+            channels.push_back(c - 1);
+        }
+    }
+    std::sort(channels.begin(), channels.end());
+    channels.erase(std::unique(channels.begin(), channels.end()), channels.end());
+    return channels;
 }
 
 std::string RiverOutput::streamName() const {
     return stream_name;
 }
 
-int64_t RiverOutput::totalSamplesWritten() const {
-    if (createdWriter) {
-        return writer_->total_samples_written();
+std::string RiverOutput::streamNameFor(uint16 streamId) const {
+    if (split_data_streams_) {
+        return stream_name + "-" + std::to_string(streamId);
+    }
+    return stream_name;
+}
+
+std::string RiverOutput::continuousStreamName() const {
+    return stream_name + "-continuous";
+}
+
+int64_t RiverOutput::totalFramesWritten() const {
+    if (continuous_writer_) {
+        return continuous_writer_->total_samples_written();
+    } else {
+        return 0;
+    }
+}
+
+std::string RiverOutput::featureStreamName() const {
+    return stream_name + "-features";
+}
+
+int64_t RiverOutput::totalFeatureWindowsWritten() const {
+    if (feature_writer_) {
+        return feature_writer_->total_samples_written();
+    } else {
+        return 0;
+    }
+}
+
+std::string RiverOutput::snippetStreamName() const {
+    return stream_name + "-snippets";
+}
+
+int64_t RiverOutput::totalSnippetsWritten() const {
+    if (snippet_writer_) {
+        return snippet_writer_->total_samples_written();
     } else {
         return 0;
     }
 }
 
+int64_t RiverOutput::totalSamplesWritten() const {
+    int64_t total = 0;
+    if (createdWriter) {
+        for (const auto& sink : sinks_) {
+            total += sink->writer->total_samples_written();
+        }
+    }
+    return total;
+}
+
 const std::string &RiverOutput::redisConnectionHostname() const {
     return redis_connection_hostname_;
 }
@@ -293,6 +822,19 @@ void RiverOutput::saveCustomParametersToXml(XmlElement *parentElement) {
     mainNode->setAttribute("password", redisConnectionPassword());
     mainNode->setAttribute("max_latency_ms", maxLatencyMs());
     mainNode->setAttribute("max_batch_size", maxBatchSize());
+    mainNode->setAttribute("latency_probe_interval_ms", latencyProbeIntervalMs());
+    mainNode->setAttribute("continuous_channels", continuousChannels());
+    mainNode->setAttribute("decimation_factor", decimationFactor());
+    mainNode->setAttribute("export_int16", exportInt16());
+    mainNode->setAttribute("split_data_streams", splitDataStreams());
+    mainNode->setAttribute("feature_channels", featureChannels());
+    mainNode->setAttribute("feature_window_ms", featureWindowMs());
+    mainNode->setAttribute("feature_band_low_hz", featureBandLowHz());
+    mainNode->setAttribute("feature_band_high_hz", featureBandHighHz());
+    mainNode->setAttribute("feature_threshold_uv", featureThresholdUv());
+    mainNode->setAttribute("snippet_channels", snippetChannels());
+    mainNode->setAttribute("snippet_pre_ms", snippetPreMs());
+    mainNode->setAttribute("snippet_post_ms", snippetPostMs());
 
     if (event_schema_) {
         std::string event_schema_json = event_schema_->ToJson();
@@ -318,6 +860,21 @@ void RiverOutput::loadCustomParametersFromXml(XmlElement* xml) {
         if (mainNode->hasAttribute("max_batch_size")) {
             writer_max_batch_size_ = mainNode->getIntAttribute("max_batch_size");
         }
+        if (mainNode->hasAttribute("latency_probe_interval_ms")) {
+            latency_probe_interval_ms_ = mainNode->getIntAttribute("latency_probe_interval_ms");
+        }
+        continuous_channels_ = mainNode->getStringAttribute("continuous_channels", "").toStdString();
+        decimation_factor_ = jmax(1, mainNode->getIntAttribute("decimation_factor", 1));
+        export_int16_ = mainNode->getBoolAttribute("export_int16", false);
+        split_data_streams_ = mainNode->getBoolAttribute("split_data_streams", false);
+        feature_channels_ = mainNode->getStringAttribute("feature_channels", "").toStdString();
+        feature_window_ms_ = jmax(1, mainNode->getIntAttribute("feature_window_ms", 20));
+        feature_band_low_hz_ = mainNode->getDoubleAttribute("feature_band_low_hz", 13.0);
+        feature_band_high_hz_ = mainNode->getDoubleAttribute("feature_band_high_hz", 30.0);
+        feature_threshold_uv_ = (float) mainNode->getDoubleAttribute("feature_threshold_uv", -50.0);
+        snippet_channels_ = mainNode->getStringAttribute("snippet_channels", "").toStdString();
+        snippet_pre_ms_ = jmax(0, mainNode->getIntAttribute("snippet_pre_ms", 50));
+        snippet_post_ms_ = jmax(1, mainNode->getIntAttribute("snippet_post_ms", 200));
         if (mainNode->hasAttribute("event_schema_json")) {
             String s = mainNode->getStringAttribute("event_schema_json");
             std::string j = s.toStdString();
@@ -354,6 +911,10 @@ bool RiverOutput::shouldConsumeSpikes() const {
     return !event_schema_;
 }
 
+bool RiverOutput::isLatencyProbe() const {
+    return event_schema_ && LatencyProbeSchema::Matches(*event_schema_);
+}
+
 river::StreamSchema RiverOutput::getSchema() const {
     if (event_schema_) {
         return *event_schema_.get();
@@ -361,16 +922,119 @@ river::StreamSchema RiverOutput::getSchema() const {
     return spike_schema_;
 }
 
+bool RiverOutput::createSinks(const river::RedisConnection& connection)
+{
+    destroySinks();
+
+    // One sink per data stream when split, otherwise a single sink shared by every data stream.
+    std::vector<std::vector<const DataStream*>> groups;
+    for (auto stream : getDataStreams())
+    {
+        if (split_data_streams_ || groups.empty()) {
+            groups.emplace_back();
+        }
+        groups.back().push_back(stream);
+    }
+
+    for (const auto& group : groups)
+    {
+        std::unordered_map<std::string, std::string> metadata;
+
+        // A shared stream only gets a rate if all of its data streams agree on one.
+        float sampleRate = group.front()->getSampleRate();
+        for (auto stream : group) {
+            if (stream->getSampleRate() != sampleRate) {
+                sampleRate = CoreServices::getGlobalSampleRate();
+                break;
+            }
+        }
+
+        if (shouldConsumeSpikes())
+        {
+            // Assume that all spike channels of a stream have the same details.
+            for (auto spike_channel : spikeChannels)
+            {
+                if (std::find(group.begin(), group.end(), getDataStream(spike_channel->getStreamId())) == group.end()) {
+                    continue;
+                }
+                metadata["prepeak_samples"] = std::to_string(spike_channel->getPrePeakSamples());
+                metadata["postpeak_samples"] = std::to_string(spike_channel->getPostPeakSamples());
+                break;
+            }
+            metadata["sampling_rate"] = std::to_string(sampleRate);
+        }
+        else if (isLatencyProbe())
+        {
+            metadata["sampling_rate"] = std::to_string(sampleRate);
+            metadata["latency_probe_interval_ms"] = std::to_string(latencyProbeIntervalMs());
+        }
+        if (split_data_streams_) {
+            metadata["data_stream_name"] = group.front()->getName().toStdString();
+        }
+
+        auto sink = std::make_unique<Sink>();
+        try {
+            sink->writer = std::make_unique<river::StreamWriter>(connection);
+            sink->writer->Initialize(streamNameFor(group.front()->getStreamId()), getSchema(), metadata);
+        } catch (const std::exception& e) {
+            LOGC("Failed to create River stream: ", e.what());
+            destroySinks();
+            return false;
+        }
+        sink->layout = std::make_unique<river::StreamLayout>(sink->writer->schema());
+
+        for (auto stream : group) {
+            sink_by_stream_[stream->getStreamId()] = sink.get();
+        }
+        sinks_.push_back(std::move(sink));
+    }
+
+    LOGD("Created ", sinks_.size(), " StreamWriter(s).");
+    return true;
+}
+
+void RiverOutput::destroySinks()
+{
+    sink_by_stream_.clear();
+    for (auto& sink : sinks_) {
+        if (sink->thread) {
+            sink->thread->stopThread(1000);
+        }
+        if (sink->writer) {
+            sink->writer->Stop();
+        }
+    }
+    sinks_.clear();
+}
+
+RiverOutput::Sink* RiverOutput::sinkFor(uint16 streamId)
+{
+    // Data streams added since the sinks were created have none; their records are dropped.
+    auto it = sink_by_stream_.find(streamId);
+    return it != sink_by_stream_.end() ? it->second : nullptr;
+}
+
+void RiverOutput::Sink::write(const char* data)
+{
+    if (thread) {
+        thread->enqueue(data, 1);
+    } else {
+        writer->WriteBytes(data, 1);
+    }
+}
+
 RiverWriterThread::RiverWriterThread(
         river::StreamWriter* writer,
+        const river::StreamLayout& layout,
         int capacity_samples,
         int batch_period_ms)
-        : juce::Thread("RiverWriter") {
+        : juce::Thread("RiverWriter"),
+          scratch_(capacity_samples, layout.sample_size()) {
     writer_ = writer;
     writing_queue_ = std::make_unique<AbstractFifo>(capacity_samples);
     batch_period_ms_ = batch_period_ms;
 
-    sample_size_ = writer_->schema().sample_size();
+    sample_size_ = layout.sample_size();
 
     buffer_.resize(capacity_samples * sample_size_);
 }
@@ -385,12 +1049,38 @@ void RiverWriterThread::run() {
                                       start2,
                                       size2);
 
-        if (size1 > 0) {
-            writer_->WriteBytes(&buffer_.front() + start1 * sample_size_, size1);
-        }
+        // A failed batch is counted as written by the stream writer, so the
+        // stream stays consistent; log it and keep draining the queue.
+        try {
+            if (size1 > 0) {
+                writer_->WriteBytes(&buffer_.front() + start1 * sample_size_, size1, scratch_);
+            }
 
-        if (size2 > 0) {
-            writer_->WriteBytes(&buffer_.front() + start2 * sample_size_, size2);
+            if (size2 > 0) {
+                writer_->WriteBytes(&buffer_.front() + start2 * sample_size_, size2, scratch_);
+            }
+
+            if (is_failing_ && size1 + size2 > 0) {
+                LOGC("Writing to River stream recovered; ", unlogged_failures_,
+                     " more batches failed since the last report.");
+                is_failing_ = false;
+                unlogged_failures_ = 0;
+            }
+        } catch (const std::exception& e) {
+            // While Redis is unreachable every batch fails, so log the first failure and then one summary per period.
+            auto now = Time::getMillisecondCounter();
+            unlogged_failures_++;
+            if (!is_failing_ || now - last_failure_log_ms_ >= kFailureLogPeriodMs) {
+                if (is_failing_) {
+                    LOGC(unlogged_failures_, " batches failed to write to River stream in the last ",
+                         (int) (now - last_failure_log_ms_), " ms: ", e.what());
+                } else {
+                    LOGC("Failed to write to River stream: ", e.what());
+                }
+                is_failing_ = true;
+                last_failure_log_ms_ = now;
+                unlogged_failures_ = 0;
+            }
         }
 
         writing_queue_->finishedRead(size1 + size2);
@@ -399,6 +1089,10 @@ void RiverWriterThread::run() {
     }
 }
 
+int RiverWriterThread::freeSpace() const {
+    return writing_queue_->getFreeSpace();
+}
+
 void RiverWriterThread::enqueue(const char *data, int num_samples) {
     int start1, size1, start2, size2;
     writing_queue_->prepareToWrite(num_samples, start1, size1, start2, size2);
@@ -410,6 +1104,5 @@ void RiverWriterThread::enqueue(const char *data, int num_samples) {
     if (size2 > 0) {
         memcpy(&buffer_.front() + start2 * sample_size_, data + size1 * sample_size_, size2 * sample_size_);
     }
-    jassert(size1 + size2 == num_samples);
     writing_queue_->finishedWrite(size1 + size2);
 }
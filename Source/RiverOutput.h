@@ -26,6 +26,21 @@
 
 #include <ProcessorHeaders.h>
 #include "river/river.h"
+#include "RiverLatency.h"
+#include "RiverDsp.h"
+#include "RiverChannels.h"
+
+#include <atomic>
+
+/** Field names used by the schemas that RiverOutput writes */
+namespace RiverFields
+{
+    inline constexpr char channelIndex[] = "channel_index";
+    inline constexpr char unitIndex[] = "unit_index";
+    inline constexpr char state[] = "state";
+    inline constexpr char sampleNumber[] = "sample_number";
+    inline constexpr char sentUs[] = "sent_us";
+}
 
 
 /** 
@@ -39,6 +54,7 @@ public:
 
     /** Constructor */
     RiverWriterThread(river::StreamWriter* writer,
+                      const river::StreamLayout& layout,
                       int capacity_samples,
                       int batch_period_ms);
 
@@ -48,17 +64,29 @@ public:
     /** Run thread */
     void run() override;
 
-    /** Adds bytes to the writing queue */
+    /** Adds bytes to the writing queue; at most freeSpace() samples fit, and any beyond that are dropped */
     void enqueue(const char *data, int num_samples);
 
+    /** Number of samples that can be enqueued without overflowing the queue */
+    int freeSpace() const;
+
 private:
     
     std::unique_ptr<AbstractFifo> writing_queue_;
     
     std::vector<char> buffer_;
+
+    // Preallocated XADD commands, so that flushing a batch doesn't allocate.
+    river::WriteScratch scratch_;
     
     int batch_period_ms_;
     int sample_size_;
+
+    // Write failures are logged once, then summarized at most once per period until a batch succeeds again.
+    static constexpr uint32 kFailureLogPeriodMs = 1000;
+    bool is_failing_ = false;
+    uint32 last_failure_log_ms_ = 0;
+    int64 unlogged_failures_ = 0;
     
     river::StreamWriter* writer_;
 };
@@ -66,13 +94,35 @@ private:
 /**
  *  A sink that writes spikes and events to a Redis database,
  *  using the River library.
- * 
+ *
+ *  By default everything goes to one River stream. With splitDataStreams() set, each Open Ephys data stream gets its
+ *  own River stream, writer and writer thread instead, so that streams at different rates are labelled correctly
+ *  and don't serialize through one queue.
  * 
     @see GenericProcessor
  */
 class RiverOutput : public GenericProcessor
 {
 public:
+    /** Schema of each spike written to River */
+    using SpikeSchema = river::TypedSchema<river::Field<RiverFields::channelIndex, int32_t>,
+                                           river::Field<RiverFields::unitIndex, int32_t>,
+                                           river::Field<RiverFields::sampleNumber, int64_t>>;
+
+    /** Schema of each TTL event written to River */
+    using TtlEventSchema = river::TypedSchema<river::Field<RiverFields::channelIndex, int32_t>,
+                                              river::Field<RiverFields::state, int32_t>,
+                                              river::Field<RiverFields::sampleNumber, int64_t>>;
+
+    /**
+     * Schema of each latency probe written to River: a TTL event on line 0, stamped with RiverLatency::nowMicros()
+     * when it left the audio thread.
+     */
+    using LatencyProbeSchema = river::TypedSchema<river::Field<RiverFields::channelIndex, int32_t>,
+                                                  river::Field<RiverFields::state, int32_t>,
+                                                  river::Field<RiverFields::sampleNumber, int64_t>,
+                                                  river::Field<RiverFields::sentUs, int64_t>>;
+
     /** Constructor */
     RiverOutput();
 
@@ -126,8 +176,23 @@ public:
     void clearEventSchema();
     bool shouldConsumeSpikes() const;
 
+    /** True if this processor writes latency probes instead of spikes or events */
+    bool isLatencyProbe() const;
+
     void createStreamName();
 
+    /** Writes spikes and events of each data stream to their own River stream, named "<streamName()>-<stream ID>" */
+    bool splitDataStreams() const {
+        return split_data_streams_;
+    }
+
+    void setSplitDataStreams(bool splitDataStreams) {
+        split_data_streams_ = splitDataStreams;
+    }
+
+    /** Name of the River stream spikes and events of the data stream `streamId` are written to */
+    std::string streamNameFor(uint16 streamId) const;
+
     river::StreamSchema getSchema() const;
 
     std::string streamName() const;
@@ -149,29 +214,200 @@ public:
         writer_max_latency_ms_ = maxLatencyMs;
     }
 
+    int latencyProbeIntervalMs() const {
+        return latency_probe_interval_ms_;
+    }
+
+    void setLatencyProbeIntervalMs(int latencyProbeIntervalMs) {
+        latency_probe_interval_ms_ = latencyProbeIntervalMs;
+    }
+
+    /**
+     * Channels of the first data stream to export as continuous data, as 1-based indices and ranges (e.g. "1-16,32");
+     * empty to export none.
+     */
+    const std::string &continuousChannels() const {
+        return continuous_channels_;
+    }
+
+    void setContinuousChannels(const std::string &continuousChannels) {
+        continuous_channels_ = continuousChannels;
+    }
+
+    /** Continuous data is low-pass filtered and only every `decimationFactor`th frame is exported; 1 exports all */
+    int decimationFactor() const {
+        return decimation_factor_;
+    }
+
+    void setDecimationFactor(int decimationFactor) {
+        decimation_factor_ = decimationFactor;
+    }
+
+    /**
+     * Continuous data is exported as int16 counts of each channel's bitVolts, saturated at the int16 range, instead of
+     * as float32; the scales are stored in the stream's "channel_bit_volts" metadata.
+     */
+    bool exportInt16() const {
+        return export_int16_;
+    }
+
+    void setExportInt16(bool exportInt16) {
+        export_int16_ = exportInt16;
+    }
+
+    /** Name of the stream continuous data is exported to */
+    std::string continuousStreamName() const;
+
+    int64_t totalFramesWritten() const;
+
+    /** Continuous frames not written because the writing queue was full, e.g. while Redis was stalled */
+    int64_t totalFramesDropped() const {
+        return continuous_frames_dropped_;
+    }
+
+    /**
+     * Channels of the first data stream to compute features of (RMS, band power and threshold crossings), in the same
+     * format as continuousChannels(); empty to compute none.
+     */
+    const std::string &featureChannels() const {
+        return feature_channels_;
+    }
+
+    void setFeatureChannels(const std::string &featureChannels) {
+        feature_channels_ = featureChannels;
+    }
+
+    /** Length of each feature window, and so the period features are published at */
+    int featureWindowMs() const {
+        return feature_window_ms_;
+    }
+
+    void setFeatureWindowMs(int featureWindowMs) {
+        feature_window_ms_ = featureWindowMs;
+    }
+
+    /** Corners of the band power's bandpass filter */
+    double featureBandLowHz() const {
+        return feature_band_low_hz_;
+    }
+
+    double featureBandHighHz() const {
+        return feature_band_high_hz_;
+    }
+
+    void setFeatureBand(double lowHz, double highHz) {
+        feature_band_low_hz_ = lowHz;
+        feature_band_high_hz_ = highHz;
+    }
+
+    /** Threshold crossings are counted below this level if it is negative, above it otherwise */
+    float featureThresholdUv() const {
+        return feature_threshold_uv_;
+    }
+
+    void setFeatureThresholdUv(float featureThresholdUv) {
+        feature_threshold_uv_ = featureThresholdUv;
+    }
+
+    /** Name of the stream features are written to */
+    std::string featureStreamName() const;
+
+    int64_t totalFeatureWindowsWritten() const;
+
+    /** Feature windows not written because the writing queue was full */
+    int64_t totalFeatureWindowsDropped() const {
+        return feature_windows_dropped_;
+    }
+
+    /**
+     * Channels of the first data stream to export a snippet of around each TTL event, in the same format as
+     * continuousChannels(); empty to export none.
+     */
+    const std::string &snippetChannels() const {
+        return snippet_channels_;
+    }
+
+    void setSnippetChannels(const std::string &snippetChannels) {
+        snippet_channels_ = snippetChannels;
+    }
+
+    /** Length of each snippet before its event */
+    int snippetPreMs() const {
+        return snippet_pre_ms_;
+    }
+
+    /** Length of each snippet from its event on */
+    int snippetPostMs() const {
+        return snippet_post_ms_;
+    }
+
+    void setSnippetWindowMs(int preMs, int postMs) {
+        snippet_pre_ms_ = preMs;
+        snippet_post_ms_ = postMs;
+    }
+
+    /** Name of the stream snippets are written to */
+    std::string snippetStreamName() const;
+
+    int64_t totalSnippetsWritten() const;
+
+    /** Snippets not written because too many events were pending or the writing queue was full */
+    int64_t totalSnippetsDropped() const {
+        return snippets_dropped_;
+    }
+
 private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RiverOutput)
 
-    // For writing spikes to River. Ensure it's packed so that padding doesn't mess up the size of the struct.
-    typedef struct RiverSpike {
-        int32_t channel_index;
-        int32_t unit_index;
-        int64_t sample_number;
-    } __attribute__((__packed__)) RiverSpike;
-
-    typedef struct RiverEvent {
-        int32_t channel_index;
-        int32_t state;
-        int64_t sample_number;
-    } __attribute__((__packed__)) RiverTTLEvent;
-    
+    /** One River stream that spikes and events are written to */
+    struct Sink
+    {
+        std::unique_ptr<river::StreamWriter> writer;
+        std::unique_ptr<river::StreamLayout> layout;
+        std::unique_ptr<RiverWriterThread> thread;
+
+        /** Queues one record for the writer thread, or writes it synchronously if there is none */
+        void write(const char *data);
+    };
+
+    /** Creates the writer of every sink and maps each data stream to its sink; returns false on failure */
+    bool createSinks(const river::RedisConnection &connection);
+
+    /** Stops and deletes every sink */
+    void destroySinks();
+
+    /** Sink that spikes and events of the data stream `streamId` go to, or nullptr if there is none */
+    Sink *sinkFor(uint16 streamId);
+
+    /** Writes the latency probes due within the current block of the first data stream */
+    void writeLatencyProbes();
+
+    /** Interleaves the selected continuous channels of this block into frames and queues them for writing */
+    void writeContinuous(AudioSampleBuffer &buffer);
+
+    /** Interleaves (and if needed quantizes) `num_frames` frames of the selected channels and queues them */
+    void enqueueFrames(const float *const *channels, int num_frames, int64 first_sample, int sample_step);
+
+    /** Computes features of the selected channels of this block and queues those of every completed window */
+    void writeFeatures(AudioSampleBuffer &buffer);
+
+    /** Adds this block of the snippet channels to their history and writes every snippet that is now complete */
+    void writeSnippetHistory(AudioSampleBuffer &buffer);
+
+    /** Writes the pending snippets whose last sample is in the history, oldest first */
+    void flushSnippets();
+
+    /** Parses a channel list like "1-16,32" into sorted, unique 0-based indices below `num_channels` */
+    static std::vector<int> parseChannelList(const std::string &spec, int num_channels);
+
     const river::StreamSchema spike_schema_;
 
     // If this is set, then we should listen to events, not spikes.
     std::shared_ptr<river::StreamSchema> event_schema_;
 
-    river::StreamWriter* writer_;
-    std::unique_ptr<RiverWriterThread> writing_thread_;
+    std::vector<std::unique_ptr<Sink>> sinks_;
+    std::map<uint16, Sink *> sink_by_stream_;
+    bool split_data_streams_ = false;
 
     std::string stream_name;
 
@@ -182,6 +418,64 @@ private:
     int writer_max_batch_size_;
     int writer_max_latency_ms_;
 
+    int latency_probe_interval_ms_;
+
+    // Continuous export: a second stream of {sample_number, float per channel} frames, with its own writer thread.
+    std::string continuous_channels_;
+    std::vector<int> continuous_buffer_channels_;
+    std::unique_ptr<river::StreamWriter> continuous_writer_;
+    std::unique_ptr<RiverWriterThread> continuous_thread_;
+    std::vector<const float *> continuous_sources_;
+    std::vector<char> continuous_frames_;
+    std::atomic<int64> continuous_frames_dropped_{0};
+    int decimation_factor_ = 1;
+    bool export_int16_ = false;
+    std::vector<float> continuous_inv_scales_;
+    std::unique_ptr<PolyphaseDecimator> decimator_;
+
+    // Feature export: a third stream of {sample_number, RMS, band power and crossings per channel} frames, one per
+    // window.
+    std::string feature_channels_;
+    int feature_window_ms_ = 20;
+    double feature_band_low_hz_ = 13.0;
+    double feature_band_high_hz_ = 30.0;
+    float feature_threshold_uv_ = -50.0f;
+    std::vector<int> feature_buffer_channels_;
+    std::unique_ptr<river::StreamWriter> feature_writer_;
+    std::unique_ptr<RiverWriterThread> feature_thread_;
+    std::unique_ptr<FeatureExtractor> feature_extractor_;
+    std::vector<const float *> feature_sources_;
+    std::vector<char> feature_frames_;
+    std::atomic<int64> feature_windows_dropped_{0};
+
+    // Peri-event snippets: one record per TTL "on" event of the first data stream, holding `pre + post` samples of
+    // each selected channel as a FIXED_WIDTH_BYTES field of float32s.
+    struct PendingSnippet
+    {
+        int32 channel_index;
+        int32 state;
+        int64 sample_number;
+    };
+
+    std::string snippet_channels_;
+    int snippet_pre_ms_ = 50;
+    int snippet_post_ms_ = 200;
+    int snippet_pre_samples_ = 0;
+    int snippet_post_samples_ = 0;
+    std::vector<int> snippet_buffer_channels_;
+    std::unique_ptr<river::StreamWriter> snippet_writer_;
+    std::unique_ptr<RiverWriterThread> snippet_thread_;
+    std::unique_ptr<ChannelHistory> snippet_history_;
+    std::vector<const float *> snippet_sources_;
+    std::vector<PendingSnippet> pending_snippets_;
+    std::vector<char> snippet_record_;
+    std::vector<float> snippet_samples_;
+    uint16 snippet_stream_id_ = 0;
+    std::atomic<int64> snippets_dropped_{0};
+
+    int64 next_probe_sample_ = -1;
+    int64 num_probes_written_ = 0;
+
     bool createdWriter = false;
 
     Random random;
@@ -24,6 +24,8 @@
 #include "RiverOutputEditor.h"
 #include "SchemaListBox.h"
 
+#include <cmath>
+
 RiverOutputEditor::RiverOutputEditor(GenericProcessor *parentNode)
         : VisualizerEditor(parentNode, "River Output", 220) {
 
@@ -98,6 +100,29 @@ RiverOutputEditor::RiverOutputEditor(GenericProcessor *parentNode)
     inputTypeEventButton->addListener(this);
     optionsPanel->addAndMakeVisible(inputTypeEventButton);
 
+    /* -------- Radio group #1: Latency probes --------- */
+
+    yPos += 40;
+
+    inputTypeLatencyProbeButton = new ToggleButton("Latency Probe");
+    inputTypeLatencyProbeButton->setRadioGroupId(inputTypeRadioId, dontSendNotification);
+    inputTypeLatencyProbeButton->setBounds(xPos, yPos, 150, C_TEXT_HT);
+    inputTypeLatencyProbeButton->setToggleState(false, dontSendNotification);
+    inputTypeLatencyProbeButton->setTooltip("Emit timestamped TTL probes on line 0, to measure the round trip back "
+                                            "through an echo and the River Events processor");
+    inputTypeLatencyProbeButton->addListener(this);
+    optionsPanel->addAndMakeVisible(inputTypeLatencyProbeButton);
+
+    latencyProbeIntervalLabel = newStaticLabel("Probe Interval (ms)", xPos + 160, yPos, 120, C_TEXT_HT, optionsPanel);
+    latencyProbeIntervalLabelValue = newInputLabel("latencyProbeIntervalLabelValue",
+                                                   "Time between latency probes, in milliseconds",
+                                                   xPos + 280,
+                                                   yPos,
+                                                   60,
+                                                   C_TEXT_HT,
+                                                   optionsPanel);
+    latencyProbeIntervalLabelValue->addListener(this);
+
     //Disable adding custom event schema for now
     /*
     yPos += 60;
@@ -167,6 +192,131 @@ RiverOutputEditor::RiverOutputEditor(GenericProcessor *parentNode)
                                              optionsPanel);
     asyncBatchSizeLabelValue->addListener(this);
 
+    xPos += asyncBatchSizeLabel->getBounds().getWidth() + 4;
+    splitDataStreamsButton = new ToggleButton("Split Data Streams");
+    splitDataStreamsButton->setBounds(xPos, yPos + LABEL_VALUE_GAP, 150, C_TEXT_HT);
+    splitDataStreamsButton->setTooltip("Write each data stream to its own River stream, "
+                                       "named after this stream with the data stream's ID appended");
+    splitDataStreamsButton->addListener(this);
+    optionsPanel->addAndMakeVisible(splitDataStreamsButton);
+
+    xPos = LEFT_EDGE;
+    yPos += 60;
+
+    continuousChannelsLabel = newStaticLabel("Continuous Channels", xPos, yPos, 140, C_TEXT_HT, optionsPanel);
+    continuousChannelsLabelValue = newInputLabel("continuousChannelsLabelValue",
+                                                 "Channels of the first data stream to export as continuous data, "
+                                                 "e.g. 1-16,32. Leave empty to export none.",
+                                                 xPos,
+                                                 yPos + LABEL_VALUE_GAP,
+                                                 100,
+                                                 C_TEXT_HT,
+                                                 optionsPanel);
+    continuousChannelsLabelValue->addListener(this);
+
+    xPos += continuousChannelsLabel->getBounds().getWidth() + 4;
+    decimationFactorLabel = newStaticLabel("Decimation", xPos, yPos, 140, C_TEXT_HT, optionsPanel);
+    decimationFactorLabelValue = newInputLabel("decimationFactorLabelValue",
+                                               "Low-pass filter the continuous channels and export only every Nth "
+                                               "frame. Set to 1 to export every frame.",
+                                               xPos,
+                                               yPos + LABEL_VALUE_GAP,
+                                               100,
+                                               C_TEXT_HT,
+                                               optionsPanel);
+    decimationFactorLabelValue->addListener(this);
+
+    xPos += decimationFactorLabel->getBounds().getWidth() + 4;
+    exportInt16Button = new ToggleButton("Int16");
+    exportInt16Button->setBounds(xPos, yPos + LABEL_VALUE_GAP, 80, C_TEXT_HT);
+    exportInt16Button->setTooltip("Export continuous data as int16 counts of each channel's bit volts, "
+                                  "half the size of float32");
+    exportInt16Button->addListener(this);
+    optionsPanel->addAndMakeVisible(exportInt16Button);
+
+    xPos = LEFT_EDGE;
+    yPos += 60;
+
+    featureChannelsLabel = newStaticLabel("Feature Channels", xPos, yPos, 140, C_TEXT_HT, optionsPanel);
+    featureChannelsLabelValue = newInputLabel("featureChannelsLabelValue",
+                                              "Channels of the first data stream to publish RMS, band power and "
+                                              "threshold crossings of, e.g. 1-16,32. Leave empty to publish none.",
+                                              xPos,
+                                              yPos + LABEL_VALUE_GAP,
+                                              100,
+                                              C_TEXT_HT,
+                                              optionsPanel);
+    featureChannelsLabelValue->addListener(this);
+
+    xPos += featureChannelsLabel->getBounds().getWidth() + 4;
+    featureWindowLabel = newStaticLabel("Window (ms)", xPos, yPos, 100, C_TEXT_HT, optionsPanel);
+    featureWindowLabelValue = newInputLabel("featureWindowLabelValue",
+                                            "Length of each feature window; features are published once per window.",
+                                            xPos,
+                                            yPos + LABEL_VALUE_GAP,
+                                            80,
+                                            C_TEXT_HT,
+                                            optionsPanel);
+    featureWindowLabelValue->addListener(this);
+
+    xPos += featureWindowLabel->getBounds().getWidth() + 4;
+    featureBandLabel = newStaticLabel("Band (Hz)", xPos, yPos, 100, C_TEXT_HT, optionsPanel);
+    featureBandLabelValue = newInputLabel("featureBandLabelValue",
+                                          "Band to measure power in, as low-high, e.g. 13-30.",
+                                          xPos,
+                                          yPos + LABEL_VALUE_GAP,
+                                          80,
+                                          C_TEXT_HT,
+                                          optionsPanel);
+    featureBandLabelValue->addListener(this);
+
+    xPos += featureBandLabel->getBounds().getWidth() + 4;
+    featureThresholdLabel = newStaticLabel("Threshold (uV)", xPos, yPos, 100, C_TEXT_HT, optionsPanel);
+    featureThresholdLabelValue = newInputLabel("featureThresholdLabelValue",
+                                               "Level to count crossings of: downward if negative, upward otherwise.",
+                                               xPos,
+                                               yPos + LABEL_VALUE_GAP,
+                                               80,
+                                               C_TEXT_HT,
+                                               optionsPanel);
+    featureThresholdLabelValue->addListener(this);
+
+    xPos = LEFT_EDGE;
+    yPos += 60;
+
+    snippetChannelsLabel = newStaticLabel("Snippet Channels", xPos, yPos, 140, C_TEXT_HT, optionsPanel);
+    snippetChannelsLabelValue = newInputLabel("snippetChannelsLabelValue",
+                                              "Channels of the first data stream to export a snippet of around each "
+                                              "TTL event, e.g. 1-16,32. Leave empty to export none.",
+                                              xPos,
+                                              yPos + LABEL_VALUE_GAP,
+                                              100,
+                                              C_TEXT_HT,
+                                              optionsPanel);
+    snippetChannelsLabelValue->addListener(this);
+
+    xPos += snippetChannelsLabel->getBounds().getWidth() + 4;
+    snippetPreLabel = newStaticLabel("Pre (ms)", xPos, yPos, 100, C_TEXT_HT, optionsPanel);
+    snippetPreLabelValue = newInputLabel("snippetPreLabelValue",
+                                         "Length of each snippet before its event.",
+                                         xPos,
+                                         yPos + LABEL_VALUE_GAP,
+                                         80,
+                                         C_TEXT_HT,
+                                         optionsPanel);
+    snippetPreLabelValue->addListener(this);
+
+    xPos += snippetPreLabel->getBounds().getWidth() + 4;
+    snippetPostLabel = newStaticLabel("Post (ms)", xPos, yPos, 100, C_TEXT_HT, optionsPanel);
+    snippetPostLabelValue = newInputLabel("snippetPostLabelValue",
+                                          "Length of each snippet from its event on.",
+                                          xPos,
+                                          yPos + LABEL_VALUE_GAP,
+                                          80,
+                                          C_TEXT_HT,
+                                          optionsPanel);
+    snippetPostLabelValue->addListener(this);
+
     xPos = LEFT_EDGE;
     yPos += 60;
     schemaList = new SchemaListBox();
@@ -195,6 +345,58 @@ RiverOutputEditor::RiverOutputEditor(GenericProcessor *parentNode)
                                                    18,
                                                    optionsPanel);
 
+    yPos += 60;
+    totalFramesWrittenLabel = newStaticLabel("Continuous Frames Written", xPos, yPos, 180, 20, optionsPanel);
+    totalFramesWrittenLabelValue = newStaticLabel("0",
+                                                  xPos,
+                                                  yPos + LABEL_VALUE_GAP,
+                                                  120,
+                                                  18,
+                                                  optionsPanel);
+
+    totalFramesDroppedLabel = newStaticLabel("Frames Dropped", xPos + 190, yPos, 120, 20, optionsPanel);
+    totalFramesDroppedLabelValue = newStaticLabel("0",
+                                                  xPos + 190,
+                                                  yPos + LABEL_VALUE_GAP,
+                                                  120,
+                                                  18,
+                                                  optionsPanel);
+
+    yPos += 60;
+    totalFeatureWindowsWrittenLabel = newStaticLabel("Feature Windows Written", xPos, yPos, 180, 20, optionsPanel);
+    totalFeatureWindowsWrittenLabelValue = newStaticLabel("0",
+                                                          xPos,
+                                                          yPos + LABEL_VALUE_GAP,
+                                                          120,
+                                                          18,
+                                                          optionsPanel);
+
+    totalFeatureWindowsDroppedLabel = newStaticLabel("Windows Dropped", xPos + 190, yPos, 120, 20, optionsPanel);
+    totalFeatureWindowsDroppedLabelValue = newStaticLabel("0",
+                                                          xPos + 190,
+                                                          yPos + LABEL_VALUE_GAP,
+                                                          120,
+                                                          18,
+                                                          optionsPanel);
+
+    yPos += 60;
+    totalSnippetsWrittenLabel = newStaticLabel("Snippets Written", xPos, yPos, 180, 20, optionsPanel);
+    totalSnippetsWrittenLabelValue = newStaticLabel("0",
+                                                    xPos,
+                                                    yPos + LABEL_VALUE_GAP,
+                                                    120,
+                                                    18,
+                                                    optionsPanel);
+
+    yPos += 60;
+    totalSnippetsDroppedLabel = newStaticLabel("Snippets Dropped", xPos, yPos, 180, 20, optionsPanel);
+    totalSnippetsDroppedLabelValue = newStaticLabel("0",
+                                                    xPos,
+                                                    yPos + LABEL_VALUE_GAP,
+                                                    120,
+                                                    18,
+                                                    optionsPanel);
+
 
     // Update the bounds of the options panel to fit all of the components in it:
     juce::Rectangle<int> opBounds(0, 0, 1, 1);
@@ -204,6 +406,9 @@ RiverOutputEditor::RiverOutputEditor(GenericProcessor *parentNode)
             dynamic_cast<Component *>(inputTypeTitle.get()),
             dynamic_cast<Component *>(inputTypeSpikeButton.get()),
             dynamic_cast<Component *>(inputTypeEventButton.get()),
+            dynamic_cast<Component *>(inputTypeLatencyProbeButton.get()),
+            dynamic_cast<Component *>(latencyProbeIntervalLabel.get()),
+            dynamic_cast<Component *>(latencyProbeIntervalLabelValue.get()),
             /*
             dynamic_cast<Component *>(fieldNameLabel.get()),
             dynamic_cast<Component *>(fieldNameLabelValue.get()),
@@ -217,6 +422,38 @@ RiverOutputEditor::RiverOutputEditor(GenericProcessor *parentNode)
             dynamic_cast<Component *>(streamNameLabelValue.get()),
             dynamic_cast<Component *>(totalSamplesWrittenLabel.get()),
             dynamic_cast<Component *>(totalSamplesWrittenLabelValue.get()),
+            dynamic_cast<Component *>(totalFramesWrittenLabel.get()),
+            dynamic_cast<Component *>(totalFramesWrittenLabelValue.get()),
+            dynamic_cast<Component *>(totalFramesDroppedLabel.get()),
+            dynamic_cast<Component *>(totalFramesDroppedLabelValue.get()),
+            dynamic_cast<Component *>(totalFeatureWindowsWrittenLabel.get()),
+            dynamic_cast<Component *>(totalFeatureWindowsWrittenLabelValue.get()),
+            dynamic_cast<Component *>(totalFeatureWindowsDroppedLabel.get()),
+            dynamic_cast<Component *>(totalFeatureWindowsDroppedLabelValue.get()),
+            dynamic_cast<Component *>(totalSnippetsWrittenLabel.get()),
+            dynamic_cast<Component *>(totalSnippetsWrittenLabelValue.get()),
+            dynamic_cast<Component *>(totalSnippetsDroppedLabel.get()),
+            dynamic_cast<Component *>(totalSnippetsDroppedLabelValue.get()),
+            dynamic_cast<Component *>(continuousChannelsLabel.get()),
+            dynamic_cast<Component *>(continuousChannelsLabelValue.get()),
+            dynamic_cast<Component *>(decimationFactorLabel.get()),
+            dynamic_cast<Component *>(decimationFactorLabelValue.get()),
+            dynamic_cast<Component *>(exportInt16Button.get()),
+            dynamic_cast<Component *>(splitDataStreamsButton.get()),
+            dynamic_cast<Component *>(featureChannelsLabel.get()),
+            dynamic_cast<Component *>(featureChannelsLabelValue.get()),
+            dynamic_cast<Component *>(featureWindowLabel.get()),
+            dynamic_cast<Component *>(featureWindowLabelValue.get()),
+            dynamic_cast<Component *>(featureBandLabel.get()),
+            dynamic_cast<Component *>(featureBandLabelValue.get()),
+            dynamic_cast<Component *>(featureThresholdLabel.get()),
+            dynamic_cast<Component *>(featureThresholdLabelValue.get()),
+            dynamic_cast<Component *>(snippetChannelsLabel.get()),
+            dynamic_cast<Component *>(snippetChannelsLabelValue.get()),
+            dynamic_cast<Component *>(snippetPreLabel.get()),
+            dynamic_cast<Component *>(snippetPreLabelValue.get()),
+            dynamic_cast<Component *>(snippetPostLabel.get()),
+            dynamic_cast<Component *>(snippetPostLabelValue.get()),
             dynamic_cast<Component *>(asyncBatchSizeLabel.get()),
             dynamic_cast<Component *>(asyncBatchSizeLabelValue.get()),
             dynamic_cast<Component *>(asyncLatencyMsLabel.get()),
@@ -245,6 +482,23 @@ void RiverOutputEditor::buttonClicked(Button *button) {
         return;
     }
 
+    if (button == exportInt16Button) {
+        auto river = (RiverOutput *) getProcessor();
+        river->setExportInt16(exportInt16Button->getToggleState());
+        // The continuous stream's field types change, so it needs a fresh stream.
+        river->createStreamName();
+        refreshLabelsFromProcessor();
+        return;
+    }
+
+    if (button == splitDataStreamsButton) {
+        auto river = (RiverOutput *) getProcessor();
+        river->setSplitDataStreams(splitDataStreamsButton->getToggleState());
+        river->createStreamName();
+        refreshLabelsFromProcessor();
+        return;
+    }
+
     if (button == connectButton) {
 
         //getProcessor()->update();
@@ -300,9 +554,9 @@ void RiverOutputEditor::updateProcessorSchema() {
         }
         */
         // Hardcoded schema for TTL events for now...
-        processor->setEventSchema(river::StreamSchema({river::FieldDefinition("channel_index", river::FieldDefinition::INT32, 4),
-                    river::FieldDefinition("state", river::FieldDefinition::INT32, 4),
-                    river::FieldDefinition("sample_number", river::FieldDefinition::INT64, 8)}));
+        processor->setEventSchema(RiverOutput::TtlEventSchema::Schema());
+    } else if (inputTypeLatencyProbeButton->getToggleState()) {
+        processor->setEventSchema(RiverOutput::LatencyProbeSchema::Schema());
     } else {
         // Can happen transiently where both are off briefly
     }
@@ -331,6 +585,98 @@ void RiverOutputEditor::labelTextChanged(Label *label) {
         river->setMaxLatencyMs(label->getText().getIntValue());
     } else if (label == asyncBatchSizeLabelValue) {
         river->setMaxBatchSize(label->getText().getIntValue());
+    } else if (label == latencyProbeIntervalLabelValue) {
+        int intervalMs = label->getText().getIntValue();
+        if (intervalMs > 0) {
+            river->setLatencyProbeIntervalMs(intervalMs);
+        }
+        label->setText(juce::String(river->latencyProbeIntervalMs()), dontSendNotification);
+    } else if (label == continuousChannelsLabelValue) {
+        if (isPlaying) {
+            CoreServices::sendStatusMessage("Cannot change continuous channels while running.");
+            label->setText(river->continuousChannels(), dontSendNotification);
+            return;
+        }
+        river->setContinuousChannels(label->getText().trim().toStdString());
+        // The continuous stream's schema depends on the selection, so it needs a fresh stream.
+        river->createStreamName();
+        refreshLabelsFromProcessor();
+    } else if (label == decimationFactorLabelValue) {
+        int factor = label->getText().getIntValue();
+        if (isPlaying) {
+            CoreServices::sendStatusMessage("Cannot change decimation while running.");
+        } else if (factor > 0 && factor != river->decimationFactor()) {
+            river->setDecimationFactor(factor);
+            // The sample rate in the continuous stream's metadata changes too.
+            river->createStreamName();
+        }
+        refreshLabelsFromProcessor();
+    } else if (label == featureChannelsLabelValue) {
+        if (isPlaying) {
+            CoreServices::sendStatusMessage("Cannot change feature channels while running.");
+            label->setText(river->featureChannels(), dontSendNotification);
+            return;
+        }
+        river->setFeatureChannels(label->getText().trim().toStdString());
+        // The feature stream's schema depends on the selection, so it needs a fresh stream.
+        river->createStreamName();
+        refreshLabelsFromProcessor();
+    } else if (label == featureWindowLabelValue) {
+        int windowMs = label->getText().getIntValue();
+        if (isPlaying) {
+            CoreServices::sendStatusMessage("Cannot change the feature window while running.");
+        } else if (windowMs > 0 && windowMs != river->featureWindowMs()) {
+            river->setFeatureWindowMs(windowMs);
+            // The sample rate in the feature stream's metadata changes too.
+            river->createStreamName();
+        }
+        refreshLabelsFromProcessor();
+    } else if (label == featureBandLabelValue) {
+        const String text = label->getText();
+        double lowHz = text.upToFirstOccurrenceOf("-", false, false).getDoubleValue();
+        double highHz = text.fromFirstOccurrenceOf("-", false, false).getDoubleValue();
+        if (isPlaying) {
+            CoreServices::sendStatusMessage("Cannot change the feature band while running.");
+        } else if (lowHz > 0 && highHz > lowHz) {
+            river->setFeatureBand(lowHz, highHz);
+            river->createStreamName();
+        }
+        refreshLabelsFromProcessor();
+    } else if (label == featureThresholdLabelValue) {
+        // getFloatValue() reads garbage as 0, so only accept text that is a number.
+        const String text = label->getText().trim();
+        bool isNumber = text.isNotEmpty() && text.containsOnly("0123456789.+-eE")
+                        && text.containsAnyOf("0123456789");
+        float thresholdUv = text.getFloatValue();
+        if (isPlaying) {
+            CoreServices::sendStatusMessage("Cannot change the feature threshold while running.");
+        } else if (isNumber && std::isfinite(thresholdUv) && thresholdUv != river->featureThresholdUv()) {
+            river->setFeatureThresholdUv(thresholdUv);
+            // The threshold is part of the feature stream's metadata.
+            river->createStreamName();
+        }
+        refreshLabelsFromProcessor();
+    } else if (label == snippetChannelsLabelValue) {
+        if (isPlaying) {
+            CoreServices::sendStatusMessage("Cannot change snippet channels while running.");
+            label->setText(river->snippetChannels(), dontSendNotification);
+            return;
+        }
+        river->setSnippetChannels(label->getText().trim().toStdString());
+        // The snippet stream's schema depends on the selection, so it needs a fresh stream.
+        river->createStreamName();
+        refreshLabelsFromProcessor();
+    } else if (label == snippetPreLabelValue || label == snippetPostLabelValue) {
+        int preMs = label == snippetPreLabelValue ? label->getText().getIntValue() : river->snippetPreMs();
+        int postMs = label == snippetPostLabelValue ? label->getText().getIntValue() : river->snippetPostMs();
+        if (isPlaying) {
+            CoreServices::sendStatusMessage("Cannot change the snippet window while running.");
+        } else if (preMs >= 0 && postMs > 0) {
+            river->setSnippetWindowMs(preMs, postMs);
+            // The snippet length is part of the schema, so it needs a fresh stream too.
+            river->createStreamName();
+        }
+        refreshLabelsFromProcessor();
     }
 }
 
@@ -342,21 +688,49 @@ void RiverOutputEditor::refreshLabelsFromProcessor()
     hostnameLabelValue->setText(river->redisConnectionHostname(), dontSendNotification);
     portLabelValue->setText(lastPortValue, dontSendNotification);
     passwordLabelValue->setText(river->redisConnectionPassword(), dontSendNotification);
-    streamNameLabelValue->setText(river->streamName(), dontSendNotification);
+    streamNameLabelValue->setText(river->streamName() + (river->splitDataStreams() ? "-<id>" : ""),
+                                  dontSendNotification);
 
     totalSamplesWrittenLabelValue->setText(juce::String(river->totalSamplesWritten()), dontSendNotification);
+    totalFramesWrittenLabelValue->setText(juce::String(river->totalFramesWritten()), dontSendNotification);
+    totalFramesDroppedLabelValue->setText(juce::String(river->totalFramesDropped()), dontSendNotification);
+    continuousChannelsLabelValue->setText(river->continuousChannels(), dontSendNotification);
+    decimationFactorLabelValue->setText(juce::String(river->decimationFactor()), dontSendNotification);
+    exportInt16Button->setToggleState(river->exportInt16(), dontSendNotification);
+    totalFeatureWindowsWrittenLabelValue->setText(juce::String(river->totalFeatureWindowsWritten()),
+                                                  dontSendNotification);
+    totalFeatureWindowsDroppedLabelValue->setText(juce::String(river->totalFeatureWindowsDropped()),
+                                                  dontSendNotification);
+    featureChannelsLabelValue->setText(river->featureChannels(), dontSendNotification);
+    featureWindowLabelValue->setText(juce::String(river->featureWindowMs()), dontSendNotification);
+    featureBandLabelValue->setText(juce::String(river->featureBandLowHz()) + "-" +
+                                   juce::String(river->featureBandHighHz()), dontSendNotification);
+    featureThresholdLabelValue->setText(juce::String(river->featureThresholdUv()), dontSendNotification);
+    totalSnippetsWrittenLabelValue->setText(juce::String(river->totalSnippetsWritten()), dontSendNotification);
+    totalSnippetsDroppedLabelValue->setText(juce::String(river->totalSnippetsDropped()), dontSendNotification);
+    snippetChannelsLabelValue->setText(river->snippetChannels(), dontSendNotification);
+    snippetPreLabelValue->setText(juce::String(river->snippetPreMs()), dontSendNotification);
+    snippetPostLabelValue->setText(juce::String(river->snippetPostMs()), dontSendNotification);
+    splitDataStreamsButton->setToggleState(river->splitDataStreams(), dontSendNotification);
 
     asyncLatencyMsLabelValue->setText(juce::String(river->maxLatencyMs()), dontSendNotification);
     asyncBatchSizeLabelValue->setText(juce::String(river->maxBatchSize()), dontSendNotification);
+    latencyProbeIntervalLabelValue->setText(juce::String(river->latencyProbeIntervalMs()), dontSendNotification);
 }
 
 void RiverOutputEditor::refreshSchemaFromProcessor() {
     auto processor = dynamic_cast<RiverOutput *>(getProcessor());
     if (processor->shouldConsumeSpikes()) {
         inputTypeEventButton->setToggleState(false, dontSendNotification);
+        inputTypeLatencyProbeButton->setToggleState(false, dontSendNotification);
         inputTypeSpikeButton->setToggleState(true, dontSendNotification);
+    } else if (processor->isLatencyProbe()) {
+        inputTypeSpikeButton->setToggleState(false, dontSendNotification);
+        inputTypeEventButton->setToggleState(false, dontSendNotification);
+        inputTypeLatencyProbeButton->setToggleState(true, dontSendNotification);
     } else {
         inputTypeSpikeButton->setToggleState(false, dontSendNotification);
+        inputTypeLatencyProbeButton->setToggleState(false, dontSendNotification);
         inputTypeEventButton->setToggleState(true, dontSendNotification);
     }
     schemaList->clearItems();
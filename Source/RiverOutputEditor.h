@@ -100,10 +100,32 @@ private:
     ScopedPointer<Label> totalSamplesWrittenLabel;
     ScopedPointer<Label> totalSamplesWrittenLabelValue;
 
+    ScopedPointer<Label> totalFramesWrittenLabel;
+    ScopedPointer<Label> totalFramesWrittenLabelValue;
+
+    ScopedPointer<Label> totalFramesDroppedLabel;
+    ScopedPointer<Label> totalFramesDroppedLabelValue;
+
+    ScopedPointer<Label> totalFeatureWindowsWrittenLabel;
+    ScopedPointer<Label> totalFeatureWindowsWrittenLabelValue;
+
+    ScopedPointer<Label> totalFeatureWindowsDroppedLabel;
+    ScopedPointer<Label> totalFeatureWindowsDroppedLabelValue;
+
+    ScopedPointer<Label> totalSnippetsWrittenLabel;
+    ScopedPointer<Label> totalSnippetsWrittenLabelValue;
+
+    ScopedPointer<Label> totalSnippetsDroppedLabel;
+    ScopedPointer<Label> totalSnippetsDroppedLabelValue;
+
     // OPTIONS PANEL: Input Type
     const int inputTypeRadioId = 1;
     ScopedPointer<ToggleButton> inputTypeSpikeButton;
     ScopedPointer<ToggleButton> inputTypeEventButton;
+    ScopedPointer<ToggleButton> inputTypeLatencyProbeButton;
+
+    ScopedPointer<Label> latencyProbeIntervalLabel;
+    ScopedPointer<Label> latencyProbeIntervalLabelValue;
 
     ScopedPointer<Label> fieldNameLabel;
     ScopedPointer<Label> fieldNameLabelValue;
@@ -123,6 +145,40 @@ private:
     ScopedPointer<Label> asyncLatencyMsLabel;
     ScopedPointer<Label> asyncLatencyMsLabelValue;
 
+    // OPTIONS PANEL: Continuous export
+    ScopedPointer<Label> continuousChannelsLabel;
+    ScopedPointer<Label> continuousChannelsLabelValue;
+
+    ScopedPointer<Label> decimationFactorLabel;
+    ScopedPointer<Label> decimationFactorLabelValue;
+
+    ScopedPointer<ToggleButton> exportInt16Button;
+
+    // OPTIONS PANEL: Feature export
+    ScopedPointer<Label> featureChannelsLabel;
+    ScopedPointer<Label> featureChannelsLabelValue;
+
+    ScopedPointer<Label> featureWindowLabel;
+    ScopedPointer<Label> featureWindowLabelValue;
+
+    ScopedPointer<Label> featureBandLabel;
+    ScopedPointer<Label> featureBandLabelValue;
+
+    ScopedPointer<Label> featureThresholdLabel;
+    ScopedPointer<Label> featureThresholdLabelValue;
+
+    // OPTIONS PANEL: Snippet export
+    ScopedPointer<Label> snippetChannelsLabel;
+    ScopedPointer<Label> snippetChannelsLabelValue;
+
+    ScopedPointer<Label> snippetPreLabel;
+    ScopedPointer<Label> snippetPreLabelValue;
+
+    ScopedPointer<Label> snippetPostLabel;
+    ScopedPointer<Label> snippetPostLabelValue;
+
+    ScopedPointer<ToggleButton> splitDataStreamsButton;
+
     Label *newStaticLabel(
             const std::string& labelText,
             int boundsX,
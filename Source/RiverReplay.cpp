@@ -0,0 +1,572 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "RiverReplay.h"
+#include "RiverReplayEditor.h"
+
+#include <cstring>
+
+// Maximum number of samples handed to the signal chain in one update.
+static const int kMaxSamplesPerUpdate = 4096;
+
+// Samples the prefetcher may hold ahead of playback.
+static const int64 kPrefetchDepth = 1 << 18;
+
+// How long to wait for the stream's metadata when looking it up.
+static const int kConnectTimeoutMs = 500;
+
+static int findField(const river::StreamSchema& schema, const char* name, river::FieldDefinition::Type type)
+{
+    int offset = 0;
+    for (const auto& field : schema.field_definitions)
+    {
+        if (field.name == name && field.type == type)
+        {
+            return offset;
+        }
+        offset += field.size;
+    }
+    return -1;
+}
+
+DataThread* RiverReplay::createDataThread(SourceNode* sn)
+{
+    return new RiverReplay(sn);
+}
+
+RiverReplay::RiverReplay(SourceNode* sn)
+        : DataThread(sn)
+{
+    // Start with some sane defaults.
+    redis_connection_hostname_ = "127.0.0.1";
+    redis_connection_port_ = 6379;
+    speed_ = 1.0f;
+
+    sample_rate_ = 30000.0f;
+    bit_volts_ = 0.195f;
+
+    sample_numbers_.allocate(kMaxSamplesPerUpdate, true);
+    timestamps_.allocate(kMaxSamplesPerUpdate, true);
+    event_codes_.allocate(kMaxSamplesPerUpdate, true);
+
+    sourceBuffers.add(new DataBuffer(1, 10000));
+}
+
+RiverReplay::~RiverReplay()
+{
+    if (reader_)
+    {
+        reader_->Stop();
+    }
+}
+
+std::unique_ptr<GenericEditor> RiverReplay::createEditor(SourceNode* sn)
+{
+    return std::make_unique<RiverReplayEditor>(sn, this);
+}
+
+river::RedisConnection RiverReplay::connection() const
+{
+    return river::RedisConnection(
+        redis_connection_hostname_,
+        redis_connection_port_,
+        redis_connection_password_);
+}
+
+bool RiverReplay::connectToStream()
+{
+    channels_.clear();
+    found_stream_ = false;
+    is_event_stream_ = false;
+
+    if (stream_name_.empty())
+    {
+        return false;
+    }
+
+    try {
+        river::StreamReader reader(connection());
+        reader.Initialize(stream_name_, kConnectTimeoutMs);
+        const river::StreamSchema& schema = reader.schema();
+
+        auto metadata = reader.Metadata();
+        auto rate = metadata.find(RiverMetadata::samplingRate);
+        if (rate != metadata.end())
+        {
+            sample_rate_ = String(rate->second).getFloatValue();
+        }
+        else
+        {
+            LOGC("River Replay: stream ", stream_name_, " has no ", RiverMetadata::samplingRate, " metadata; assuming ",
+                 sample_rate_, " Hz.");
+        }
+        auto bit_volts = metadata.find(RiverMetadata::bitVolts);
+        if (bit_volts != metadata.end())
+        {
+            bit_volts_ = String(bit_volts->second).getFloatValue();
+        }
+
+        std::vector<float> channelBitVolts;
+        auto channel_bit_volts = metadata.find(RiverMetadata::channelBitVolts);
+        if (channel_bit_volts != metadata.end())
+        {
+            channelBitVolts = RiverChannelField::parseScales(channel_bit_volts->second);
+        }
+
+        channels_ = RiverChannelField::fromSchema(schema, bit_volts_, channelBitVolts);
+        sample_size_ = schema.sample_size();
+        sample_number_offset_ = findField(schema, "sample_number", river::FieldDefinition::INT64);
+        state_offset_ = findField(schema, "state", river::FieldDefinition::INT32);
+        channel_index_offset_ = findField(schema, "channel_index", river::FieldDefinition::INT32);
+
+        is_event_stream_ = channels_.empty() && sample_number_offset_ >= 0;
+        found_stream_ = sample_rate_ > 0 && (is_event_stream_ || !channels_.empty())
+                        && !schema.has_variable_width_field();
+    } catch (const std::exception& e) {
+        LOGC("River Replay: could not read stream ", stream_name_, ": ", e.what());
+    }
+
+    if (!found_stream_)
+    {
+        channels_.clear();
+        is_event_stream_ = false;
+    }
+    return found_stream_;
+}
+
+bool RiverReplay::matchesSettings(const river::StreamSchema& schema) const
+{
+    if (schema.sample_size() != sample_size_
+        || findField(schema, "sample_number", river::FieldDefinition::INT64) != sample_number_offset_
+        || findField(schema, "state", river::FieldDefinition::INT32) != state_offset_
+        || findField(schema, "channel_index", river::FieldDefinition::INT32) != channel_index_offset_)
+    {
+        return false;
+    }
+
+    auto channels = RiverChannelField::fromSchema(schema, bit_volts_);
+    if (channels.size() != channels_.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < channels.size(); i++)
+    {
+        if (channels[i].offset != channels_[i].offset || channels[i].kind != channels_[i].kind)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void RiverReplay::updateSettings(OwnedArray<ContinuousChannel>* continuousChannels,
+                                 OwnedArray<EventChannel>* eventChannels,
+                                 OwnedArray<SpikeChannel>* spikeChannels,
+                                 OwnedArray<DataStream>* sourceStreams,
+                                 OwnedArray<DeviceInfo>* devices,
+                                 OwnedArray<ConfigurationObject>* configurationObjects)
+{
+    continuousChannels->clear();
+    eventChannels->clear();
+    spikeChannels->clear();
+    sourceStreams->clear();
+    devices->clear();
+    configurationObjects->clear();
+
+    if (!connectToStream())
+    {
+        CoreServices::sendStatusMessage("River Replay: stream not found.");
+        return;
+    }
+
+    DataStream::Settings streamSettings
+    {
+        String(stream_name_),
+        "Replay of a River stream",
+        "river.replay." + String(stream_name_),
+        sample_rate_
+    };
+    DataStream* stream = new DataStream(streamSettings);
+    sourceStreams->add(stream);
+
+    // Hold about half a second of playback, so the signal chain is never waiting on a full DataBuffer.
+    int bufferSize = jmax(10000, (int) (sample_rate_ * jmax(1.0f, speed_) / 2));
+    sourceBuffers[0]->resize(numChannels(), bufferSize);
+
+    if (is_event_stream_)
+    {
+        ContinuousChannel::Settings channelSettings
+        {
+            ContinuousChannel::Type::AUX,
+            "CLOCK",
+            "Silent channel carrying the replayed stream's sample clock",
+            "river.replay.clock",
+            1.0f,
+            stream
+        };
+        continuousChannels->add(new ContinuousChannel(channelSettings));
+
+        EventChannel::Settings eventSettings
+        {
+            EventChannel::Type::TTL,
+            "River Replay Events",
+            "Spikes and TTL events replayed from a River stream",
+            "river.replay.events",
+            stream,
+            kNumLines
+        };
+        eventChannels->add(new EventChannel(eventSettings));
+    }
+    else
+    {
+        for (const auto& channel : channels_)
+        {
+            ContinuousChannel::Settings channelSettings
+            {
+                ContinuousChannel::Type::ELECTRODE,
+                String(channel.name),
+                "River field " + String(channel.name),
+                "river.replay.field",
+                channel.kind == RiverChannelField::INT16 ? channel.scale : bit_volts_,
+                stream
+            };
+            continuousChannels->add(new ContinuousChannel(channelSettings));
+        }
+    }
+
+    records_.resize((size_t) kMaxSamplesPerUpdate * sample_size_);
+    samples_.allocate((size_t) kMaxSamplesPerUpdate * numChannels(), true);
+
+    CoreServices::sendStatusMessage("River Replay: " + String(is_event_stream_ ? "events" : "continuous")
+                                    + " stream at " + String(sample_rate_) + " Hz.");
+}
+
+bool RiverReplay::foundInputSource()
+{
+    return found_stream_;
+}
+
+bool RiverReplay::startAcquisition()
+{
+    if (!found_stream_ || speed_ <= 0)
+    {
+        return false;
+    }
+
+    try {
+        reader_ = std::make_unique<river::PrefetchingStreamReader>(connection(), kPrefetchDepth);
+        reader_->Initialize(stream_name_, kConnectTimeoutMs);
+    } catch (const std::exception& e) {
+        LOGC("River Replay: failed to open stream ", stream_name_, ": ", e.what());
+        CoreServices::sendStatusMessage("River Replay: failed to open stream.");
+        reader_.reset();
+        return false;
+    }
+
+    // The stream may have been recreated with another schema since updateSettings.
+    if (!matchesSettings(reader_->schema()))
+    {
+        LOGC("River Replay: schema of stream ", stream_name_, " changed since settings were updated.");
+        CoreServices::sendStatusMessage("River Replay: stream schema changed; refresh the settings.");
+        reader_.reset();
+        return false;
+    }
+
+    is_started_ = false;
+    is_stalled_ = false;
+    reader_eof_ = false;
+    next_sample_ = 0;
+    record_pos_ = 0;
+    record_count_ = 0;
+    ttl_state_ = 0;
+    ttl_pulses_ = 0;
+    has_unflushed_records_ = false;
+
+    samples_replayed_ = 0;
+    stall_count_ = 0;
+    is_finished_ = false;
+
+    sourceBuffers[0]->clear();
+    startThread();
+    return true;
+}
+
+bool RiverReplay::stopAcquisition()
+{
+    if (isThreadRunning())
+    {
+        signalThreadShouldExit();
+    }
+
+    if (reader_)
+    {
+        // Unblocks any read in progress.
+        reader_->Stop();
+    }
+
+    waitForThreadToExit(500);
+
+    reader_.reset();
+    sourceBuffers[0]->clear();
+    return true;
+}
+
+bool RiverReplay::updateBuffer()
+{
+    if (is_finished_)
+    {
+        sleep(10);
+        return true;
+    }
+
+    // Start the clock on the first sample or record, however long the prefetcher took to fetch it.
+    if (!is_started_)
+    {
+        if (is_event_stream_ ? !refillRecords() : reader_->num_buffered() == 0)
+        {
+            is_finished_ = reader_eof_ || !reader_->Good();
+            sleep(1);
+            return true;
+        }
+        if (is_event_stream_)
+        {
+            next_sample_ = recordSampleNumber(records_.data());
+        }
+        playback_start_ms_ = Time::getMillisecondCounterHiRes();
+        playback_start_sample_ = next_sample_;
+        is_started_ = true;
+    }
+
+    double elapsed_ms = Time::getMillisecondCounterHiRes() - playback_start_ms_;
+    int64 due = playback_start_sample_ + (int64) (elapsed_ms * sample_rate_ * speed_ / 1000.0) - next_sample_;
+    if (due <= 0)
+    {
+        sleep(1);
+        return true;
+    }
+    int numToReplay = (int) jmin(due, (int64) kMaxSamplesPerUpdate);
+
+    int numReplayed = is_event_stream_ ? replayEvents(numToReplay) : replayContinuous(numToReplay);
+    if (numReplayed < numToReplay && !is_finished_)
+    {
+        // The prefetcher is behind: hold the clock where playback stopped rather than skipping ahead.
+        if (!is_stalled_)
+        {
+            stall_count_++;
+            is_stalled_ = true;
+        }
+        playback_start_ms_ = Time::getMillisecondCounterHiRes();
+        playback_start_sample_ = next_sample_;
+        sleep(1);
+    }
+    else
+    {
+        is_stalled_ = false;
+    }
+    return true;
+}
+
+int RiverReplay::replayContinuous(int num_samples)
+{
+    int64 available = reader_->num_buffered();
+    if (available == 0)
+    {
+        is_finished_ = !reader_->Good();
+        return 0;
+    }
+
+    int64 numRead = reader_->ReadBytes(records_.data(), jmin((int64) num_samples, available), 1);
+    if (numRead <= 0)
+    {
+        is_finished_ = numRead < 0;
+        return 0;
+    }
+
+    RiverChannelField::convert(channels_, records_.data(), sample_size_, (int) numRead, samples_.getData());
+    for (int i = 0; i < numRead; i++)
+    {
+        sample_numbers_[i] = next_sample_ + i;
+        timestamps_[i] = (double) (next_sample_ + i) / sample_rate_;
+        event_codes_[i] = 0;
+    }
+    sourceBuffers[0]->addToBuffer(samples_.getData(),
+                                  sample_numbers_.getData(),
+                                  timestamps_.getData(),
+                                  event_codes_.getData(),
+                                  (int) numRead,
+                                  1);
+
+    next_sample_ += numRead;
+    samples_replayed_ += numRead;
+    return (int) numRead;
+}
+
+int RiverReplay::replayEvents(int num_samples)
+{
+    int i = 0;
+    while (i < num_samples)
+    {
+        if (!refillRecords())
+        {
+            if (!reader_eof_)
+            {
+                // The next record has not been prefetched yet, so it is unknown whether it falls in this range.
+                break;
+            }
+            // Emit the last records' tick, then stop.
+            if (!has_unflushed_records_)
+            {
+                is_finished_ = true;
+                break;
+            }
+        }
+        else
+        {
+            const char* record = records_.data() + record_pos_ * sample_size_;
+            if (recordSampleNumber(record) <= next_sample_ + i)
+            {
+                applyRecord(record);
+                record_pos_++;
+                has_unflushed_records_ = true;
+                continue;
+            }
+        }
+
+        samples_[i] = 0.0f;
+        sample_numbers_[i] = next_sample_ + i;
+        timestamps_[i] = (double) (next_sample_ + i) / sample_rate_;
+        event_codes_[i] = ttl_state_ | ttl_pulses_;
+        ttl_pulses_ = 0;
+        has_unflushed_records_ = false;
+        i++;
+    }
+
+    if (i > 0)
+    {
+        sourceBuffers[0]->addToBuffer(samples_.getData(),
+                                      sample_numbers_.getData(),
+                                      timestamps_.getData(),
+                                      event_codes_.getData(),
+                                      i,
+                                      1);
+        next_sample_ += i;
+        samples_replayed_ += i;
+    }
+    return i;
+}
+
+bool RiverReplay::refillRecords()
+{
+    if (record_pos_ < record_count_)
+    {
+        return true;
+    }
+
+    int64 available = reader_->num_buffered();
+    if (available == 0)
+    {
+        reader_eof_ = !reader_->Good();
+        return false;
+    }
+
+    int64 numRead = reader_->ReadBytes(records_.data(), jmin(available, (int64) kMaxSamplesPerUpdate), 1);
+    if (numRead <= 0)
+    {
+        reader_eof_ = numRead < 0;
+        return false;
+    }
+    record_pos_ = 0;
+    record_count_ = numRead;
+    return true;
+}
+
+void RiverReplay::applyRecord(const char* record)
+{
+    if (state_offset_ >= 0)
+    {
+        // RiverOutput encodes (line + 1), negated for an off transition.
+        int32 state;
+        memcpy(&state, record + state_offset_, sizeof(state));
+        int line = std::abs(state) - 1;
+        if (line < 0 || line >= kNumLines)
+        {
+            return;
+        }
+        if (state > 0)
+        {
+            ttl_state_ |= (uint64) 1 << line;
+        }
+        else
+        {
+            ttl_state_ &= ~((uint64) 1 << line);
+        }
+    }
+    else
+    {
+        int32 channel = 0;
+        if (channel_index_offset_ >= 0)
+        {
+            memcpy(&channel, record + channel_index_offset_, sizeof(channel));
+        }
+        ttl_pulses_ |= (uint64) 1 << (((channel % kNumLines) + kNumLines) % kNumLines);
+    }
+}
+
+int64 RiverReplay::recordSampleNumber(const char* record) const
+{
+    int64 sampleNumber;
+    memcpy(&sampleNumber, record + sample_number_offset_, sizeof(sampleNumber));
+    return sampleNumber;
+}
+
+const std::string &RiverReplay::redisConnectionHostname() const {
+    return redis_connection_hostname_;
+}
+
+void RiverReplay::setRedisConnectionHostname(const std::string &redisConnectionHostname) {
+    redis_connection_hostname_ = redisConnectionHostname;
+}
+
+int RiverReplay::redisConnectionPort() const {
+    return redis_connection_port_;
+}
+
+void RiverReplay::setRedisConnectionPort(int redisConnectionPort) {
+    redis_connection_port_ = redisConnectionPort;
+}
+
+const std::string &RiverReplay::redisConnectionPassword() const {
+    return redis_connection_password_;
+}
+
+void RiverReplay::setRedisConnectionPassword(const std::string &redisConnectionPassword) {
+    redis_connection_password_ = redisConnectionPassword;
+}
+
+const std::string &RiverReplay::streamName() const {
+    return stream_name_;
+}
+
+void RiverReplay::setStreamName(const std::string &streamName) {
+    stream_name_ = streamName;
+}
@@ -0,0 +1,208 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2016 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __RIVERREPLAY_H_4A7E91C2__
+#define __RIVERREPLAY_H_4A7E91C2__
+
+#include <DataThreadHeaders.h>
+#include "river/river.h"
+#include "RiverChannels.h"
+
+#include <atomic>
+
+/**
+ *  A source that replays an existing River stream into the signal chain from its first sample, at the stream's own
+ *  rate or `speed` times faster, so downstream processors can be benchmarked on a recorded session with reproducible
+ *  load.
+ *
+ *  Continuous streams (any FLOAT, DOUBLE or 2-byte field, as in RiverInput) are replayed as continuous channels, paced
+ *  by sample index. Spike and event streams (an INT64 "sample_number" field and no continuous fields) are paced by
+ *  their stored sample numbers, which are kept as the signal chain's sample numbers; they produce a single silent
+ *  clock channel plus a TTL event channel:
+ *  - records with a "state" field are TTL events in the layout RiverOutput writes, and set or clear line
+ *    |state| - 1;
+ *  - other records (e.g. spikes) pulse line "channel_index" (mod 64) for one sample.
+ *
+ *  Unlike RiverInput nothing is ever dropped: if the prefetcher falls behind playback, playback waits (a stall) and
+ *  resumes from where it was.
+ *
+    @see DataThread, RiverInput
+ */
+class RiverReplay : public DataThread
+{
+public:
+    /** Number of TTL lines on the event channel of a replayed spike or event stream */
+    static constexpr int kNumLines = 64;
+
+    /** Constructor */
+    RiverReplay(SourceNode* sn);
+
+    /** Destructor */
+    ~RiverReplay() override;
+
+    /** Creates a RiverReplay data thread */
+    static DataThread* createDataThread(SourceNode* sn);
+
+    /** Creates the RiverReplayEditor */
+    std::unique_ptr<GenericEditor> createEditor(SourceNode* sn) override;
+
+    /** Replays the samples or records that are due */
+    bool updateBuffer() override;
+
+    /** True if the configured stream was found */
+    bool foundInputSource() override;
+
+    /** Starts prefetching from the beginning of the stream */
+    bool startAcquisition() override;
+
+    /** Stops prefetching */
+    bool stopAcquisition() override;
+
+    /** Reads the stream's schema and metadata and creates its channels */
+    void updateSettings(OwnedArray<ContinuousChannel>* continuousChannels,
+                        OwnedArray<EventChannel>* eventChannels,
+                        OwnedArray<SpikeChannel>* spikeChannels,
+                        OwnedArray<DataStream>* sourceStreams,
+                        OwnedArray<DeviceInfo>* devices,
+                        OwnedArray<ConfigurationObject>* configurationObjects) override;
+
+    //
+    // Non-override methods:
+    //
+    const std::string &redisConnectionHostname() const;
+    void setRedisConnectionHostname(const std::string &redisConnectionHostname);
+    int redisConnectionPort() const;
+    void setRedisConnectionPort(int redisConnectionPort);
+    const std::string &redisConnectionPassword() const;
+    void setRedisConnectionPassword(const std::string &redisConnectionPassword);
+
+    const std::string &streamName() const;
+    void setStreamName(const std::string &streamName);
+
+    /** Playback rate relative to the stream's sample rate; 1 is real time */
+    float speed() const {
+        return speed_;
+    }
+
+    void setSpeed(float speed) {
+        speed_ = speed;
+    }
+
+    float sampleRate() const {
+        return sample_rate_;
+    }
+
+    bool isEventStream() const {
+        return is_event_stream_;
+    }
+
+    int numChannels() const {
+        return is_event_stream_ ? 1 : (int) channels_.size();
+    }
+
+    int64 stallCount() const {
+        return stall_count_;
+    }
+
+    /** Stream time replayed so far, in samples */
+    int64 samplesReplayed() const {
+        return samples_replayed_;
+    }
+
+    /** True once every sample or record of the stream has been replayed */
+    bool isFinished() const {
+        return is_finished_;
+    }
+
+private:
+    /** Reads the stream's schema and metadata; returns false if the stream cannot be replayed */
+    bool connectToStream();
+
+    /** True if `schema` has the layout that channels_, records_ and the field offsets were set up for */
+    bool matchesSettings(const river::StreamSchema& schema) const;
+
+    /** Replays up to `num_samples` samples of a continuous stream; returns how many were replayed */
+    int replayContinuous(int num_samples);
+
+    /** Replays up to `num_samples` clock ticks of a spike or event stream; returns how many were replayed */
+    int replayEvents(int num_samples);
+
+    /** Reads the next batch of records into records_ if none are left; false if none are available yet or at EOF */
+    bool refillRecords();
+
+    /** Applies one record to the TTL line state */
+    void applyRecord(const char* record);
+
+    int64 recordSampleNumber(const char* record) const;
+
+    river::RedisConnection connection() const;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RiverReplay)
+
+    std::string redis_connection_hostname_;
+    int redis_connection_port_;
+    std::string redis_connection_password_;
+    std::string stream_name_;
+    float speed_;
+
+    // Set by updateSettings() from the stream's schema and metadata.
+    bool found_stream_ = false;
+    bool is_event_stream_ = false;
+    float sample_rate_;
+    float bit_volts_;
+    int sample_size_ = 0;
+    std::vector<RiverChannelField> channels_;
+    int sample_number_offset_ = -1;
+    int state_offset_ = -1;
+    int channel_index_offset_ = -1;
+
+    std::unique_ptr<river::PrefetchingStreamReader> reader_;
+
+    // Playback clock, only touched on the data thread. Stream sample `playback_start_sample_` was due at
+    // `playback_start_ms_`; next_sample_ is the next one to hand to the signal chain.
+    double playback_start_ms_ = 0;
+    int64 playback_start_sample_ = 0;
+    int64 next_sample_ = 0;
+    bool is_started_ = false;
+    bool is_stalled_ = false;
+    bool reader_eof_ = false;
+
+    // Records read but not yet replayed, for spike and event streams.
+    int64 record_pos_ = 0;
+    int64 record_count_ = 0;
+    uint64 ttl_state_ = 0;
+    uint64 ttl_pulses_ = 0;
+    bool has_unflushed_records_ = false;
+
+    std::vector<char> records_;
+    HeapBlock<float> samples_;
+    HeapBlock<int64> sample_numbers_;
+    HeapBlock<double> timestamps_;
+    HeapBlock<uint64> event_codes_;
+
+    std::atomic<int64> samples_replayed_{0};
+    std::atomic<int64> stall_count_{0};
+    std::atomic<bool> is_finished_{false};
+};
+
+#endif  // __RIVERREPLAY_H_4A7E91C2__
@@ -0,0 +1,158 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2014 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "RiverReplayEditor.h"
+
+RiverReplayEditor::RiverReplayEditor(GenericProcessor *parentNode, RiverReplay *thread_)
+        : GenericEditor(parentNode), thread(thread_) {
+
+    desiredWidth = 300;
+
+    hostnameLabel = newStaticLabel("Hostname", 10, 25, 80, 20);
+    hostnameLabelValue = newInputLabel("hostnameLabelValue", "Set the hostname for River", 15, 42, 80, 18);
+
+    portLabel = newStaticLabel("Port", 10, 65, 80, 20);
+    portLabelValue = newInputLabel("portLabelValue", "Set the port for River", 15, 82, 60, 18);
+
+    streamNameLabel = newStaticLabel("Stream Name", 105, 25, 100, 20);
+    streamNameLabelValue = newInputLabel("streamNameLabelValue", "Name of the River stream to replay", 110, 42, 90, 18);
+
+    speedLabel = newStaticLabel("Speed (x)", 105, 65, 100, 20);
+    speedLabelValue = newInputLabel("speedLabelValue",
+                                    "Playback rate relative to the stream's sample rate; 1 is real time",
+                                    110, 82, 60, 18);
+
+    passwordLabel = newStaticLabel("Password", 205, 25, 90, 20);
+    passwordLabelValue = newInputLabel("passwordLabelValue", "Set the password for River", 210, 42, 80, 18);
+
+    connectButton = new UtilityButton("Connect", titleFont);
+    connectButton->setBounds(210, 80, 80, 20);
+    connectButton->addListener(this);
+    addAndMakeVisible(connectButton);
+
+    statusLabel = newStaticLabel("", 10, 104, 280, 18);
+
+    refreshLabelsFromThread();
+}
+
+void RiverReplayEditor::buttonClicked(Button *button) {
+    if (button == connectButton) {
+        CoreServices::updateSignalChain(this);
+        refreshLabelsFromThread();
+    }
+}
+
+void RiverReplayEditor::labelTextChanged(Label *label) {
+    if (label == hostnameLabelValue) {
+        thread->setRedisConnectionHostname(label->getText().toStdString());
+    } else if (label == portLabelValue) {
+        int port = label->getText().getIntValue();
+        if (port > 0) {
+            thread->setRedisConnectionPort(port);
+            lastPortValue = label->getText().toStdString();
+        } else {
+            label->setText(juce::String(lastPortValue), dontSendNotification);
+        }
+    } else if (label == passwordLabelValue) {
+        thread->setRedisConnectionPassword(label->getText().toStdString());
+    } else if (label == streamNameLabelValue) {
+        thread->setStreamName(label->getText().toStdString());
+    } else if (label == speedLabelValue) {
+        float speed = label->getText().getFloatValue();
+        if (speed > 0) {
+            thread->setSpeed(speed);
+        }
+        label->setText(juce::String(thread->speed()), dontSendNotification);
+    }
+}
+
+void RiverReplayEditor::startAcquisition() {
+    for (Label *label : {hostnameLabelValue.get(), portLabelValue.get(), passwordLabelValue.get(),
+                         streamNameLabelValue.get(), speedLabelValue.get()}) {
+        label->setEditable(false);
+    }
+    connectButton->setEnabled(false);
+    startTimer(250);
+}
+
+void RiverReplayEditor::stopAcquisition() {
+    stopTimer();
+    for (Label *label : {hostnameLabelValue.get(), portLabelValue.get(), passwordLabelValue.get(),
+                         streamNameLabelValue.get(), speedLabelValue.get()}) {
+        label->setEditable(true);
+    }
+    connectButton->setEnabled(true);
+    refreshLabelsFromThread();
+}
+
+void RiverReplayEditor::timerCallback() {
+    refreshLabelsFromThread();
+}
+
+void RiverReplayEditor::refreshLabelsFromThread() {
+    lastPortValue = std::to_string(thread->redisConnectionPort());
+
+    hostnameLabelValue->setText(thread->redisConnectionHostname(), dontSendNotification);
+    portLabelValue->setText(lastPortValue, dontSendNotification);
+    passwordLabelValue->setText(thread->redisConnectionPassword(), dontSendNotification);
+    streamNameLabelValue->setText(thread->streamName(), dontSendNotification);
+    speedLabelValue->setText(juce::String(thread->speed()), dontSendNotification);
+
+    if (!thread->foundInputSource()) {
+        statusLabel->setText("Stream not found", dontSendNotification);
+    } else {
+        juce::String kind = thread->isEventStream() ? "events" : juce::String(thread->numChannels()) + " ch";
+        juce::String position = thread->isFinished()
+                                ? "finished"
+                                : juce::String(thread->samplesReplayed() / thread->sampleRate(), 1) + " s";
+        statusLabel->setText(kind + " @ " + juce::String(thread->sampleRate()) + " Hz   " + position
+                             + "   stalls " + juce::String(thread->stallCount()),
+                             dontSendNotification);
+    }
+}
+
+void RiverReplayEditor::saveCustomParametersToXml(XmlElement *parentElement) {
+    XmlElement *mainNode = parentElement->createNewChildElement("RiverReplay");
+    mainNode->setAttribute("hostname", thread->redisConnectionHostname());
+    mainNode->setAttribute("port", thread->redisConnectionPort());
+    mainNode->setAttribute("password", thread->redisConnectionPassword());
+    mainNode->setAttribute("stream_name", thread->streamName());
+    mainNode->setAttribute("speed", thread->speed());
+}
+
+void RiverReplayEditor::loadCustomParametersFromXml(XmlElement *xml) {
+    forEachXmlChildElement(*xml, mainNode)
+    {
+        if (!mainNode->hasTagName("RiverReplay")) {
+            continue;
+        }
+
+        thread->setRedisConnectionHostname(mainNode->getStringAttribute("hostname", "127.0.0.1").toStdString());
+        thread->setRedisConnectionPort(mainNode->getIntAttribute("port", 6379));
+        thread->setRedisConnectionPassword(mainNode->getStringAttribute("password", "").toStdString());
+        thread->setStreamName(mainNode->getStringAttribute("stream_name", "").toStdString());
+        thread->setSpeed((float) mainNode->getDoubleAttribute("speed", thread->speed()));
+    }
+
+    refreshLabelsFromThread();
+}
@@ -0,0 +1,281 @@
+#ifndef PARENT_COLUMNAR_H
+#define PARENT_COLUMNAR_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "layout.h"
+#include "reader.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define RIVER_COLUMNAR_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RIVER_COLUMNAR_SSE2 1
+#endif
+
+namespace river {
+namespace internal {
+
+/**
+ * Transposes `num_samples` 16-byte rows of the form {4 bytes, 4 bytes, 8 bytes} (e.g. the spike and TTL records:
+ * channel_index, unit_index/state, sample_number) into three dense columns. Any column may be null to skip it.
+ */
+inline void TransposeRows448(const char *rows, int64_t num_samples, char *col0, char *col1, char *col2) {
+    int64_t i = 0;
+    if (col0 != nullptr && col1 != nullptr && col2 != nullptr) {
+#if defined(RIVER_COLUMNAR_AVX2)
+        // 8 rows per iteration; each 256-bit register holds two rows.
+        const __m256i order32 = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        for (; i + 8 <= num_samples; i += 8) {
+            const char *src = rows + i * 16;
+            __m256i y0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+            __m256i y1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 32));
+            __m256i y2 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 64));
+            __m256i y3 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 96));
+
+            __m256i lo01 = _mm256_unpacklo_epi32(y0, y1);
+            __m256i lo23 = _mm256_unpacklo_epi32(y2, y3);
+            __m256i a = _mm256_permutevar8x32_epi32(_mm256_unpacklo_epi64(lo01, lo23), order32);
+            __m256i b = _mm256_permutevar8x32_epi32(_mm256_unpackhi_epi64(lo01, lo23), order32);
+            __m256i c01 = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(y0, y1), 0xD8);
+            __m256i c23 = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(y2, y3), 0xD8);
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(col0 + i * 4), a);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(col1 + i * 4), b);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(col2 + i * 8), c01);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(col2 + i * 8 + 32), c23);
+        }
+#endif
+#if defined(RIVER_COLUMNAR_SSE2)
+        // 4 rows per iteration; each 128-bit register holds one row.
+        for (; i + 4 <= num_samples; i += 4) {
+            const char *src = rows + i * 16;
+            __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+            __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 16));
+            __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 32));
+            __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 48));
+
+            __m128i lo01 = _mm_unpacklo_epi32(r0, r1);
+            __m128i lo23 = _mm_unpacklo_epi32(r2, r3);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(col0 + i * 4), _mm_unpacklo_epi64(lo01, lo23));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(col1 + i * 4), _mm_unpackhi_epi64(lo01, lo23));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(col2 + i * 8), _mm_unpackhi_epi64(r0, r1));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(col2 + i * 8 + 16), _mm_unpackhi_epi64(r2, r3));
+        }
+#endif
+    }
+
+    for (; i < num_samples; i++) {
+        const char *src = rows + i * 16;
+        if (col0 != nullptr) {
+            memcpy(col0 + i * 4, src, 4);
+        }
+        if (col1 != nullptr) {
+            memcpy(col1 + i * 4, src + 4, 4);
+        }
+        if (col2 != nullptr) {
+            memcpy(col2 + i * 8, src + 8, 8);
+        }
+    }
+}
+
+/**
+ * Rounds to nearest (ties to even, as the SIMD conversion does) and saturates to the int16 range. NaN maps to
+ * INT16_MIN, which is what the SIMD conversion gives for it.
+ */
+inline int16_t QuantizeInt16(float value) {
+    if (!(value == value)) {
+        return INT16_MIN;
+    }
+    value = std::nearbyint(std::min(std::max(value, -32768.0f), 32767.0f));
+    return static_cast<int16_t>(value);
+}
+
+/**
+ * Interleaves `num_frames` samples of `num_channels` planar float channels into frames of the form
+ * {int64 sample_number, float channel[num_channels]}, the inverse of a columnar read. Frame i is stamped with
+ * `first_sample + i * sample_step`. `frames` must hold `num_frames * (8 + 4 * num_channels)` bytes.
+ */
+inline void InterleaveFrames(const float *const *channels,
+                             int num_channels,
+                             int64_t num_frames,
+                             int64_t first_sample,
+                             char *frames,
+                             int64_t sample_step = 1) {
+    const size_t stride = sizeof(int64_t) + sizeof(float) * static_cast<size_t>(num_channels);
+    for (int64_t i = 0; i < num_frames; i++) {
+        int64_t sample_number = first_sample + i * sample_step;
+        memcpy(frames + i * stride, &sample_number, sizeof(sample_number));
+    }
+
+    int c = 0;
+#if defined(RIVER_COLUMNAR_SSE2)
+    // 4x4 tiles: 4 frames of 4 channels are loaded column-wise and stored row-wise.
+    for (; c + 4 <= num_channels; c += 4) {
+        char *dst = frames + sizeof(int64_t) + c * sizeof(float);
+        int64_t i = 0;
+        for (; i + 4 <= num_frames; i += 4) {
+            __m128 r0 = _mm_loadu_ps(channels[c] + i);
+            __m128 r1 = _mm_loadu_ps(channels[c + 1] + i);
+            __m128 r2 = _mm_loadu_ps(channels[c + 2] + i);
+            __m128 r3 = _mm_loadu_ps(channels[c + 3] + i);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            _mm_storeu_ps(reinterpret_cast<float *>(dst + i * stride), r0);
+            _mm_storeu_ps(reinterpret_cast<float *>(dst + (i + 1) * stride), r1);
+            _mm_storeu_ps(reinterpret_cast<float *>(dst + (i + 2) * stride), r2);
+            _mm_storeu_ps(reinterpret_cast<float *>(dst + (i + 3) * stride), r3);
+        }
+        for (; i < num_frames; i++) {
+            for (int k = 0; k < 4; k++) {
+                memcpy(dst + i * stride + k * sizeof(float), channels[c + k] + i, sizeof(float));
+            }
+        }
+    }
+#endif
+
+    for (; c < num_channels; c++) {
+        char *dst = frames + sizeof(int64_t) + c * sizeof(float);
+        const float *src = channels[c];
+        for (int64_t i = 0; i < num_frames; i++) {
+            memcpy(dst + i * stride, src + i, sizeof(float));
+        }
+    }
+}
+
+/**
+ * Like #InterleaveFrames(), but quantizes each channel to int16 on the way: frames are
+ * {int64 sample_number, int16 channel[num_channels]}, and channel c is stored as its value times `inv_scales[c]`,
+ * rounded to nearest and saturated to [-32768, 32767]. `frames` must hold `num_frames * (8 + 2 * num_channels)` bytes.
+ */
+inline void InterleaveFramesInt16(const float *const *channels,
+                                  const float *inv_scales,
+                                  int num_channels,
+                                  int64_t num_frames,
+                                  int64_t first_sample,
+                                  char *frames,
+                                  int64_t sample_step = 1) {
+    const size_t stride = sizeof(int64_t) + sizeof(int16_t) * static_cast<size_t>(num_channels);
+    for (int64_t i = 0; i < num_frames; i++) {
+        int64_t sample_number = first_sample + i * sample_step;
+        memcpy(frames + i * stride, &sample_number, sizeof(sample_number));
+    }
+
+    int c = 0;
+#if defined(RIVER_COLUMNAR_SSE2)
+    // Clamping in float first keeps out-of-range values from converting to INT32_MIN; the saturating pack then
+    // narrows to 16 bits.
+    const __m128 lo = _mm_set1_ps(-32768.0f);
+    const __m128 hi = _mm_set1_ps(32767.0f);
+    for (; c + 4 <= num_channels; c += 4) {
+        char *dst = frames + sizeof(int64_t) + c * sizeof(int16_t);
+        const __m128 s0 = _mm_set1_ps(inv_scales[c]);
+        const __m128 s1 = _mm_set1_ps(inv_scales[c + 1]);
+        const __m128 s2 = _mm_set1_ps(inv_scales[c + 2]);
+        const __m128 s3 = _mm_set1_ps(inv_scales[c + 3]);
+        int64_t i = 0;
+        for (; i + 4 <= num_frames; i += 4) {
+            __m128 r0 = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(channels[c] + i), s0), lo), hi);
+            __m128 r1 = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(channels[c + 1] + i), s1), lo), hi);
+            __m128 r2 = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(channels[c + 2] + i), s2), lo), hi);
+            __m128 r3 = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(channels[c + 3] + i), s3), lo), hi);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            __m128i f01 = _mm_packs_epi32(_mm_cvtps_epi32(r0), _mm_cvtps_epi32(r1));
+            __m128i f23 = _mm_packs_epi32(_mm_cvtps_epi32(r2), _mm_cvtps_epi32(r3));
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i * stride), f01);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + (i + 1) * stride), _mm_srli_si128(f01, 8));
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + (i + 2) * stride), f23);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + (i + 3) * stride), _mm_srli_si128(f23, 8));
+        }
+        for (; i < num_frames; i++) {
+            for (int k = 0; k < 4; k++) {
+                int16_t value = QuantizeInt16(channels[c + k][i] * inv_scales[c + k]);
+                memcpy(dst + i * stride + k * sizeof(int16_t), &value, sizeof(value));
+            }
+        }
+    }
+#endif
+
+    for (; c < num_channels; c++) {
+        char *dst = frames + sizeof(int64_t) + c * sizeof(int16_t);
+        const float *src = channels[c];
+        for (int64_t i = 0; i < num_frames; i++) {
+            int16_t value = QuantizeInt16(src[i] * inv_scales[c]);
+            memcpy(dst + i * stride, &value, sizeof(value));
+        }
+    }
+}
+
+/**
+ * Transposes `num_samples` contiguous fixed-width samples into one dense column per field. `columns[f]` must hold
+ * `num_samples * layout.field(f).size` bytes, or be null to skip field f.
+ */
+inline void TransposeRows(const StreamLayout &layout, const char *rows, int64_t num_samples, char *const *columns) {
+    if (layout.num_fields() == 3
+        && layout.field(0).size == 4
+        && layout.field(1).size == 4
+        && layout.field(2).size == 8) {
+        TransposeRows448(rows, num_samples, columns[0], columns[1], columns[2]);
+        return;
+    }
+
+    for (int f = 0; f < layout.num_fields(); f++) {
+        if (columns[f] != nullptr) {
+            layout.ExtractColumn(rows, num_samples, f, columns[f]);
+        }
+    }
+}
+
+}
+
+/**
+ * Reads batches of an existing fixed-width stream directly into struct-of-arrays form: one dense column buffer per
+ * FieldDefinition. Rows are staged in a buffer owned by this object (grown only to the largest batch seen) and then
+ * transposed with SIMD kernels where available.
+ */
+class ColumnarReader {
+public:
+    /**
+     * @param reader An initialized StreamReader over a stream without variable-width fields; must outlive this object.
+     */
+    explicit ColumnarReader(StreamReader *reader) : reader_(reader), layout_(reader->schema()) {
+        if (layout_.has_variable_width_field()) {
+            throw StreamReaderException("Columnar reads are not supported for streams with variable-width fields.");
+        }
+    }
+
+    /**
+     * Reads up to `num_samples` samples. Semantics (blocking, timeout, return value) match StreamReader::ReadBytes.
+     *
+     * @param columns One pointer per field in schema order. `columns[f]` must hold
+     * `num_samples * layout().field(f).size` bytes, or be null to skip that field.
+     */
+    int64_t Read(char *const *columns, int64_t num_samples, int timeout_ms = -1) {
+        size_t needed = static_cast<size_t>(num_samples) * layout_.sample_size();
+        if (rows_.size() < needed) {
+            rows_.resize(needed);
+        }
+        int64_t num_read = reader_->ReadBytes(rows_.data(), num_samples, nullptr, nullptr, timeout_ms);
+        if (num_read > 0) {
+            internal::TransposeRows(layout_, rows_.data(), num_read, columns);
+        }
+        return num_read;
+    }
+
+    const StreamLayout &layout() const {
+        return layout_;
+    }
+
+private:
+    StreamReader *reader_;
+    const StreamLayout layout_;
+    std::vector<char> rows_;
+};
+
+}
+
+#endif //PARENT_COLUMNAR_H
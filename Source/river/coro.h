@@ -0,0 +1,372 @@
+#ifndef PARENT_CORO_H
+#define PARENT_CORO_H
+
+// Coroutine-based async API. Only available when compiling as C++20 with coroutine support; the rest of River (and
+// the plugin, built as C++17) does not depend on it.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <list>
+#include <map>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "schema.h"
+#include "reader.h"
+#include "writer.h"
+#include "decoder.h"
+#include "reactor.h"
+#include "redis.h"
+
+namespace river {
+
+template<class T>
+class Task;
+
+namespace internal {
+
+/**
+ * Resumes the awaiting coroutine, if any, when a Task finishes.
+ */
+typedef struct TaskFinalAwaiter {
+    bool await_ready() noexcept {
+        return false;
+    }
+
+    template<class Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+        std::coroutine_handle<> continuation = handle.promise().continuation;
+        return continuation ? continuation : std::noop_coroutine();
+    }
+
+    void await_resume() noexcept {}
+} TaskFinalAwaiter;
+
+typedef struct TaskPromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+
+    std::suspend_always initial_suspend() noexcept {
+        return {};
+    }
+
+    TaskFinalAwaiter final_suspend() noexcept {
+        return {};
+    }
+
+    void unhandled_exception() {
+        error = std::current_exception();
+    }
+} TaskPromiseBase;
+
+template<class T>
+struct TaskPromise : TaskPromiseBase {
+    std::optional<T> value;
+
+    Task<T> get_return_object();
+
+    void return_value(T result) {
+        value = std::move(result);
+    }
+
+    T Result() {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return std::move(*value);
+    }
+};
+
+template<>
+struct TaskPromise<void> : TaskPromiseBase {
+    Task<void> get_return_object();
+
+    void return_void() {}
+
+    void Result() {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+}
+
+/**
+ * A lazily started coroutine returning T. Awaiting it starts it and resumes the awaiter when it finishes, rethrowing
+ * any exception it threw. Move-only.
+ */
+template<class T = void>
+class Task {
+public:
+    typedef internal::TaskPromise<T> promise_type;
+    typedef std::coroutine_handle<promise_type> Handle;
+
+    explicit Task(Handle handle) : handle_(handle) {}
+
+    Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+
+    Task &operator=(Task &&other) noexcept {
+        if (this != &other) {
+            if (handle_) {
+                handle_.destroy();
+            }
+            handle_ = std::exchange(other.handle_, {});
+        }
+        return *this;
+    }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    ~Task() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept {
+        return !handle_ || handle_.done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+        handle_.promise().continuation = awaiter;
+        return handle_;
+    }
+
+    T await_resume() {
+        return handle_.promise().Result();
+    }
+
+private:
+    friend class EventLoop;
+
+    Handle handle_;
+};
+
+namespace internal {
+
+template<class T>
+Task<T> TaskPromise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+}
+
+/**
+ * A single-threaded executor for River coroutines. Spawned tasks run on the thread calling #Run(); a task waiting on a
+ * redis reply is parked until its connection's socket is readable, using the same epoll/poll wait as StreamReactor.
+ * Each connection (one per AsyncStreamReader or AsyncStreamWriter) may have only one operation in flight.
+ */
+class EventLoop {
+public:
+    EventLoop() = default;
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    /**
+     * Schedules `task` to run on this loop; it starts on the next #Run().
+     */
+    void Spawn(Task<void> task) {
+        ready_.push_back(task.handle_);
+        spawned_.push_back(std::move(task));
+    }
+
+    /**
+     * Runs until every spawned task has finished. An exception thrown by a spawned task is rethrown here.
+     */
+    void Run() {
+        while (!spawned_.empty()) {
+            while (!ready_.empty()) {
+                std::coroutine_handle<> handle = ready_.front();
+                ready_.pop_front();
+                handle.resume();
+            }
+
+            for (auto it = spawned_.begin(); it != spawned_.end();) {
+                if (it->handle_.done()) {
+                    Task<void> finished = std::move(*it);
+                    it = spawned_.erase(it);
+                    finished.handle_.promise().Result();
+                } else {
+                    ++it;
+                }
+            }
+            if (spawned_.empty()) {
+                break;
+            }
+            if (waiting_.empty()) {
+                throw StreamReaderException("Event loop tasks are suspended with no pending redis reply.");
+            }
+
+            poller_.Wait(-1, &readable_);
+            for (int64_t tag : readable_) {
+                auto it = waiting_.find(tag);
+                if (it != waiting_.end()) {
+                    poller_.Remove(it->second.fd);
+                    ready_.push_back(it->second.handle);
+                    waiting_.erase(it);
+                }
+            }
+        }
+    }
+
+    /**
+     * Awaitable that suspends the calling task until `fd` is readable.
+     */
+    auto Readable(redisFD fd) {
+        struct Awaiter {
+            EventLoop *loop;
+            redisFD fd;
+
+            bool await_ready() const noexcept {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                int64_t tag = loop->next_tag_++;
+                loop->poller_.Add(fd, tag);
+                loop->waiting_[tag] = Waiter{fd, handle};
+            }
+
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{this, fd};
+    }
+
+private:
+    typedef struct Waiter {
+        redisFD fd;
+        std::coroutine_handle<> handle;
+    } Waiter;
+
+    internal::SocketPoller poller_;
+    std::list<Task<void>> spawned_;
+    std::deque<std::coroutine_handle<>> ready_;
+    std::map<int64_t, Waiter> waiting_;
+    std::vector<int64_t> readable_;
+    int64_t next_tag_ = 0;
+};
+
+/**
+ * Awaitable reads of one stream on an EventLoop, following it across redis keys like StreamReader.
+ *
+ *     auto n = co_await reader.ReadAsync(buffer, 1024);
+ */
+class AsyncStreamReader {
+public:
+    /**
+     * @param connection: parameters to connect to Redis
+     * @param max_fetch_size: maximum number of samples to fetch per XREAD.
+     */
+    AsyncStreamReader(EventLoop &loop, const RedisConnection &connection, int max_fetch_size = 10000)
+            : loop_(loop), cursor_(connection, max_fetch_size) {}
+
+    /**
+     * Looks up the stream's metadata, waiting up to `timeout_ms` for it to be created as in StreamReader::Initialize.
+     * Blocks the calling thread; call it before spawning tasks that use this reader.
+     */
+    void Initialize(const std::string &stream_name, int timeout_ms = -1) {
+        cursor_.Initialize(stream_name, timeout_ms);
+    }
+
+    /**
+     * Reads up to `num_samples` samples into `buffer` as StreamReader::ReadBytes would, completing as soon as at
+     * least one sample is available (at most max_fetch_size are read at once).
+     *
+     * @return the number of samples read, or -1 on EOF.
+     */
+    Task<int64_t> ReadAsync(char *buffer, int64_t num_samples, int *sizes = nullptr) {
+        while (true) {
+            cursor_.BeginRead(buffer, num_samples, sizes, 0);
+            int64_t num_read;
+            do {
+                co_await loop_.Readable(cursor_.socket());
+            } while (!cursor_.ReceiveRead(&num_read));
+
+            // Nothing read means the read only crossed into the next key.
+            if (num_read != 0) {
+                co_return num_read;
+            }
+        }
+    }
+
+    bool Good() const {
+        return cursor_.Good();
+    }
+
+    const StreamSchema &schema() const {
+        return cursor_.schema();
+    }
+
+    const std::string &stream_name() const {
+        return cursor_.stream_name();
+    }
+
+    int64_t total_samples_read() const {
+        return cursor_.total_samples_read();
+    }
+
+private:
+    EventLoop &loop_;
+    internal::StreamCursor cursor_;
+};
+
+/**
+ * Awaitable writes to a stream on an EventLoop. Wraps an initialized StreamWriter and writes through a WriteScratch
+ * as StreamWriter::WriteBytes(data, num_samples, scratch) does, but yields to other tasks while waiting for the
+ * replies. Fixed-width schemas only.
+ *
+ *     co_await writer.WriteAsync(buffer, 1024);
+ */
+class AsyncStreamWriter {
+public:
+    /**
+     * @param writer: an initialized writer, which must not be used directly while this wraps it
+     * @param capacity_samples: maximum number of samples sent per round trip.
+     */
+    AsyncStreamWriter(EventLoop &loop, StreamWriter &writer, int64_t capacity_samples = 1536)
+            : loop_(loop), writer_(writer), scratch_(capacity_samples, writer.sample_size_) {}
+
+    Task<void> WriteAsync(const char *data, int64_t num_samples) {
+        while (num_samples > 0) {
+            bool is_pending;
+            int64_t n = writer_.SendScratchBatch(data, num_samples, scratch_, &is_pending);
+            if (is_pending) {
+                int64_t num_remaining = n;
+                int64_t num_errors = 0;
+                do {
+                    co_await loop_.Readable(writer_.redis_->fd());
+                } while (!writer_.redis_->TryDiscardReplies(&num_remaining, &num_errors));
+                writer_.FinishScratchBatch(n, num_errors);
+            }
+            data += n * writer_.sample_size_;
+            num_samples -= n;
+        }
+    }
+
+    StreamWriter &writer() {
+        return writer_;
+    }
+
+private:
+    EventLoop &loop_;
+    StreamWriter &writer_;
+    WriteScratch scratch_;
+};
+
+}
+
+#endif
+
+#endif //PARENT_CORO_H
@@ -0,0 +1,630 @@
+#ifndef PARENT_DECODER_H
+#define PARENT_DECODER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include "schema.h"
+#include "reader.h"
+#include "redis.h"
+
+namespace river {
+namespace internal {
+
+/**
+ * Decodes the entries of an XREAD or XRANGE reply while hiredis parses it, instead of building a redisReply tree and
+ * searching it afterwards. Entry IDs and sample indices are parsed in place, and each `val` payload is copied straight
+ * into the caller's buffer. Fields are recognized in the order the writer emits them (`i` before `val`; `tombstone`,
+ * `next_stream_key`, `sample_index`; `eof`, `sample_index`), but any order is accepted since every field name is
+ * classified as it arrives. Nothing here allocates.
+ */
+class EntryDecoder {
+public:
+    // Depth of each [id, fields] entry within a reply: XREAD nests entries under [stream, entries] pairs, XRANGE
+    // returns them at the top level.
+    static constexpr int kXreadEntryDepth = 3;
+    static constexpr int kXrangeEntryDepth = 1;
+
+    static constexpr size_t kMaxStreamKeyLength = 320;
+
+    /**
+     * Prepares to decode one reply.
+     *
+     * @param buffer Receives up to `max_samples` payloads; fixed-width payloads every `sample_size` bytes and
+     * variable-width payloads (of at most `sample_size` bytes) back to back.
+     * @param sizes If not null, receives the size of each payload.
+     * @param id_ms If not null, receives the millisecond (left) part of each payload's entry ID.
+     */
+    void Reset(int entry_depth,
+               char *buffer,
+               int64_t max_samples,
+               int sample_size,
+               bool variable_width,
+               int *sizes,
+               uint64_t *id_ms = nullptr) {
+        entry_depth_ = entry_depth;
+        buffer_ = buffer;
+        max_samples_ = max_samples;
+        sample_size_ = sample_size;
+        variable_width_ = variable_width;
+        sizes_ = sizes;
+        id_ms_ = id_ms;
+
+        num_samples_ = 0;
+        num_bytes_ = 0;
+        num_entries_ = 0;
+        has_last_id_ = false;
+        next_stream_key_len_ = 0;
+        has_next_stream_key_ = false;
+        is_eof_ = false;
+        error_ = nullptr;
+        error_length_ = 0;
+        redis_error_len_ = 0;
+        field_ = FIELD_NONE;
+    }
+
+    /**
+     * Callbacks to pass to Redis::DecodeReply, with this decoder as the privdata.
+     */
+    static redisReplyObjectFunctions *Functions() {
+        static redisReplyObjectFunctions functions = {
+                &EntryDecoder::CreateString,
+                &EntryDecoder::CreateArray,
+                &EntryDecoder::CreateInteger,
+                &EntryDecoder::CreateDouble,
+                &EntryDecoder::CreateNil,
+                &EntryDecoder::CreateBool,
+                &EntryDecoder::FreeObject,
+        };
+        return &functions;
+    }
+
+    int64_t num_samples() const {
+        return num_samples_;
+    }
+
+    int64_t num_bytes() const {
+        return num_bytes_;
+    }
+
+    /**
+     * Number of entries (data, tombstone or EOF) consumed from the reply.
+     */
+    int64_t num_entries() const {
+        return num_entries_;
+    }
+
+    /**
+     * Whether any entry was consumed, in which case last_left()/last_right() give the ID of the last one.
+     */
+    bool has_last_id() const {
+        return has_last_id_;
+    }
+
+    uint64_t last_left() const {
+        return last_left_;
+    }
+
+    uint64_t last_right() const {
+        return last_right_;
+    }
+
+    /**
+     * Sample index (field `i`) of the last data entry consumed.
+     */
+    int64_t last_sample_index() const {
+        return last_sample_index_;
+    }
+
+    bool has_next_stream_key() const {
+        return has_next_stream_key_;
+    }
+
+    const char *next_stream_key() const {
+        return next_stream_key_;
+    }
+
+    size_t next_stream_key_length() const {
+        return next_stream_key_len_;
+    }
+
+    bool is_eof() const {
+        return is_eof_;
+    }
+
+    /**
+     * A description of why the reply could not be decoded, or null. For payload size errors, error_length() gives the
+     * offending size.
+     */
+    const char *error() const {
+        return error_;
+    }
+
+    int64_t error_length() const {
+        return error_length_;
+    }
+
+    /**
+     * Depth of a task within its reply; the top-level reply is at depth 0.
+     */
+    static int Depth(const redisReadTask *task) {
+        int depth = 0;
+        for (const redisReadTask *t = task->parent; t != nullptr; t = t->parent) {
+            depth++;
+        }
+        return depth;
+    }
+
+    /**
+     * Feeds one string element of a reply to the decoder. Functions() calls this for every string; a dispatcher that
+     * splits a multi-stream XREAD reply across several decoders calls it directly.
+     */
+    void OnString(int type, int depth, int idx, const char *str, size_t len) {
+        if (error_ != nullptr) {
+            return;
+        }
+        if (type == REDIS_REPLY_ERROR) {
+            error_ = "Error reply from redis";
+            redis_error_len_ = std::min(len, sizeof(redis_error_));
+            memcpy(redis_error_, str, redis_error_len_);
+            return;
+        }
+        // After a tombstone or EOF nothing else in this stream key is consumed; a full buffer likewise ends the reply.
+        if (has_next_stream_key_ || is_eof_) {
+            return;
+        }
+
+        if (depth == entry_depth_ + 1) {
+            if (idx == 0) {
+                in_entry_ = num_samples_ < max_samples_;
+                field_ = FIELD_NONE;
+                if (in_entry_ && !ParseStreamId(str, len, &entry_left_, &entry_right_)) {
+                    error_ = "Malformed entry ID";
+                }
+            }
+            return;
+        }
+        if (depth != entry_depth_ + 2 || !in_entry_) {
+            return;
+        }
+
+        if (idx % 2 == 0) {
+            // Field name.
+            if (Equals(str, len, "i", 1)) {
+                field_ = FIELD_SAMPLE_INDEX;
+            } else if (Equals(str, len, "val", 3)) {
+                field_ = FIELD_VALUE;
+            } else if (Equals(str, len, "next_stream_key", 15)) {
+                field_ = FIELD_NEXT_STREAM_KEY;
+            } else if (Equals(str, len, "eof", 3)) {
+                is_eof_ = true;
+                ConsumeEntry();
+                field_ = FIELD_OTHER;
+            } else {
+                field_ = FIELD_OTHER;
+            }
+            return;
+        }
+
+        // Field value.
+        switch (field_) {
+            case FIELD_SAMPLE_INDEX:
+                if (!ParseInt64(str, len, &entry_sample_index_)) {
+                    error_ = "Malformed sample index";
+                }
+                break;
+            case FIELD_VALUE:
+                if (variable_width_ ? len > static_cast<size_t>(sample_size_)
+                                    : len != static_cast<size_t>(sample_size_)) {
+                    error_ = "Sample payload does not match the schema";
+                    error_length_ = static_cast<int64_t>(len);
+                    break;
+                }
+                memcpy(buffer_ + num_bytes_, str, len);
+                if (sizes_ != nullptr) {
+                    sizes_[num_samples_] = static_cast<int>(len);
+                }
+                if (id_ms_ != nullptr) {
+                    id_ms_[num_samples_] = entry_left_;
+                }
+                num_bytes_ += variable_width_ ? static_cast<int64_t>(len) : sample_size_;
+                num_samples_++;
+                last_sample_index_ = entry_sample_index_;
+                ConsumeEntry();
+                break;
+            case FIELD_NEXT_STREAM_KEY:
+                if (len >= sizeof(next_stream_key_)) {
+                    error_ = "Next stream key is too long";
+                    error_length_ = static_cast<int64_t>(len);
+                    break;
+                }
+                memcpy(next_stream_key_, str, len);
+                next_stream_key_[len] = '\0';
+                next_stream_key_len_ = len;
+                has_next_stream_key_ = true;
+                ConsumeEntry();
+                break;
+            default:
+                break;
+        }
+        field_ = FIELD_NONE;
+    }
+
+    /**
+     * Throws the error (if any) found while decoding as a StreamReaderException.
+     */
+    void ThrowIfError(const std::string &stream_name) const {
+        if (error_ == nullptr) {
+            return;
+        }
+        std::stringstream ss;
+        ss << error_;
+        if (redis_error_len_ > 0) {
+            ss << ": " << std::string(redis_error_, redis_error_len_);
+        }
+        if (error_length_ > 0) {
+            ss << " (got " << error_length_ << " bytes, sample size is " << sample_size_ << ")";
+        }
+        ss << " (stream " << stream_name << ")";
+        throw StreamReaderException(ss.str());
+    }
+
+private:
+    static bool Equals(const char *str, size_t len, const char *literal, size_t literal_len) {
+        return len == literal_len && memcmp(str, literal, len) == 0;
+    }
+
+    enum Field {
+        FIELD_NONE,
+        FIELD_SAMPLE_INDEX,
+        FIELD_VALUE,
+        FIELD_NEXT_STREAM_KEY,
+        FIELD_OTHER,
+    };
+
+    void ConsumeEntry() {
+        in_entry_ = false;
+        has_last_id_ = true;
+        last_left_ = entry_left_;
+        last_right_ = entry_right_;
+        num_entries_++;
+    }
+
+    static void *CreateString(const redisReadTask *task, char *str, size_t len) {
+        auto *self = static_cast<EntryDecoder *>(task->privdata);
+        self->OnString(task->type, Depth(task), task->idx, str, len);
+        return self;
+    }
+
+    static void *CreateArray(const redisReadTask *task, size_t) {
+        return task->privdata;
+    }
+
+    static void *CreateInteger(const redisReadTask *task, long long) {
+        return task->privdata;
+    }
+
+    static void *CreateDouble(const redisReadTask *task, double, char *, size_t) {
+        return task->privdata;
+    }
+
+    static void *CreateNil(const redisReadTask *task) {
+        return task->privdata;
+    }
+
+    static void *CreateBool(const redisReadTask *task, int) {
+        return task->privdata;
+    }
+
+    static void FreeObject(void *) {}
+
+    int entry_depth_ = kXreadEntryDepth;
+    char *buffer_ = nullptr;
+    int64_t max_samples_ = 0;
+    int sample_size_ = 0;
+    bool variable_width_ = false;
+    int *sizes_ = nullptr;
+    uint64_t *id_ms_ = nullptr;
+
+    int64_t num_samples_ = 0;
+    int64_t num_bytes_ = 0;
+    int64_t num_entries_ = 0;
+
+    bool in_entry_ = false;
+    Field field_ = FIELD_NONE;
+    uint64_t entry_left_ = 0;
+    uint64_t entry_right_ = 0;
+    int64_t entry_sample_index_ = -1;
+
+    bool has_last_id_ = false;
+    uint64_t last_left_ = 0;
+    uint64_t last_right_ = 0;
+    int64_t last_sample_index_ = -1;
+
+    char next_stream_key_[kMaxStreamKeyLength] = {};
+    size_t next_stream_key_len_ = 0;
+    bool has_next_stream_key_ = false;
+    bool is_eof_ = false;
+
+    const char *error_ = nullptr;
+    int64_t error_length_ = 0;
+    char redis_error_[128] = {};
+    size_t redis_error_len_ = 0;
+};
+
+/**
+ * Fetches a stream's metadata, waiting up to `timeout_ms` for the stream to be created as in StreamReader::Initialize.
+ * Throws StreamDoesNotExistException if it does not appear in time.
+ */
+inline std::unique_ptr<std::unordered_map<std::string, std::string>> FetchStreamMetadata(
+        Redis *redis, const std::string &stream_name, int timeout_ms) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeout_ms, 0));
+    while (true) {
+        auto metadata = redis->GetMetadata(stream_name);
+        if (metadata != nullptr && metadata->count("first_stream_key") > 0 && metadata->count("schema") > 0) {
+            return metadata;
+        }
+        if (timeout_ms <= 0 || std::chrono::steady_clock::now() >= deadline) {
+            throw StreamDoesNotExistException("Stream " + stream_name + " does not exist.");
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+/**
+ * A minimal reader for a single stream that follows it across stream keys with its own connection, decoding XREAD
+ * replies with EntryDecoder. It offers a subset of StreamReader (no keys, listeners or tailing), but once the
+ * connection's read buffer has grown to its working size, #ReadBytes() performs no heap allocations at all.
+ */
+class StreamCursor {
+public:
+    explicit StreamCursor(const RedisConnection &connection, int max_fetch_size = 10000)
+            : connection_(connection), max_fetch_size_(std::max(max_fetch_size, 1)) {}
+
+    /**
+     * Looks up the stream's metadata, waiting up to `timeout_ms` for it to be created as in StreamReader::Initialize.
+     */
+    void Initialize(const std::string &stream_name, int timeout_ms = -1) {
+        redis_ = Redis::Create(connection_);
+        stream_name_ = stream_name;
+        auto metadata = FetchStreamMetadata(redis_.get(), stream_name, timeout_ms);
+
+        schema_ = std::make_unique<StreamSchema>(StreamSchema::FromJson(metadata->at("schema")));
+        sample_size_ = schema_->sample_size();
+        has_variable_width_field_ = schema_->has_variable_width_field();
+        const std::string &first_stream_key = metadata->at("first_stream_key");
+        SetStreamKey(first_stream_key.data(), first_stream_key.size());
+        is_initialized_ = true;
+    }
+
+    /**
+     * Same semantics as StreamReader::ReadBytes, without the `keys` output.
+     *
+     * @param id_ms If not null, receives the server time in milliseconds (from the entry ID) of each sample read.
+     */
+    int64_t ReadBytes(char *buffer,
+                      int64_t num_samples,
+                      int *sizes = nullptr,
+                      int timeout_ms = -1,
+                      uint64_t *id_ms = nullptr) {
+        if (!is_initialized_) {
+            throw StreamReaderException("Stream cursor was not initialized.");
+        }
+        if (is_eof_) {
+            return -1;
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeout_ms, 0));
+        int64_t num_read = 0;
+        int64_t num_bytes = 0;
+        while (num_read < num_samples) {
+            int block_ms = 0;
+            if (timeout_ms > 0) {
+                auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        deadline - std::chrono::steady_clock::now()).count();
+                if (remaining <= 0) {
+                    break;
+                }
+                block_ms = static_cast<int>(remaining);
+            }
+
+            int64_t count = std::min<int64_t>(num_samples - num_read, max_fetch_size_);
+            redis_->SendRaw(command_, FormatXread(count, block_ms));
+            decoder_.Reset(EntryDecoder::kXreadEntryDepth,
+                           buffer + num_bytes,
+                           num_samples - num_read,
+                           sample_size_,
+                           has_variable_width_field_,
+                           sizes == nullptr ? nullptr : sizes + num_read,
+                           id_ms == nullptr ? nullptr : id_ms + num_read);
+            redis_->DecodeReply(EntryDecoder::Functions(), &decoder_);
+            Advance();
+
+            num_read += decoder_.num_samples();
+            num_bytes += decoder_.num_bytes();
+            if (is_eof_) {
+                break;
+            }
+        }
+
+        num_samples_read_ += num_read;
+        if (num_read == 0 && is_eof_) {
+            return -1;
+        }
+        return num_read;
+    }
+
+    /**
+     * Like #ReadBytes(), but issues a single XREAD and returns as soon as any samples are available instead of waiting
+     * to fill the buffer, for consumers that care about the latency of each sample more than batching.
+     *
+     * @param timeout_ms If positive, how long to wait for a sample; otherwise waits indefinitely.
+     * @return the number of samples read (0 on timeout, or if the read only crossed into the next key), or -1 on EOF.
+     */
+    int64_t ReadAvailable(char *buffer, int64_t num_samples, int *sizes = nullptr, int timeout_ms = -1) {
+        BeginRead(buffer, num_samples, sizes, std::max(timeout_ms, 0));
+        if (is_eof_) {
+            return -1;
+        }
+        redis_->DecodeReply(EntryDecoder::Functions(), &decoder_);
+        Advance();
+        int64_t num_read = decoder_.num_samples();
+        num_samples_read_ += num_read;
+        if (num_read == 0 && is_eof_) {
+            return -1;
+        }
+        return num_read;
+    }
+
+    /**
+     * Sends an XREAD for up to `num_samples` samples (at most max_fetch_size) without waiting for the reply, which
+     * #ReceiveRead() later decodes into `buffer` and `sizes`. For event loops that wait on #socket() themselves; no
+     * other read may be made on this cursor until the reply has been received.
+     *
+     * @param block_ms How long the server holds the read open waiting for samples; 0 waits indefinitely.
+     */
+    void BeginRead(char *buffer, int64_t num_samples, int *sizes = nullptr, int block_ms = 0) {
+        if (!is_initialized_) {
+            throw StreamReaderException("Stream cursor was not initialized.");
+        }
+        if (is_eof_) {
+            return;
+        }
+        int64_t count = std::min<int64_t>(num_samples, max_fetch_size_);
+        redis_->SendRaw(command_, FormatXread(count, block_ms));
+        decoder_.Reset(EntryDecoder::kXreadEntryDepth, buffer, count, sample_size_, has_variable_width_field_, sizes);
+    }
+
+    /**
+     * Decodes as much of the reply to #BeginRead() as has arrived; call when #socket() is readable. Returns false
+     * while the reply is incomplete. Once it is complete, returns true and sets `num_read` to the number of samples
+     * decoded (0 if the read only crossed into a new key or timed out), or -1 on EOF.
+     */
+    bool ReceiveRead(int64_t *num_read) {
+        if (is_eof_) {
+            *num_read = -1;
+            return true;
+        }
+        if (!redis_->TryDecodeReply(EntryDecoder::Functions(), &decoder_)) {
+            return false;
+        }
+        Advance();
+        *num_read = decoder_.num_samples();
+        num_samples_read_ += *num_read;
+        if (*num_read == 0 && is_eof_) {
+            *num_read = -1;
+        }
+        return true;
+    }
+
+    /**
+     * The socket of this cursor's connection.
+     */
+    redisFD socket() const {
+        return redis_->fd();
+    }
+
+    /**
+     * Moves the cursor so that the next read starts after entry `left`-`right` of the given redis key.
+     */
+    void Reposition(const std::string &stream_key, uint64_t left, uint64_t right) {
+        SetStreamKey(stream_key.data(), stream_key.size());
+        cursor_left_ = left;
+        cursor_right_ = right;
+    }
+
+    bool Good() const {
+        return is_initialized_ && !is_eof_;
+    }
+
+    const StreamSchema &schema() const {
+        return *schema_;
+    }
+
+    const std::string &stream_name() const {
+        return stream_name_;
+    }
+
+    int64_t total_samples_read() const {
+        return num_samples_read_;
+    }
+
+private:
+    /**
+     * Moves past the reply just decoded: advances the cursor, follows a tombstone and notes EOF.
+     */
+    void Advance() {
+        decoder_.ThrowIfError(stream_name_);
+        if (decoder_.has_last_id()) {
+            cursor_left_ = decoder_.last_left();
+            cursor_right_ = decoder_.last_right();
+        }
+        if (decoder_.has_next_stream_key()) {
+            SetStreamKey(decoder_.next_stream_key(), decoder_.next_stream_key_length());
+        }
+        if (decoder_.is_eof()) {
+            is_eof_ = true;
+        }
+    }
+
+    void SetStreamKey(const char *key, size_t len) {
+        if (len >= sizeof(stream_key_)) {
+            throw StreamReaderException("Stream key is too long: " + std::string(key, len));
+        }
+        memcpy(stream_key_, key, len);
+        stream_key_len_ = len;
+        cursor_left_ = 0;
+        cursor_right_ = 0;
+    }
+
+    /**
+     * Encodes XREAD COUNT <count> BLOCK <block_ms> STREAMS <key> <cursor> into the command buffer. XREAD is exclusive
+     * of the given ID, so the cursor is simply the last consumed ID.
+     */
+    size_t FormatXread(int64_t count, int block_ms) {
+        char number[48];
+        char *out = command_;
+        memcpy(out, "*8\r\n$5\r\nXREAD\r\n$5\r\nCOUNT\r\n", 26);
+        out = AppendBulk(out + 26, number, FormatInt64(count, number));
+        memcpy(out, "$5\r\nBLOCK\r\n", 11);
+        out = AppendBulk(out + 11, number, FormatInt64(block_ms, number));
+        memcpy(out, "$7\r\nSTREAMS\r\n", 13);
+        out = AppendBulk(out + 13, stream_key_, stream_key_len_);
+
+        size_t id_len = FormatInt64(static_cast<int64_t>(cursor_left_), number);
+        number[id_len++] = '-';
+        id_len += FormatInt64(static_cast<int64_t>(cursor_right_), number + id_len);
+        out = AppendBulk(out, number, id_len);
+        return static_cast<size_t>(out - command_);
+    }
+
+    const RedisConnection connection_;
+    const int max_fetch_size_;
+    std::unique_ptr<Redis> redis_;
+
+    std::string stream_name_;
+    std::unique_ptr<StreamSchema> schema_;
+    int sample_size_ = 0;
+    bool has_variable_width_field_ = false;
+    bool is_initialized_ = false;
+    bool is_eof_ = false;
+    int64_t num_samples_read_ = 0;
+
+    char stream_key_[EntryDecoder::kMaxStreamKeyLength] = {};
+    size_t stream_key_len_ = 0;
+    uint64_t cursor_left_ = 0;
+    uint64_t cursor_right_ = 0;
+
+    char command_[EntryDecoder::kMaxStreamKeyLength + 192] = {};
+    EntryDecoder decoder_;
+};
+
+}
+}
+
+#endif //PARENT_DECODER_H
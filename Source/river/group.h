@@ -0,0 +1,338 @@
+#ifndef PARENT_GROUP_H
+#define PARENT_GROUP_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "schema.h"
+#include "reader.h"
+#include "decoder.h"
+#include "redis.h"
+
+namespace river {
+
+/**
+ * Reads a stream as one member of a redis consumer group, so that several processes can share the samples of one
+ * stream: each sample is delivered to exactly one consumer of the group, with at-least-once semantics. Delivered
+ * samples stay pending until #Acknowledge() is called; if a consumer dies before acknowledging, its samples are
+ * redelivered to it when it restarts under the same consumer name, and any other consumer can take them over with
+ * #ClaimStale().
+ *
+ * Each redis key of the stream gets its own group (created on first use, starting at the beginning of the key).
+ * Tombstones and EOF are delivered to one consumer only, so every consumer also checks the end of its current key
+ * whenever nothing new is delivered, and moves on once the key is tombstoned and fully delivered.
+ */
+class ConsumerGroupReader {
+public:
+    /**
+     * @param connection: parameters to connect to Redis
+     * @param max_fetch_size: maximum number of samples to fetch per XREADGROUP.
+     */
+    explicit ConsumerGroupReader(const RedisConnection &connection, int max_fetch_size = 10000)
+            : connection_(connection), max_fetch_size_(std::max(max_fetch_size, 1)) {}
+
+    /**
+     * Joins `group_name` as `consumer_name` on an existing stream, waiting up to `timeout_ms` for the stream to be
+     * created as in StreamReader::Initialize. Consumer names must be unique within the group; reusing the name of a
+     * consumer that died recovers its unacknowledged samples first.
+     */
+    void Initialize(const std::string &stream_name,
+                    const std::string &group_name,
+                    const std::string &consumer_name,
+                    int timeout_ms = -1) {
+        redis_ = internal::Redis::Create(connection_);
+        stream_name_ = stream_name;
+        group_name_ = group_name;
+        consumer_name_ = consumer_name;
+
+        auto metadata = internal::FetchStreamMetadata(redis_.get(), stream_name, timeout_ms);
+        schema_ = std::make_unique<StreamSchema>(StreamSchema::FromJson(metadata->at("schema")));
+        sample_size_ = schema_->sample_size();
+        has_variable_width_field_ = schema_->has_variable_width_field();
+
+        keys_.clear();
+        EnterKey(metadata->at("first_stream_key"));
+        is_initialized_ = true;
+    }
+
+    /**
+     * Reads up to `num_samples` samples delivered to this consumer. Unlike StreamReader::ReadBytes, this returns as
+     * soon as any samples are delivered, since other consumers share the stream; it blocks only while none are
+     * available, for up to `timeout_ms` if positive. Returns -1 once the stream has reached EOF and every sample has
+     * been delivered.
+     *
+     * The returned samples are pending in the group until #Acknowledge() is called.
+     */
+    int64_t ReadBytes(char *buffer, int64_t num_samples, int *sizes = nullptr, int timeout_ms = -1) {
+        CheckInitialized();
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeout_ms, 0));
+        while (!is_eof_) {
+            int block_ms = kPollMs;
+            if (timeout_ms > 0) {
+                auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        deadline - std::chrono::steady_clock::now()).count();
+                if (remaining <= 0) {
+                    return 0;
+                }
+                block_ms = static_cast<int>(std::min<int64_t>(remaining, kPollMs));
+            }
+
+            // While recovering, ID 0 returns the entries already delivered to this consumer but never acknowledged.
+            std::string count = std::to_string(std::min<int64_t>(num_samples, max_fetch_size_));
+            std::string block = std::to_string(block_ms);
+            std::string key = keys_.back();
+            const char *id = is_recovering_ ? recovery_id_.c_str() : ">";
+            const char *argv[] = {"XREADGROUP", "GROUP", group_name_.c_str(), consumer_name_.c_str(),
+                                  "COUNT", count.c_str(), "BLOCK", block.c_str(), "STREAMS", key.c_str(), id};
+            auto reply = Command(11, argv);
+
+            int64_t num_entries = 0;
+            int64_t num_read = 0;
+            if (reply->type == REDIS_REPLY_ARRAY && reply->elements > 0) {
+                const redisReply *entries = reply->element[0]->element[1];
+                num_entries = static_cast<int64_t>(entries->elements);
+                if (is_recovering_ && num_entries > 0) {
+                    recovery_id_ = entries->element[num_entries - 1]->element[0]->str;
+                }
+                num_read = TakeEntries(key, entries, buffer, num_samples, sizes);
+            }
+            if (num_read > 0) {
+                return num_read;
+            }
+
+            if (num_entries == 0) {
+                if (is_recovering_) {
+                    is_recovering_ = false;
+                    continue;
+                }
+                AdvanceIfExhausted();
+            }
+        }
+        return -1;
+    }
+
+    /**
+     * Takes over samples that were delivered to other consumers of the group but have not been acknowledged for at
+     * least `min_idle_ms`, e.g. because their consumer died. They are read into `buffer` like #ReadBytes() and are then
+     * pending for this consumer.
+     */
+    int64_t ClaimStale(int64_t min_idle_ms, char *buffer, int64_t num_samples, int *sizes = nullptr) {
+        CheckInitialized();
+        int64_t num_read = 0;
+        int64_t num_bytes = 0;
+        std::string count = std::to_string(std::min<int64_t>(num_samples, max_fetch_size_));
+        std::string min_idle = std::to_string(min_idle_ms);
+        // Claiming a tombstone can append to keys_, so iterate over a copy.
+        std::vector<std::string> keys = keys_;
+        for (const auto &key : keys) {
+            if (num_read >= num_samples) {
+                break;
+            }
+            const char *pending_argv[] = {"XPENDING", key.c_str(), group_name_.c_str(), "-", "+", count.c_str()};
+            auto pending = Command(6, pending_argv);
+            if (pending->type != REDIS_REPLY_ARRAY || pending->elements == 0) {
+                continue;
+            }
+
+            // XCLAIM <key> <group> <consumer> <min-idle-time> <id>...
+            std::vector<const char *> argv = {"XCLAIM", key.c_str(), group_name_.c_str(), consumer_name_.c_str(),
+                                              min_idle.c_str()};
+            for (size_t i = 0; i < pending->elements && num_read + static_cast<int64_t>(argv.size() - 5) < num_samples;
+                 i++) {
+                const redisReply *entry = pending->element[i];
+                if (consumer_name_ != entry->element[1]->str) {
+                    argv.push_back(entry->element[0]->str);
+                }
+            }
+            if (argv.size() == 5) {
+                continue;
+            }
+            auto claimed = Command(static_cast<int>(argv.size()), argv.data());
+            if (claimed->type == REDIS_REPLY_ARRAY) {
+                int64_t n = TakeEntries(key, claimed.get(), buffer + num_bytes, num_samples - num_read,
+                                        sizes == nullptr ? nullptr : sizes + num_read);
+                num_bytes += last_num_bytes_;
+                num_read += n;
+            }
+        }
+        return num_read;
+    }
+
+    /**
+     * Acknowledges every sample delivered to this consumer so far, removing them from the group's pending entries.
+     */
+    void Acknowledge() {
+        size_t begin = 0;
+        while (begin < unacknowledged_.size()) {
+            const std::string &key = unacknowledged_[begin].first;
+            std::vector<const char *> argv = {"XACK", key.c_str(), group_name_.c_str()};
+            size_t end = begin;
+            while (end < unacknowledged_.size() && unacknowledged_[end].first == key) {
+                argv.push_back(unacknowledged_[end].second.c_str());
+                end++;
+            }
+            Command(static_cast<int>(argv.size()), argv.data());
+            begin = end;
+        }
+        unacknowledged_.clear();
+    }
+
+    /**
+     * Number of samples delivered to this consumer and not yet acknowledged.
+     */
+    int64_t num_unacknowledged() const {
+        return static_cast<int64_t>(unacknowledged_.size());
+    }
+
+    bool Good() const {
+        return is_initialized_ && !is_eof_;
+    }
+
+    const StreamSchema &schema() const {
+        return *schema_;
+    }
+
+    const std::string &stream_name() const {
+        return stream_name_;
+    }
+
+private:
+    // How long a single XREADGROUP blocks before the current key is checked for a tombstone.
+    static constexpr int kPollMs = 100;
+
+    void CheckInitialized() const {
+        if (!is_initialized_) {
+            throw StreamReaderException("Consumer group reader was not initialized.");
+        }
+    }
+
+    internal::Redis::UniqueRedisReplyPtr Command(int argc, const char **argv) {
+        redis_->SendCommandArgv(argc, argv, nullptr);
+        auto reply = redis_->GetReply();
+        if (reply->type == REDIS_REPLY_ERROR && strncmp(reply->str, "BUSYGROUP", 9) != 0) {
+            std::stringstream ss;
+            ss << "Error from redis on " << argv[0] << ": " << reply->str << " (stream " << stream_name_ << ")";
+            throw StreamReaderException(ss.str());
+        }
+        return reply;
+    }
+
+    /**
+     * Starts reading `key`, creating the group on it if no consumer has yet.
+     */
+    void EnterKey(const std::string &key) {
+        if (std::find(keys_.begin(), keys_.end(), key) != keys_.end()) {
+            return;
+        }
+        const char *argv[] = {"XGROUP", "CREATE", key.c_str(), group_name_.c_str(), "0", "MKSTREAM"};
+        Command(6, argv);
+        keys_.push_back(key);
+        is_recovering_ = true;
+        recovery_id_ = "0";
+    }
+
+    /**
+     * Moves to the next key if the current one ends in a tombstone (every entry having been delivered), or marks EOF.
+     */
+    void AdvanceIfExhausted() {
+        const std::string &key = keys_.back();
+        const char *argv[] = {"XREVRANGE", key.c_str(), "+", "-", "COUNT", "1"};
+        auto last = Command(6, argv);
+        if (last->type != REDIS_REPLY_ARRAY || last->elements == 0) {
+            return;
+        }
+        const redisReply *fields = last->element[0]->element[1];
+        if (internal::FindReplyField(fields, "eof") != nullptr) {
+            is_eof_ = true;
+        } else if (const char *next_stream_key = internal::FindReplyField(fields, "next_stream_key")) {
+            EnterKey(next_stream_key);
+        }
+    }
+
+    /**
+     * Copies the data entries of an XREADGROUP/XCLAIM entries array into `buffer`, recording them as unacknowledged.
+     * Tombstone and EOF entries are acknowledged immediately and update the position.
+     */
+    int64_t TakeEntries(const std::string &key, const redisReply *entries, char *buffer, int64_t max_samples,
+                        int *sizes) {
+        int64_t num_read = 0;
+        int64_t num_bytes = 0;
+        std::string next_key;
+        std::vector<const char *> ack_argv = {"XACK", key.c_str(), group_name_.c_str()};
+        for (size_t i = 0; i < entries->elements && num_read < max_samples; i++) {
+            const redisReply *entry = entries->element[i];
+            const char *id = entry->element[0]->str;
+            const redisReply *fields = entry->element[1];
+            if (fields->type != REDIS_REPLY_ARRAY) {
+                // Delivered but since trimmed from the stream; nothing left to process.
+                ack_argv.push_back(id);
+                continue;
+            }
+
+            int len = 0;
+            const char *val = internal::FindReplyField(fields, "val", &len);
+            if (val != nullptr) {
+                if (has_variable_width_field_ ? len > sample_size_ : len != sample_size_) {
+                    std::stringstream ss;
+                    ss << "Sample payload of " << len << " bytes does not match sample size " << sample_size_
+                       << " (stream " << stream_name_ << ")";
+                    throw StreamReaderException(ss.str());
+                }
+                memcpy(buffer + num_bytes, val, len);
+                if (sizes != nullptr) {
+                    sizes[num_read] = len;
+                }
+                num_bytes += has_variable_width_field_ ? len : sample_size_;
+                num_read++;
+                unacknowledged_.emplace_back(key, id);
+                continue;
+            }
+
+            ack_argv.push_back(id);
+            if (internal::FindReplyField(fields, "eof") != nullptr) {
+                is_eof_ = true;
+            } else if (const char *next_stream_key = internal::FindReplyField(fields, "next_stream_key")) {
+                next_key = next_stream_key;
+            }
+        }
+        if (ack_argv.size() > 3) {
+            Command(static_cast<int>(ack_argv.size()), ack_argv.data());
+        }
+        if (!next_key.empty()) {
+            EnterKey(next_key);
+        }
+        last_num_bytes_ = num_bytes;
+        return num_read;
+    }
+
+    const RedisConnection connection_;
+    const int max_fetch_size_;
+    std::unique_ptr<internal::Redis> redis_;
+
+    std::string stream_name_;
+    std::string group_name_;
+    std::string consumer_name_;
+    std::unique_ptr<StreamSchema> schema_;
+    int sample_size_ = 0;
+    bool has_variable_width_field_ = false;
+    bool is_initialized_ = false;
+    bool is_eof_ = false;
+    bool is_recovering_ = true;
+    // Pending entries of this consumer are re-read from after this ID while recovering.
+    std::string recovery_id_ = "0";
+
+    // Every key this consumer has read from, oldest first; the last is the current one.
+    std::vector<std::string> keys_;
+    std::vector<std::pair<std::string, std::string>> unacknowledged_;
+    int64_t last_num_bytes_ = 0;
+};
+
+}
+
+#endif //PARENT_GROUP_H
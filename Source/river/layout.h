@@ -0,0 +1,192 @@
+#ifndef PARENT_LAYOUT_H
+#define PARENT_LAYOUT_H
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "schema.h"
+
+namespace river {
+
+/**
+ * Where a single field lives within a serialized sample.
+ */
+typedef struct FieldLayout {
+    std::string name;
+    FieldDefinition::Type type;
+
+    // Byte offset of this field from the start of the sample, or StreamLayout::kDynamicOffset if the field follows a
+    // variable-width field and so its position differs per sample.
+    int offset;
+
+    // Size in bytes of this field. For VARIABLE_WIDTH_BYTES fields this is the maximum size.
+    int size;
+
+    // Natural alignment of the field's type, e.g. 8 for INT64 and 1 for byte fields.
+    int alignment;
+} FieldLayout;
+
+/**
+ * An immutable, precomputed view of a StreamSchema: per-field offsets, sizes and alignment, the total sample size,
+ * and a hash lookup from field name to index. StreamSchema recomputes these on every call; build a StreamLayout once
+ * (e.g. after initializing a reader or writer) and keep it for the lifetime of the stream.
+ *
+ * The layout also offers column extraction, i.e. copying a single field out of a batch of samples into a dense array,
+ * without consulting the schema per sample.
+ */
+class StreamLayout {
+public:
+    static constexpr int kDynamicOffset = -1;
+
+    explicit StreamLayout(const StreamSchema &schema) {
+        fields_.reserve(schema.field_definitions.size());
+        int offset = 0;
+        for (const auto &field : schema.field_definitions) {
+            int alignment = NaturalAlignment(field);
+            int field_offset = has_variable_width_field_ ? kDynamicOffset : offset;
+            fields_.push_back(FieldLayout{field.name, field.type, field_offset, field.size, alignment});
+            index_by_name_.emplace(field.name, static_cast<int>(fields_.size()) - 1);
+
+            offset += field.size;
+            if (alignment > alignment_) {
+                alignment_ = alignment;
+            }
+            if (field.type == FieldDefinition::VARIABLE_WIDTH_BYTES) {
+                has_variable_width_field_ = true;
+                num_variable_width_fields_++;
+            } else {
+                fixed_width_size_ += field.size;
+            }
+        }
+        sample_size_ = offset;
+    }
+
+    /**
+     * Total size in bytes of one sample; equivalent to StreamSchema::sample_size().
+     */
+    int sample_size() const {
+        return sample_size_;
+    }
+
+    /**
+     * Equivalent to StreamSchema::has_variable_width_field().
+     */
+    bool has_variable_width_field() const {
+        return has_variable_width_field_;
+    }
+
+    /**
+     * Number of VARIABLE_WIDTH_BYTES fields in the sample.
+     */
+    int num_variable_width_fields() const {
+        return num_variable_width_fields_;
+    }
+
+    /**
+     * Total size in bytes of all fixed-width fields in the sample.
+     */
+    int fixed_width_size() const {
+        return fixed_width_size_;
+    }
+
+    /**
+     * The largest natural alignment of any field in the sample.
+     */
+    int alignment() const {
+        return alignment_;
+    }
+
+    int num_fields() const {
+        return static_cast<int>(fields_.size());
+    }
+
+    const FieldLayout &field(int index) const {
+        return fields_[index];
+    }
+
+    const std::vector<FieldLayout> &fields() const {
+        return fields_;
+    }
+
+    /**
+     * Index of the field with the given name, or -1 if there is no such field.
+     */
+    int IndexOf(const std::string &name) const {
+        auto it = index_by_name_.find(name);
+        return it == index_by_name_.end() ? -1 : it->second;
+    }
+
+    /**
+     * Reads a single fixed-width field of type T from the given sample. Throws std::logic_error for fields after a
+     * variable-width field, whose offset differs per sample.
+     */
+    template<class T>
+    T Get(const char *sample, int field_index) const {
+        const FieldLayout &field = fields_[field_index];
+        if (field.offset == kDynamicOffset) {
+            throw std::logic_error("Field " + field.name + " follows a variable-width field and has no fixed offset.");
+        }
+        T value;
+        memcpy(&value, sample + field.offset, sizeof(T));
+        return value;
+    }
+
+    /**
+     * Copies field `field_index` of `num_samples` contiguous samples into `column`, which must hold
+     * `num_samples * field(field_index).size` bytes. Only valid for schemas without variable-width fields.
+     */
+    void ExtractColumn(const char *samples, int64_t num_samples, int field_index, char *column) const {
+        const FieldLayout &f = fields_[field_index];
+        const char *src = samples + f.offset;
+        switch (f.size) {
+            case 4:
+                CopyStrided<4>(src, num_samples, column);
+                break;
+            case 8:
+                CopyStrided<8>(src, num_samples, column);
+                break;
+            default:
+                for (int64_t i = 0; i < num_samples; i++) {
+                    memcpy(column + i * f.size, src + i * sample_size_, f.size);
+                }
+                break;
+        }
+    }
+
+private:
+    template<int N>
+    void CopyStrided(const char *src, int64_t num_samples, char *dst) const {
+        for (int64_t i = 0; i < num_samples; i++) {
+            memcpy(dst + i * N, src + i * sample_size_, N);
+        }
+    }
+
+    static int NaturalAlignment(const FieldDefinition &field) {
+        switch (field.type) {
+            case FieldDefinition::DOUBLE:
+            case FieldDefinition::INT64:
+                return 8;
+            case FieldDefinition::FLOAT:
+            case FieldDefinition::INT32:
+                return 4;
+            default:
+                return 1;
+        }
+    }
+
+    std::vector<FieldLayout> fields_;
+    std::unordered_map<std::string, int> index_by_name_;
+    int sample_size_ = 0;
+    int fixed_width_size_ = 0;
+    int num_variable_width_fields_ = 0;
+    int alignment_ = 1;
+    bool has_variable_width_field_ = false;
+};
+
+}
+
+#endif //PARENT_LAYOUT_H
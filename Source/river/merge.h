@@ -0,0 +1,448 @@
+#ifndef PARENT_MERGE_H
+#define PARENT_MERGE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "schema.h"
+#include "layout.h"
+#include "reader.h"
+#include "decoder.h"
+#include "redis.h"
+
+namespace river {
+
+/**
+ * Reads several existing streams at once and merges them into a single sequence ordered by an INT64 field that every
+ * stream shares, e.g. `sample_number` for spikes and TTL events written by different RiverOutput instances. All
+ * streams are fetched with a single XREAD per round trip.
+ *
+ * Each stream is assumed to be ordered by the merge field on its own. A sample is released once every stream that has
+ * not reached EOF has a later-or-equal sample buffered, or once some stream has moved more than `reorder_window` past
+ * it. The window bounds how long a slow or idle stream can hold back the others; a sample from such a stream that
+ * arrives after the merged output has moved past it is still returned (out of order) and counted in
+ * #num_late_samples().
+ *
+ * Each stream stages at most `2 * max_fetch_size` samples. Once a stream's staging has no room for another full fetch
+ * it is not fetched again, so rather than block on the others, its head is released regardless of the window until
+ * there is room again. A fast stream therefore runs ahead of an idle one by at most about one staging buffer, and
+ * whatever the idle stream later delivers behind that point is counted as late.
+ *
+ * Only streams without variable-width fields are supported.
+ */
+class MultiStreamReader {
+public:
+    /**
+     * @param connection: parameters to connect to Redis
+     * @param max_fetch_size: maximum number of samples to fetch per stream in one XREAD.
+     */
+    explicit MultiStreamReader(const RedisConnection &connection, int max_fetch_size = 10000)
+            : connection_(connection), max_fetch_size_(std::max(max_fetch_size, 1)) {}
+
+    /**
+     * Initializes this reader to the given streams, waiting up to `timeout_ms` for each to be created as in
+     * StreamReader::Initialize.
+     *
+     * @param merge_field Name of the INT64 field, present in every stream's schema, by which samples are ordered.
+     * @param reorder_window How far (in units of the merge field) any stream may run ahead of a stream with no buffered
+     * samples before the latter is no longer waited for.
+     */
+    void Initialize(const std::vector<std::string> &stream_names,
+                    const std::string &merge_field,
+                    int64_t reorder_window,
+                    int timeout_ms = -1) {
+        if (stream_names.empty()) {
+            throw StreamReaderException("At least one stream must be given to merge.");
+        }
+        redis_ = internal::Redis::Create(connection_);
+        reorder_window_ = reorder_window;
+        sources_.clear();
+        max_sample_size_ = 0;
+
+        for (const auto &stream_name : stream_names) {
+            auto metadata = internal::FetchStreamMetadata(redis_.get(), stream_name, timeout_ms);
+            StreamSchema schema = StreamSchema::FromJson(metadata->at("schema"));
+            std::unique_ptr<Source> source(new Source(stream_name, schema));
+
+            if (source->layout.has_variable_width_field()) {
+                throw StreamReaderException(
+                        "Merging is not supported for streams with variable-width fields: " + stream_name);
+            }
+            int field_index = source->layout.IndexOf(merge_field);
+            if (field_index < 0 || source->layout.field(field_index).type != FieldDefinition::INT64) {
+                std::stringstream ss;
+                ss << "Stream " << stream_name << " has no INT64 field named " << merge_field;
+                throw StreamReaderException(ss.str());
+            }
+            source->merge_offset = source->layout.field(field_index).offset;
+            source->sample_size = source->layout.sample_size();
+            source->staging.resize(static_cast<size_t>(2 * max_fetch_size_) * source->sample_size);
+            source->SetStreamKey(metadata->at("first_stream_key"));
+
+            max_sample_size_ = std::max(max_sample_size_, source->sample_size);
+            sources_.push_back(std::move(source));
+        }
+
+        command_.resize(sources_.size() * (internal::EntryDecoder::kMaxStreamKeyLength + 64) + 128);
+        is_initialized_ = true;
+    }
+
+    /**
+     * Reads up to `num_samples` merged samples. Blocking, timeout and EOF semantics match StreamReader::ReadBytes,
+     * where EOF means that every stream has reached EOF.
+     *
+     * @param buffer Receives sample i at `buffer + i * max_sample_size()`; must hold
+     * `num_samples * max_sample_size()` bytes.
+     * @param stream_indices If not null, entry i receives the index (into the names given to #Initialize()) of the
+     * stream that sample i came from.
+     */
+    int64_t ReadBytes(char *buffer, int64_t num_samples, int *stream_indices = nullptr, int timeout_ms = -1) {
+        if (!is_initialized_) {
+            throw StreamReaderException("Multi-stream reader was not initialized.");
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeout_ms, 0));
+        int64_t num_read = 0;
+        while (num_read < num_samples) {
+            int next = NextReleasable();
+            if (next >= 0) {
+                Source &source = *sources_[next];
+                memcpy(buffer + num_read * max_sample_size_, source.head(), source.sample_size);
+                if (stream_indices != nullptr) {
+                    stream_indices[num_read] = next;
+                }
+                int64_t value = source.merge_value(0);
+                if (value < last_released_value_) {
+                    num_late_samples_++;
+                }
+                last_released_value_ = std::max(last_released_value_, value);
+                source.Pop();
+                num_read++;
+                continue;
+            }
+            if (AllDrained()) {
+                break;
+            }
+
+            int block_ms = 0;
+            if (timeout_ms > 0) {
+                auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        deadline - std::chrono::steady_clock::now()).count();
+                if (remaining <= 0) {
+                    break;
+                }
+                block_ms = static_cast<int>(remaining);
+            }
+            Fetch(block_ms);
+        }
+
+        num_samples_read_ += num_read;
+        if (num_read == 0 && AllDrained()) {
+            return -1;
+        }
+        return num_read;
+    }
+
+    /**
+     * Whether more samples can be read, i.e. some stream has not reached EOF or still has buffered samples.
+     */
+    bool Good() const {
+        return is_initialized_ && !AllDrained();
+    }
+
+    int num_streams() const {
+        return static_cast<int>(sources_.size());
+    }
+
+    const StreamSchema &schema(int stream_index) const {
+        return sources_[stream_index]->schema;
+    }
+
+    const std::string &stream_name(int stream_index) const {
+        return sources_[stream_index]->name;
+    }
+
+    /**
+     * Stride, in bytes, between samples in the buffer given to #ReadBytes(): the largest sample size of any stream.
+     */
+    int max_sample_size() const {
+        return max_sample_size_;
+    }
+
+    int64_t total_samples_read() const {
+        return num_samples_read_;
+    }
+
+    /**
+     * Number of samples that arrived after the reorder window had already released a later sample.
+     */
+    int64_t num_late_samples() const {
+        return num_late_samples_;
+    }
+
+private:
+    struct Source {
+        Source(std::string stream_name, const StreamSchema &stream_schema)
+                : name(std::move(stream_name)), schema(stream_schema), layout(stream_schema) {}
+
+        const std::string name;
+        const StreamSchema schema;
+        const StreamLayout layout;
+        int merge_offset = 0;
+        int sample_size = 0;
+
+        char stream_key[internal::EntryDecoder::kMaxStreamKeyLength] = {};
+        size_t stream_key_len = 0;
+        uint64_t cursor_left = 0;
+        uint64_t cursor_right = 0;
+        bool is_eof = false;
+
+        // Fetched samples not yet released, at [head_idx, head_idx + count) in units of sample_size.
+        std::vector<char> staging;
+        int64_t head_idx = 0;
+        int64_t count = 0;
+
+        // Merge value of the latest sample fetched from this stream.
+        int64_t latest_value = std::numeric_limits<int64_t>::min();
+
+        internal::EntryDecoder decoder;
+
+        void SetStreamKey(const std::string &key) {
+            SetStreamKey(key.data(), key.size());
+        }
+
+        void SetStreamKey(const char *key, size_t len) {
+            if (len >= sizeof(stream_key)) {
+                throw StreamReaderException("Stream key is too long: " + std::string(key, len));
+            }
+            memcpy(stream_key, key, len);
+            stream_key_len = len;
+            cursor_left = 0;
+            cursor_right = 0;
+        }
+
+        const char *head() const {
+            return staging.data() + head_idx * sample_size;
+        }
+
+        int64_t merge_value(int64_t i) const {
+            int64_t value;
+            memcpy(&value, staging.data() + (head_idx + i) * sample_size + merge_offset, sizeof(value));
+            return value;
+        }
+
+        void Pop() {
+            head_idx++;
+            count--;
+            if (count == 0) {
+                head_idx = 0;
+            }
+        }
+
+        /**
+         * Whether the staging buffer lacks room for another fetch of `fetch_size` samples.
+         */
+        bool IsFull(int64_t fetch_size) const {
+            return static_cast<int64_t>(staging.size()) / sample_size - count < fetch_size;
+        }
+
+        /**
+         * Moves buffered samples to the front of the staging buffer and returns how many more fit.
+         */
+        int64_t Compact() {
+            if (head_idx > 0 && count > 0) {
+                memmove(staging.data(), head(), static_cast<size_t>(count) * sample_size);
+            }
+            head_idx = 0;
+            return static_cast<int64_t>(staging.size()) / sample_size - count;
+        }
+    };
+
+    /**
+     * Dispatches a multi-stream XREAD reply to the decoder of each stream, keyed by the stream key preceding its
+     * entries.
+     */
+    struct Dispatcher {
+        MultiStreamReader *reader;
+        Source *current = nullptr;
+        const char *error = nullptr;
+
+        static void *CreateString(const redisReadTask *task, char *str, size_t len) {
+            auto *self = static_cast<Dispatcher *>(task->privdata);
+            int depth = internal::EntryDecoder::Depth(task);
+            if (depth == 0 && task->type == REDIS_REPLY_ERROR) {
+                self->error = "Error reply from redis on XREAD";
+            } else if (depth == 2 && task->idx == 0) {
+                self->current = self->reader->FindFetching(str, len);
+            } else if (self->current != nullptr) {
+                self->current->decoder.OnString(task->type, depth, task->idx, str, len);
+            }
+            return self;
+        }
+
+        static void *CreateOther(const redisReadTask *task) {
+            return task->privdata;
+        }
+
+        static redisReplyObjectFunctions *Functions() {
+            static redisReplyObjectFunctions functions = {
+                    &Dispatcher::CreateString,
+                    [](const redisReadTask *task, size_t) { return CreateOther(task); },
+                    [](const redisReadTask *task, long long) { return CreateOther(task); },
+                    [](const redisReadTask *task, double, char *, size_t) { return CreateOther(task); },
+                    &Dispatcher::CreateOther,
+                    [](const redisReadTask *task, int) { return CreateOther(task); },
+                    [](void *) {},
+            };
+            return &functions;
+        }
+    };
+
+    Source *FindFetching(const char *key, size_t len) {
+        for (Source *source : fetching_) {
+            if (source->stream_key_len == len && memcmp(source->stream_key, key, len) == 0) {
+                return source;
+            }
+        }
+        return nullptr;
+    }
+
+    bool AllDrained() const {
+        for (const auto &source : sources_) {
+            if (!source->is_eof || source->count > 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Index of the stream whose head sample can be released next, or -1 if none can be yet.
+     */
+    int NextReleasable() const {
+        int best = -1;
+        int64_t best_value = 0;
+        int64_t max_latest = std::numeric_limits<int64_t>::min();
+        bool waiting_on_empty = false;
+        bool has_full = false;
+        for (size_t s = 0; s < sources_.size(); s++) {
+            const Source &source = *sources_[s];
+            max_latest = std::max(max_latest, source.latest_value);
+            has_full |= source.IsFull(max_fetch_size_);
+            if (source.count == 0) {
+                waiting_on_empty |= !source.is_eof;
+                continue;
+            }
+            int64_t value = source.merge_value(0);
+            if (best < 0 || value < best_value) {
+                best = static_cast<int>(s);
+                best_value = value;
+            }
+        }
+        // A full stream is skipped by #Fetch(), so waiting could only block on the empty ones; drain instead.
+        if (best < 0 || !waiting_on_empty || has_full) {
+            return best;
+        }
+        // Some stream has nothing buffered; only release what the others have moved a full window past.
+        if (max_latest - best_value >= reorder_window_) {
+            return best;
+        }
+        return -1;
+    }
+
+    /**
+     * Issues one XREAD over every stream that has room for a full fetch and is not at EOF.
+     */
+    void Fetch(int block_ms) {
+        fetching_.clear();
+        for (auto &source : sources_) {
+            if (!source->is_eof && source->Compact() >= max_fetch_size_) {
+                fetching_.push_back(source.get());
+            }
+        }
+        if (fetching_.empty()) {
+            return;
+        }
+
+        // XREAD COUNT <n> BLOCK <ms> STREAMS <key>... <id>...
+        char number[48];
+        char *out = command_.data();
+        out[0] = '*';
+        size_t header_len = 1 + internal::FormatInt64(static_cast<int64_t>(6 + 2 * fetching_.size()), out + 1);
+        out += header_len;
+        memcpy(out, "\r\n$5\r\nXREAD\r\n$5\r\nCOUNT\r\n", 24);
+        out = internal::AppendBulk(out + 24, number, internal::FormatInt64(max_fetch_size_, number));
+        memcpy(out, "$5\r\nBLOCK\r\n", 11);
+        out = internal::AppendBulk(out + 11, number, internal::FormatInt64(block_ms, number));
+        memcpy(out, "$7\r\nSTREAMS\r\n", 13);
+        out += 13;
+        for (Source *source : fetching_) {
+            out = internal::AppendBulk(out, source->stream_key, source->stream_key_len);
+        }
+        for (Source *source : fetching_) {
+            size_t id_len = internal::FormatInt64(static_cast<int64_t>(source->cursor_left), number);
+            number[id_len++] = '-';
+            id_len += internal::FormatInt64(static_cast<int64_t>(source->cursor_right), number + id_len);
+            out = internal::AppendBulk(out, number, id_len);
+
+            source->decoder.Reset(internal::EntryDecoder::kXreadEntryDepth,
+                                  source->staging.data() + source->count * source->sample_size,
+                                  max_fetch_size_,
+                                  source->sample_size,
+                                  false,
+                                  nullptr);
+        }
+        redis_->SendRaw(command_.data(), static_cast<size_t>(out - command_.data()));
+
+        Dispatcher dispatcher{this};
+        redis_->DecodeReply(Dispatcher::Functions(), &dispatcher);
+        if (dispatcher.error != nullptr) {
+            throw StreamReaderException(dispatcher.error);
+        }
+
+        for (Source *source : fetching_) {
+            internal::EntryDecoder &decoder = source->decoder;
+            decoder.ThrowIfError(source->name);
+            int64_t first_new = source->count;
+            source->count += decoder.num_samples();
+            if (source->count > first_new) {
+                source->latest_value = std::max(source->latest_value, source->merge_value(source->count - 1));
+            }
+            if (decoder.has_last_id()) {
+                source->cursor_left = decoder.last_left();
+                source->cursor_right = decoder.last_right();
+            }
+            if (decoder.has_next_stream_key()) {
+                source->SetStreamKey(decoder.next_stream_key(), decoder.next_stream_key_length());
+            }
+            if (decoder.is_eof()) {
+                source->is_eof = true;
+            }
+        }
+    }
+
+    const RedisConnection connection_;
+    const int max_fetch_size_;
+    std::unique_ptr<internal::Redis> redis_;
+
+    std::vector<std::unique_ptr<Source>> sources_;
+    std::vector<Source *> fetching_;
+    std::vector<char> command_;
+
+    int64_t reorder_window_ = 0;
+    int max_sample_size_ = 0;
+    bool is_initialized_ = false;
+    int64_t num_samples_read_ = 0;
+    int64_t num_late_samples_ = 0;
+    int64_t last_released_value_ = std::numeric_limits<int64_t>::min();
+};
+
+}
+
+#endif //PARENT_MERGE_H
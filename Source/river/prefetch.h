@@ -0,0 +1,239 @@
+#ifndef PARENT_PREFETCH_H
+#define PARENT_PREFETCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "reader.h"
+#include "decoder.h"
+#include "range.h"
+
+namespace river {
+
+/**
+ * A reader that keeps fetching a stream in the background into a local ring buffer, so that reads are served from
+ * memory instead of paying a round trip to Redis each time. A background thread keeps a blocking XREAD outstanding
+ * whenever the ring has space, fetching at most `prefetch_window_samples` samples at a time. Replies are decoded
+ * straight into the ring with internal::EntryDecoder, so steady-state prefetching does not allocate.
+ *
+ * Only streams without variable-width fields are supported.
+ */
+class PrefetchingStreamReader {
+public:
+    /**
+     * @param connection: parameters to connect to Redis
+     * @param ring_depth_samples: number of samples the local ring buffer can hold.
+     * @param prefetch_window_samples: maximum number of samples fetched by a single background read.
+     */
+    explicit PrefetchingStreamReader(const RedisConnection &connection,
+                                     int64_t ring_depth_samples = 65536,
+                                     int prefetch_window_samples = 4096)
+            : connection_(connection),
+              cursor_(connection, prefetch_window_samples),
+              ring_depth_samples_(std::max<int64_t>(ring_depth_samples, 1)),
+              prefetch_window_samples_(std::max(prefetch_window_samples, 1)) {}
+
+    ~PrefetchingStreamReader() {
+        Stop();
+    }
+
+    PrefetchingStreamReader(const PrefetchingStreamReader &) = delete;
+    PrefetchingStreamReader &operator=(const PrefetchingStreamReader &) = delete;
+
+    /**
+     * Waits for the stream as in StreamReader::Initialize and starts prefetching.
+     *
+     * @param from_live_end If true, prefetching starts after the last sample written so far (located with a
+     * RangeReader), so only samples written from now on are read; otherwise it starts at the beginning of the stream.
+     */
+    void Initialize(const std::string &stream_name, int timeout_ms = -1, bool from_live_end = false) {
+        cursor_.Initialize(stream_name, timeout_ms);
+        if (cursor_.schema().has_variable_width_field()) {
+            throw StreamReaderException("Prefetching is not supported for streams with variable-width fields.");
+        }
+        if (from_live_end) {
+            RangeReader range(connection_);
+            range.Initialize(stream_name, timeout_ms);
+            std::string key;
+            internal::EntryId after;
+            range.Position(range.num_samples(), &key, &after);
+            cursor_.Reposition(key, after.left, after.right);
+        }
+        sample_size_ = cursor_.schema().sample_size();
+        ring_.resize(static_cast<size_t>(ring_depth_samples_) * sample_size_);
+        fetch_thread_ = std::thread(&PrefetchingStreamReader::Run, this);
+    }
+
+    /**
+     * Typed version of #ReadBytes(); see StreamReader::Read.
+     */
+    template<class DataT>
+    int64_t Read(DataT *buffer, int64_t num_samples, int timeout_ms = -1) {
+        if (sizeof(buffer[0]) != static_cast<size_t>(sample_size_)) {
+            throw StreamReaderException("Buffer given was not the same size as what's stored in metadata.");
+        }
+        return ReadBytes(reinterpret_cast<char *>(buffer), num_samples, timeout_ms);
+    }
+
+    /**
+     * Same semantics as StreamReader::ReadBytes, but served from the local ring buffer: blocks until `num_samples`
+     * samples have been prefetched, the timeout elapses, or the stream ends. Returns -1 once EOF has been reached and
+     * every prefetched sample has been consumed.
+     */
+    int64_t ReadBytes(char *buffer, int64_t num_samples, int timeout_ms = -1) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto ready = [&] {
+            return num_buffered_ >= std::min(num_samples, ring_depth_samples_) || is_eof_ || error_ || is_stopped_;
+        };
+        if (timeout_ms > 0) {
+            data_available_.wait_for(lock, std::chrono::milliseconds(timeout_ms), ready);
+        } else {
+            data_available_.wait(lock, ready);
+        }
+        if (error_ && num_buffered_ == 0) {
+            std::rethrow_exception(error_);
+        }
+        if (num_buffered_ == 0 && (is_eof_ || is_stopped_)) {
+            return -1;
+        }
+
+        int64_t num_read = std::min(num_samples, num_buffered_);
+        int64_t first = std::min(num_read, ring_depth_samples_ - read_pos_);
+        memcpy(buffer, ring_.data() + read_pos_ * sample_size_, first * sample_size_);
+        memcpy(buffer + first * sample_size_, ring_.data(), (num_read - first) * sample_size_);
+
+        read_pos_ = (read_pos_ + num_read) % ring_depth_samples_;
+        num_buffered_ -= num_read;
+        num_samples_read_ += num_read;
+        lock.unlock();
+        space_available_.notify_one();
+        return num_read;
+    }
+
+    /**
+     * Number of samples currently prefetched and waiting to be read.
+     */
+    int64_t num_buffered() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return num_buffered_;
+    }
+
+    /**
+     * Number of samples that have been read through #ReadBytes().
+     */
+    int64_t total_samples_read() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return num_samples_read_;
+    }
+
+    /**
+     * Whether more samples can be read: the stream has not ended or there are still prefetched samples.
+     */
+    bool Good() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return !is_stopped_ && !error_ && (num_buffered_ > 0 || !is_eof_);
+    }
+
+    const StreamSchema &schema() {
+        return cursor_.schema();
+    }
+
+    const std::string &stream_name() {
+        return cursor_.stream_name();
+    }
+
+    /**
+     * Stops prefetching. Pending and future reads return -1.
+     */
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (is_stopped_) {
+                return;
+            }
+            is_stopped_ = true;
+        }
+        space_available_.notify_all();
+        data_available_.notify_all();
+        if (fetch_thread_.joinable()) {
+            fetch_thread_.join();
+        }
+    }
+
+private:
+    // How long a background read blocks before checking whether the reader was stopped.
+    static constexpr int kFetchTimeoutMs = 50;
+
+    void Run() {
+        try {
+            while (true) {
+                int64_t write_pos, num_free;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    space_available_.wait(lock, [&] { return num_buffered_ < ring_depth_samples_ || is_stopped_; });
+                    if (is_stopped_) {
+                        return;
+                    }
+                    write_pos = (read_pos_ + num_buffered_) % ring_depth_samples_;
+                    num_free = ring_depth_samples_ - num_buffered_;
+                }
+
+                // Only this thread writes to the free region of the ring, so fetch directly into it without the lock.
+                int64_t contiguous_free = std::min(num_free, ring_depth_samples_ - write_pos);
+                int64_t num_to_fetch = std::min<int64_t>(contiguous_free, prefetch_window_samples_);
+                int64_t num_fetched = cursor_.ReadBytes(
+                        ring_.data() + write_pos * sample_size_, num_to_fetch, nullptr, kFetchTimeoutMs);
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (num_fetched < 0) {
+                        is_eof_ = true;
+                    } else {
+                        num_buffered_ += num_fetched;
+                    }
+                }
+                if (num_fetched != 0) {
+                    data_available_.notify_all();
+                }
+                if (num_fetched < 0) {
+                    return;
+                }
+            }
+        } catch (...) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                error_ = std::current_exception();
+            }
+            data_available_.notify_all();
+        }
+    }
+
+    const RedisConnection connection_;
+    internal::StreamCursor cursor_;
+    const int64_t ring_depth_samples_;
+    const int prefetch_window_samples_;
+    int sample_size_ = 0;
+
+    std::vector<char> ring_;
+    std::thread fetch_thread_;
+
+    std::mutex mutex_;
+    std::condition_variable data_available_;
+    std::condition_variable space_available_;
+    int64_t read_pos_ = 0;
+    int64_t num_buffered_ = 0;
+    int64_t num_samples_read_ = 0;
+    bool is_eof_ = false;
+    bool is_stopped_ = false;
+    std::exception_ptr error_;
+};
+
+}
+
+#endif //PARENT_PREFETCH_H
@@ -0,0 +1,613 @@
+#ifndef PARENT_RANGE_H
+#define PARENT_RANGE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "schema.h"
+#include "reader.h"
+#include "decoder.h"
+#include "redis.h"
+
+namespace river {
+namespace internal {
+
+/**
+ * A redis stream entry ID, "<left>-<right>", where left is the server time in milliseconds.
+ */
+typedef struct EntryId {
+    uint64_t left;
+    uint64_t right;
+
+    bool operator<(const EntryId &other) const {
+        return left < other.left || (left == other.left && right < other.right);
+    }
+
+    /**
+     * The smallest ID strictly greater than this one, for resuming an inclusive XRANGE after this entry.
+     */
+    EntryId Next() const {
+        return right == std::numeric_limits<uint64_t>::max() ? EntryId{left + 1, 0} : EntryId{left, right + 1};
+    }
+
+    /**
+     * The largest ID strictly smaller than this one.
+     */
+    EntryId Prev() const {
+        return right == 0 ? EntryId{left - 1, std::numeric_limits<uint64_t>::max()} : EntryId{left, right - 1};
+    }
+} EntryId;
+
+/**
+ * One redis stream key of a River stream, i.e. the entries between two tombstones.
+ */
+typedef struct KeySegment {
+    std::string key;
+
+    // Sample index of the first data entry in this key, or -1 while the key has no data entries yet.
+    int64_t first_sample = -1;
+    EntryId first_id{0, 0};
+
+    // The key that follows this one, once this key has been tombstoned.
+    std::string next_key;
+    bool is_closed = false;
+    bool is_eof = false;
+
+    // ID of the tombstone or EOF entry that ends this key, once it is closed or at EOF.
+    EntryId end_id{0, 0};
+
+    // Sparse map from sample index to entry ID, filled in as entries are located.
+    std::map<int64_t, EntryId> checkpoints;
+} KeySegment;
+
+}
+
+/**
+ * Random access to an existing stream by sample index. Keeps a directory of the stream's redis keys (found by following
+ * tombstones) with the first sample index in each, plus a sparse per-key index from sample index to entry ID that grows
+ * as ranges are located. A range read bisects on entry IDs within a key to find its first sample and then reads the
+ * range with XRANGE, following rollovers to later keys; neither step scans from the start of the stream.
+ *
+ * Samples can also be looked up by wall-clock time, since entry IDs carry the server time in milliseconds.
+ */
+class RangeReader {
+public:
+    /**
+     * @param connection: parameters to connect to Redis
+     * @param max_fetch_size: maximum number of samples to fetch per XRANGE.
+     */
+    explicit RangeReader(const RedisConnection &connection, int max_fetch_size = 10000)
+            : connection_(connection), max_fetch_size_(std::max(max_fetch_size, 1)) {}
+
+    /**
+     * Initializes this reader to an existing stream, waiting up to `timeout_ms` for it to be created as in
+     * StreamReader::Initialize.
+     */
+    void Initialize(const std::string &stream_name, int timeout_ms = -1) {
+        redis_ = internal::Redis::Create(connection_);
+        stream_name_ = stream_name;
+        metadata_ = internal::FetchStreamMetadata(redis_.get(), stream_name, timeout_ms);
+        schema_ = std::make_unique<StreamSchema>(StreamSchema::FromJson(metadata_->at("schema")));
+        sample_size_ = schema_->sample_size();
+        has_variable_width_field_ = schema_->has_variable_width_field();
+        local_minus_server_clock_us_ = MetadataInt64("local_minus_server_clock_us");
+        initialized_at_us_ = MetadataInt64("initialized_at_us");
+        scratch_.resize(static_cast<size_t>(sample_size_) * (kLinearScanSamples + 1));
+        command_.resize(internal::EntryDecoder::kMaxStreamKeyLength + 192);
+
+        segments_.clear();
+        internal::KeySegment first;
+        first.key = metadata_->at("first_stream_key");
+        segments_.push_back(first);
+        RefreshSegments();
+        is_initialized_ = true;
+    }
+
+    /**
+     * Reads samples `first_sample` through `last_sample` (inclusive) into `buffer`. Does not block: if the stream does
+     * not (yet) contain the whole range, only the samples present are read.
+     *
+     * @param buffer Receives the samples as StreamReader::ReadBytes would; must hold
+     * `(last_sample - first_sample + 1) * schema().sample_size()` bytes.
+     * @param sizes If not null, receives the size of each sample.
+     * @return the number of samples read, starting at first_sample.
+     */
+    int64_t ReadRange(int64_t first_sample, int64_t last_sample, char *buffer, int *sizes = nullptr) {
+        if (!is_initialized_) {
+            throw StreamReaderException("Range reader was not initialized.");
+        }
+        if (first_sample < 0 || last_sample < first_sample) {
+            std::stringstream ss;
+            ss << "Invalid sample range [" << first_sample << ", " << last_sample << "] (stream " << stream_name_
+               << ")";
+            throw StreamReaderException(ss.str());
+        }
+
+        size_t segment_idx;
+        internal::EntryId start;
+        if (!Locate(first_sample, &segment_idx, &start)) {
+            return 0;
+        }
+        return ReadFrom(segments_[segment_idx].key, start, first_sample, last_sample - first_sample + 1,
+                        buffer, sizes);
+    }
+
+    /**
+     * Index of the first sample written at or after `time`, given on the writer's clock (converted to server time
+     * with #local_minus_server_clock_us(), at millisecond resolution). Returns #num_samples() if no sample has been
+     * written since. Bisects over the key directory by the time of each key's first entry, then lets a single
+     * ID-bounded XRANGE find the entry within the key.
+     */
+    int64_t SampleAtTime(std::chrono::system_clock::time_point time) {
+        if (!is_initialized_) {
+            throw StreamReaderException("Range reader was not initialized.");
+        }
+        RefreshSegments();
+        uint64_t server_ms = internal::ServerMillis(time, local_minus_server_clock_us_);
+
+        // Keys with data are ordered by time; find the last one that starts at or before the target.
+        size_t lo = 0, hi = segments_.size();
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            const internal::KeySegment &segment = segments_[mid];
+            if (segment.first_sample >= 0 && segment.first_id.left <= server_ms) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+
+        for (size_t s = lo == 0 ? 0 : lo - 1; s < segments_.size(); s++) {
+            internal::EntryId id;
+            int64_t sample_index;
+            if (segments_[s].first_sample >= 0
+                && FirstDataEntry(segments_[s].key, internal::EntryId{server_ms, 0}, &id, &sample_index)) {
+                segments_[s].checkpoints[sample_index] = id;
+                return sample_index;
+            }
+        }
+        return num_samples();
+    }
+
+    /**
+     * Reads the samples written in [t0, t1), with times as in #SampleAtTime(). At most `max_samples` samples are read.
+     *
+     * @param first_sample If not null, receives the index of the first sample read.
+     * @return the number of samples read.
+     */
+    int64_t ReadTimeRange(std::chrono::system_clock::time_point t0,
+                          std::chrono::system_clock::time_point t1,
+                          char *buffer,
+                          int64_t max_samples,
+                          int *sizes = nullptr,
+                          int64_t *first_sample = nullptr) {
+        int64_t first = SampleAtTime(t0);
+        int64_t end = std::min(SampleAtTime(t1), first + max_samples);
+        if (first_sample != nullptr) {
+            *first_sample = first;
+        }
+        if (end <= first) {
+            return 0;
+        }
+        return ReadRange(first, end - 1, buffer, sizes);
+    }
+
+    /**
+     * Reads the last `num_samples` samples of the stream (or all of them, if there are fewer) into `buffer` in stream
+     * order. Unlike repeated StreamReader::TailBytes calls, this is a single XREVRANGE per `max_fetch_size` samples
+     * of each key read. The key directory is only refreshed when the tail reply shows that the writer has closed the
+     * last known key since the directory was last extended.
+     *
+     * @param buffer Receives the samples as StreamReader::ReadBytes would; must hold
+     * `num_samples * schema().sample_size()` bytes.
+     * @param sizes If not null, receives the size of each sample.
+     * @param first_sample If not null, receives the index of the first sample read.
+     * @return the number of samples read.
+     */
+    int64_t Snapshot(int64_t num_samples, char *buffer, int *sizes = nullptr, int64_t *first_sample = nullptr) {
+        if (!is_initialized_) {
+            throw StreamReaderException("Range reader was not initialized.");
+        }
+        snapshot_.resize(static_cast<size_t>(std::max<int64_t>(num_samples, 0)) * sample_size_);
+        snapshot_sizes_.resize(static_cast<size_t>(std::max<int64_t>(num_samples, 0)));
+
+        // Newest first: walk back from the end of the last key through earlier keys until enough samples are read.
+        int64_t num_read = 0;
+        int64_t num_bytes = 0;
+        size_t s = segments_.size();
+        while (num_read < num_samples && s > 0) {
+            internal::KeySegment &segment = segments_[--s];
+            bool is_ended = segment.is_closed || segment.is_eof;
+            if (is_ended && segment.first_sample < 0) {
+                continue;
+            }
+
+            // XREVRANGE stops decoding at a tombstone or EOF, so start below the key's final marker if it has one.
+            char bound[48];
+            size_t bound_len = 1;
+            bound[0] = '+';
+            if (is_ended) {
+                bound_len = FormatId(segment.end_id.Prev(), bound);
+            }
+
+            while (num_read < num_samples) {
+                int64_t count = std::min<int64_t>(num_samples - num_read, max_fetch_size_);
+                int64_t n = Range(segment.key, false, bound, bound_len, snapshot_.data() + num_bytes, count,
+                                  snapshot_sizes_.data() + num_read);
+                if (n == 0 && (decoder_.has_next_stream_key() || decoder_.is_eof())) {
+                    // Only the open last key can start with its marker: the writer ended it since it was last seen.
+                    internal::EntryId end_id{decoder_.last_left(), decoder_.last_right()};
+                    if (decoder_.is_eof()) {
+                        segment.is_eof = true;
+                        segment.end_id = end_id;
+                        bound_len = FormatId(end_id.Prev(), bound);
+                        continue;
+                    }
+                    // Rolled over to a new key; extend the directory and start over from its end.
+                    RefreshSegments();
+                    s = segments_.size();
+                    break;
+                }
+                num_read += n;
+                num_bytes += decoder_.num_bytes();
+                if (n > 0 && first_sample != nullptr) {
+                    *first_sample = decoder_.last_sample_index();
+                }
+                if (n < count || decoder_.has_next_stream_key() || decoder_.is_eof()) {
+                    break;
+                }
+                bound_len = FormatId(internal::EntryId{decoder_.last_left(), decoder_.last_right()}.Prev(), bound);
+            }
+        }
+
+        // Copy out oldest first.
+        const char *src = snapshot_.data() + num_bytes;
+        char *dst = buffer;
+        for (int64_t i = num_read - 1; i >= 0; i--) {
+            int size = snapshot_sizes_[i];
+            int stride = has_variable_width_field_ ? size : sample_size_;
+            src -= stride;
+            memcpy(dst, src, size);
+            dst += stride;
+            if (sizes != nullptr) {
+                sizes[num_read - 1 - i] = size;
+            }
+        }
+        return num_read;
+    }
+
+    /**
+     * Finds where `sample` is stored: the redis key holding it, and an entry ID after which it is the first data entry,
+     * i.e. an XREAD cursor that reads it next. If the stream does not contain the sample yet, gives the cursor at the
+     * current end of the stream instead and returns false.
+     */
+    bool Position(int64_t sample, std::string *key, internal::EntryId *after) {
+        if (!is_initialized_) {
+            throw StreamReaderException("Range reader was not initialized.");
+        }
+        size_t segment_idx;
+        internal::EntryId start;
+        if (sample >= 0 && Locate(sample, &segment_idx, &start)) {
+            *key = segments_[segment_idx].key;
+            *after = start.Prev();
+            return true;
+        }
+
+        RefreshSegments();
+        internal::KeySegment &last = segments_.back();
+        *key = last.key;
+        int64_t last_sample;
+        if (last.first_sample < 0 || !LastDataEntry(last.key, after, &last_sample)) {
+            *after = internal::EntryId{0, 0};
+        }
+        return false;
+    }
+
+    /**
+     * See StreamReader::local_minus_server_clock_us.
+     */
+    int64_t local_minus_server_clock_us() const {
+        return local_minus_server_clock_us_;
+    }
+
+    /**
+     * See StreamReader::initialized_at_us.
+     */
+    int64_t initialized_at_us() const {
+        return initialized_at_us_;
+    }
+
+    /**
+     * Total number of samples in the stream so far, i.e. one past the last sample index.
+     */
+    int64_t num_samples() {
+        RefreshSegments();
+        for (auto it = segments_.rbegin(); it != segments_.rend(); ++it) {
+            internal::EntryId id;
+            int64_t sample_index;
+            if (it->first_sample >= 0 && LastDataEntry(it->key, &id, &sample_index)) {
+                return sample_index + 1;
+            }
+        }
+        return 0;
+    }
+
+    const StreamSchema &schema() const {
+        return *schema_;
+    }
+
+    const std::string &stream_name() const {
+        return stream_name_;
+    }
+
+    /**
+     * The stream's redis keys found so far, in order.
+     */
+    const std::vector<internal::KeySegment> &segments() const {
+        return segments_;
+    }
+
+private:
+    // Once a bisection has narrowed the target to this many samples, the rest is read through linearly.
+    static constexpr int64_t kLinearScanSamples = 64;
+
+    /**
+     * Extends the key directory past any keys that have been tombstoned since it was last refreshed.
+     */
+    void RefreshSegments() {
+        while (true) {
+            internal::KeySegment &last = segments_.back();
+            if (last.first_sample < 0) {
+                internal::EntryId id;
+                int64_t sample_index;
+                if (FirstDataEntry(last.key, internal::EntryId{0, 0}, &id, &sample_index)) {
+                    last.first_sample = sample_index;
+                    last.first_id = id;
+                    last.checkpoints[sample_index] = id;
+                }
+            }
+            if (last.is_eof) {
+                return;
+            }
+
+            // The last entry of a key is its tombstone (or EOF) once the writer has moved on.
+            Range(last.key, false, "+", 1, scratch_.data(), 1);
+            if (decoder_.has_next_stream_key() || decoder_.is_eof()) {
+                last.end_id = internal::EntryId{decoder_.last_left(), decoder_.last_right()};
+            }
+            if (decoder_.has_next_stream_key()) {
+                last.is_closed = true;
+                last.next_key.assign(decoder_.next_stream_key(), decoder_.next_stream_key_length());
+            } else {
+                last.is_eof = decoder_.is_eof();
+                return;
+            }
+
+            internal::KeySegment next;
+            next.key = last.next_key;
+            segments_.push_back(next);
+        }
+    }
+
+    /**
+     * Finds the key holding `sample` and a start ID for reading from it: the sample's entry is the first data entry
+     * at or after that ID. Returns false if the stream does not contain the sample yet.
+     */
+    bool Locate(int64_t sample, size_t *segment_idx, internal::EntryId *start) {
+        RefreshSegments();
+
+        // The last key whose first sample is at or before the target.
+        size_t s = segments_.size();
+        while (s > 0 && (segments_[s - 1].first_sample < 0 || segments_[s - 1].first_sample > sample)) {
+            s--;
+        }
+        if (s == 0) {
+            return false;
+        }
+        *segment_idx = --s;
+        internal::KeySegment &segment = segments_[s];
+
+        // Bracket the target with the nearest known entries: lo at or before it and hi after it.
+        auto after = segment.checkpoints.upper_bound(sample);
+        auto before = std::prev(after);
+        int64_t lo_sample = before->first;
+        internal::EntryId lo = before->second;
+        internal::EntryId hi;
+        if (after != segment.checkpoints.end()) {
+            hi = after->second;
+        } else {
+            internal::EntryId last_id;
+            int64_t last_sample;
+            if (!LastDataEntry(segment.key, &last_id, &last_sample) || last_sample < sample) {
+                return false;
+            }
+            segment.checkpoints[last_sample] = last_id;
+            hi = last_id;
+        }
+
+        // Bisect on the millisecond part of the ID: the sample index of the first entry at or after a given time
+        // tells which side of that time the target is on.
+        while (sample - lo_sample > kLinearScanSamples && hi.left - lo.left > 1) {
+            uint64_t mid_ms = lo.left + (hi.left - lo.left) / 2;
+            internal::EntryId id;
+            int64_t sample_index;
+            if (FirstDataEntry(segment.key, internal::EntryId{mid_ms, 0}, &id, &sample_index)) {
+                segment.checkpoints[sample_index] = id;
+                if (sample_index <= sample) {
+                    lo = id;
+                    lo_sample = sample_index;
+                    continue;
+                }
+            }
+            hi = internal::EntryId{mid_ms, 0};
+        }
+
+        // Read through the remaining few entries to reach the target itself.
+        *start = lo;
+        while (lo_sample < sample) {
+            int64_t skip = std::min(sample - lo_sample, kLinearScanSamples);
+            char bound[48];
+            if (Range(segment.key, true, bound, FormatId(*start, bound), scratch_.data(), skip) <= 0) {
+                return false;
+            }
+            lo_sample = decoder_.last_sample_index() + 1;
+            *start = internal::EntryId{decoder_.last_left(), decoder_.last_right()}.Next();
+        }
+        segment.checkpoints[sample] = *start;
+        return true;
+    }
+
+    /**
+     * Reads `num_samples` samples starting at entry `start` of `key`, following tombstones into later keys.
+     */
+    int64_t ReadFrom(std::string key,
+                     internal::EntryId start,
+                     int64_t first_sample,
+                     int64_t num_samples,
+                     char *buffer,
+                     int *sizes) {
+        int64_t num_read = 0;
+        int64_t num_bytes = 0;
+        while (num_read < num_samples) {
+            int64_t count = std::min<int64_t>(num_samples - num_read, max_fetch_size_);
+            char bound[48];
+            int64_t n = Range(key, true, bound, FormatId(start, bound), buffer + num_bytes, count,
+                              sizes == nullptr ? nullptr : sizes + num_read);
+            if (n > 0 && decoder_.last_sample_index() != first_sample + num_read + n - 1) {
+                std::stringstream ss;
+                ss << "Expected sample " << (first_sample + num_read + n - 1) << " but read sample "
+                   << decoder_.last_sample_index() << " (stream " << stream_name_ << ", key " << key << ")";
+                throw StreamReaderException(ss.str());
+            }
+            num_read += n;
+            num_bytes += decoder_.num_bytes();
+
+            if (decoder_.has_next_stream_key()) {
+                key.assign(decoder_.next_stream_key(), decoder_.next_stream_key_length());
+                start = internal::EntryId{0, 0};
+            } else if (n < count || decoder_.is_eof()) {
+                break;
+            } else {
+                start = internal::EntryId{decoder_.last_left(), decoder_.last_right()}.Next();
+            }
+        }
+        return num_read;
+    }
+
+    /**
+     * The first data entry at or after `from` in `key`, if there is one before the key's tombstone.
+     */
+    bool FirstDataEntry(const std::string &key,
+                        internal::EntryId from,
+                        internal::EntryId *id,
+                        int64_t *sample_index) {
+        char bound[48];
+        if (Range(key, true, bound, FormatId(from, bound), scratch_.data(), 1) <= 0) {
+            return false;
+        }
+        *id = internal::EntryId{decoder_.last_left(), decoder_.last_right()};
+        *sample_index = decoder_.last_sample_index();
+        return true;
+    }
+
+    /**
+     * The last data entry in `key`, which is followed by at most one tombstone or EOF entry.
+     */
+    bool LastDataEntry(const std::string &key, internal::EntryId *id, int64_t *sample_index) {
+        if (Range(key, false, "+", 1, scratch_.data(), 1) == 0) {
+            if (!decoder_.has_last_id()) {
+                return false;
+            }
+            char bound[48];
+            internal::EntryId before = internal::EntryId{decoder_.last_left(), decoder_.last_right()}.Prev();
+            if (Range(key, false, bound, FormatId(before, bound), scratch_.data(), 1) == 0) {
+                return false;
+            }
+        }
+        *id = internal::EntryId{decoder_.last_left(), decoder_.last_right()};
+        *sample_index = decoder_.last_sample_index();
+        return true;
+    }
+
+    int64_t MetadataInt64(const std::string &key) const {
+        auto it = metadata_->find(key);
+        if (it == metadata_->end()) {
+            return 0;
+        }
+        int64_t value = 0;
+        internal::ParseInt64(it->second.data(), it->second.size(), &value);
+        return value;
+    }
+
+    static size_t FormatId(internal::EntryId id, char *out) {
+        size_t len = internal::FormatInt64(static_cast<int64_t>(id.left), out);
+        out[len++] = '-';
+        return len + internal::FormatInt64(static_cast<int64_t>(id.right), out + len);
+    }
+
+    /**
+     * Runs XRANGE <key> <from> + (forward) or XREVRANGE <key> <from> - and decodes up to `max_samples` data entries
+     * into `buffer`. Returns the number of data entries decoded; the decoder holds the details.
+     */
+    int64_t Range(const std::string &key,
+                  bool forward,
+                  const char *from,
+                  size_t from_len,
+                  char *buffer,
+                  int64_t max_samples,
+                  int *sizes = nullptr) {
+        char number[24];
+        char *out = command_.data();
+        if (forward) {
+            memcpy(out, "*6\r\n$6\r\nXRANGE\r\n", 16);
+            out += 16;
+        } else {
+            memcpy(out, "*6\r\n$9\r\nXREVRANGE\r\n", 19);
+            out += 19;
+        }
+        out = internal::AppendBulk(out, key.data(), key.size());
+        out = internal::AppendBulk(out, from, from_len);
+        out = internal::AppendBulk(out, forward ? "+" : "-", 1);
+        memcpy(out, "$5\r\nCOUNT\r\n", 11);
+        out = internal::AppendBulk(out + 11, number, internal::FormatInt64(max_samples, number));
+        redis_->SendRaw(command_.data(), static_cast<size_t>(out - command_.data()));
+
+        decoder_.Reset(internal::EntryDecoder::kXrangeEntryDepth, buffer, max_samples, sample_size_,
+                       has_variable_width_field_, sizes);
+        redis_->DecodeReply(internal::EntryDecoder::Functions(), &decoder_);
+        decoder_.ThrowIfError(stream_name_);
+        return decoder_.num_samples();
+    }
+
+    const RedisConnection connection_;
+    const int max_fetch_size_;
+    std::unique_ptr<internal::Redis> redis_;
+
+    std::string stream_name_;
+    std::unique_ptr<std::unordered_map<std::string, std::string>> metadata_;
+    std::unique_ptr<StreamSchema> schema_;
+    int sample_size_ = 0;
+    bool has_variable_width_field_ = false;
+    bool is_initialized_ = false;
+    int64_t local_minus_server_clock_us_ = 0;
+    int64_t initialized_at_us_ = 0;
+
+    std::vector<internal::KeySegment> segments_;
+    std::vector<char> scratch_;
+    std::vector<char> snapshot_;
+    std::vector<int> snapshot_sizes_;
+    std::vector<char> command_;
+    internal::EntryDecoder decoder_;
+};
+
+}
+
+#endif //PARENT_RANGE_H
@@ -0,0 +1,390 @@
+#ifndef PARENT_REACTOR_H
+#define PARENT_REACTOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "schema.h"
+#include "reader.h"
+#include "decoder.h"
+#include "redis.h"
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <cerrno>
+#elif !defined(_WIN32) && !defined(_WIN64)
+#include <poll.h>
+#include <cerrno>
+#endif
+
+namespace river {
+namespace internal {
+
+/**
+ * Waits for any of a set of sockets to become readable: epoll on Linux, poll() elsewhere (WSAPoll on Windows).
+ * Level-triggered, so a socket that is not fully drained is reported again by the next #Wait().
+ */
+class SocketPoller {
+public:
+    SocketPoller() {
+#if defined(__linux__)
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ < 0) {
+            throw StreamReaderException("Could not create epoll instance: " + std::string(strerror(errno)));
+        }
+#endif
+    }
+
+    ~SocketPoller() {
+#if defined(__linux__)
+        close(epoll_fd_);
+#endif
+    }
+
+    SocketPoller(const SocketPoller &) = delete;
+    SocketPoller &operator=(const SocketPoller &) = delete;
+
+    void Add(redisFD fd, int64_t tag) {
+#if defined(__linux__)
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = static_cast<uint64_t>(tag);
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+            throw StreamReaderException("Could not watch socket: " + std::string(strerror(errno)));
+        }
+#else
+        PollFd entry{};
+        entry.fd = fd;
+        entry.events = POLLIN;
+        fds_.push_back(entry);
+        tags_.push_back(tag);
+#endif
+    }
+
+    void Remove(redisFD fd) {
+#if defined(__linux__)
+        epoll_event event{};
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, &event);
+#else
+        for (size_t i = 0; i < fds_.size(); i++) {
+            if (fds_[i].fd == fd) {
+                fds_.erase(fds_.begin() + i);
+                tags_.erase(tags_.begin() + i);
+                break;
+            }
+        }
+#endif
+    }
+
+    /**
+     * Waits up to `timeout_ms` (forever if negative) and fills `ready` with the tags of the readable sockets.
+     */
+    void Wait(int timeout_ms, std::vector<int64_t> *ready) {
+        ready->clear();
+#if defined(__linux__)
+        events_.resize(std::max<size_t>(events_.size(), 64));
+        int n = epoll_wait(epoll_fd_, events_.data(), static_cast<int>(events_.size()), timeout_ms);
+        if (n < 0) {
+            if (errno == EINTR) {
+                return;
+            }
+            throw StreamReaderException("epoll_wait failed: " + std::string(strerror(errno)));
+        }
+        for (int i = 0; i < n; i++) {
+            ready->push_back(static_cast<int64_t>(events_[i].data.u64));
+        }
+#else
+        if (fds_.empty()) {
+            return;
+        }
+#if defined(_WIN32) || defined(_WIN64)
+        int n = WSAPoll(fds_.data(), static_cast<ULONG>(fds_.size()), timeout_ms);
+#else
+        int n = poll(fds_.data(), static_cast<nfds_t>(fds_.size()), timeout_ms);
+        if (n < 0 && errno == EINTR) {
+            return;
+        }
+#endif
+        if (n < 0) {
+            throw StreamReaderException("Polling redis sockets failed.");
+        }
+        for (size_t i = 0; i < fds_.size() && n > 0; i++) {
+            // Errors and hangups count as readable, so that the failing read reports them.
+            if (fds_[i].revents != 0) {
+                ready->push_back(tags_[i]);
+                n--;
+            }
+        }
+#endif
+    }
+
+private:
+#if defined(__linux__)
+    int epoll_fd_ = -1;
+    std::vector<epoll_event> events_;
+#else
+#if defined(_WIN32) || defined(_WIN64)
+    typedef WSAPOLLFD PollFd;
+#else
+    typedef pollfd PollFd;
+#endif
+    std::vector<PollFd> fds_;
+    std::vector<int64_t> tags_;
+#endif
+};
+
+}
+
+/**
+ * Tuning for StreamReactor.
+ */
+typedef struct ReactorOptions {
+    // Maximum number of samples handed to a single callback.
+    int64_t max_batch_samples = 1024;
+
+    // After a callback, wait at least this long before reading that stream again, so that streams deliver fewer,
+    // larger batches. 0 reads again immediately.
+    int min_batch_interval_ms = 0;
+
+    // Maximum number of callbacks per #StreamReactor::Poll(), served round-robin across ready streams so that a busy
+    // stream cannot starve the rest; 0 is unlimited.
+    int max_callbacks_per_poll = 0;
+} ReactorOptions;
+
+/**
+ * Samples handed to a StreamReactor callback. The pointers are only valid during the callback.
+ */
+typedef struct StreamBatch {
+    int64_t stream_id;
+    const std::string *stream_name;
+    const StreamSchema *schema;
+
+    // `num_samples` samples, laid out as StreamReader::ReadBytes would.
+    const char *data;
+    int64_t num_samples;
+    const int *sizes;
+
+    // True for the final callback of a stream, which carries no samples; the stream is removed after it.
+    bool is_eof;
+} StreamBatch;
+
+/**
+ * Watches many streams from one thread. Each stream keeps its own connection with an XREAD outstanding on it; one
+ * epoll (or poll) wait covers all their sockets, and a stream's callback runs when its reply arrives. Replies are
+ * decoded straight into a per-stream batch buffer as with internal::StreamCursor, so a watched stream costs a socket
+ * and a buffer rather than a thread.
+ *
+ * Not thread-safe, except for #Stop(). Callbacks run on the thread calling #Poll() or #Run() and may #Add() or
+ * #Remove() streams.
+ */
+class StreamReactor {
+public:
+    typedef std::function<void(const StreamBatch &)> Callback;
+
+    explicit StreamReactor(const RedisConnection &connection, ReactorOptions options = ReactorOptions())
+            : connection_(connection), options_(options) {
+        options_.max_batch_samples = std::max<int64_t>(options_.max_batch_samples, 1);
+    }
+
+    /**
+     * Starts watching a stream from its beginning, waiting up to `timeout_ms` for it to be created as in
+     * StreamReader::Initialize.
+     *
+     * @return an ID for the stream, passed in each of its batches and accepted by #Remove().
+     */
+    int64_t Add(const std::string &stream_name, Callback callback, int timeout_ms = -1) {
+        auto watch = std::make_unique<Watch>();
+        watch->id = next_id_++;
+        watch->callback = std::move(callback);
+        watch->cursor = std::make_unique<internal::StreamCursor>(
+                connection_, static_cast<int>(std::min<int64_t>(options_.max_batch_samples, 1 << 30)));
+        watch->cursor->Initialize(stream_name, timeout_ms);
+        watch->buffer.resize(static_cast<size_t>(options_.max_batch_samples * watch->cursor->schema().sample_size()));
+        watch->sizes.resize(static_cast<size_t>(options_.max_batch_samples));
+        watch->next_read = std::chrono::steady_clock::now();
+
+        poller_.Add(watch->cursor->socket(), watch->id);
+        int64_t id = watch->id;
+        streams_[id] = std::move(watch);
+        return id;
+    }
+
+    /**
+     * Stops watching a stream; its callback is not called again.
+     */
+    void Remove(int64_t stream_id) {
+        auto it = streams_.find(stream_id);
+        if (it != streams_.end() && !it->second->is_removed) {
+            it->second->is_removed = true;
+            poller_.Remove(it->second->cursor->socket());
+            if (!is_polling_) {
+                streams_.erase(it);
+            }
+        }
+    }
+
+    /**
+     * Waits up to `timeout_ms` (forever if negative) for data on any watched stream, then runs the callbacks of the
+     * streams whose replies have arrived, subject to ReactorOptions::max_callbacks_per_poll.
+     *
+     * @return the number of callbacks run.
+     */
+    int Poll(int timeout_ms = -1) {
+        if (streams_.empty()) {
+            return 0;
+        }
+        ArmDueStreams();
+
+        // Don't sleep past the moment a throttled stream is due to be read again.
+        auto now = std::chrono::steady_clock::now();
+        int wait_ms = timeout_ms;
+        for (auto &entry : streams_) {
+            const Watch &watch = *entry.second;
+            if (!watch.is_removed && !watch.is_pending) {
+                auto due_ms = std::chrono::duration_cast<std::chrono::milliseconds>(watch.next_read - now).count();
+                int due = static_cast<int>(std::max<int64_t>(due_ms, 0)) + 1;
+                wait_ms = wait_ms < 0 ? due : std::min(wait_ms, due);
+            }
+        }
+        poller_.Wait(wait_ms, &ready_);
+        is_polling_ = true;
+
+        // Round-robin: start with the first ready stream after the last one served.
+        std::sort(ready_.begin(), ready_.end());
+        auto first = std::upper_bound(ready_.begin(), ready_.end(), last_served_id_);
+        std::rotate(ready_.begin(), first, ready_.end());
+
+        int num_callbacks = 0;
+        for (int64_t id : ready_) {
+            if (options_.max_callbacks_per_poll > 0 && num_callbacks >= options_.max_callbacks_per_poll) {
+                break;
+            }
+            auto it = streams_.find(id);
+            if (it == streams_.end() || it->second->is_removed || !it->second->is_pending) {
+                continue;
+            }
+            Watch &watch = *it->second;
+            int64_t num_read;
+            if (!watch.cursor->ReceiveRead(&num_read)) {
+                continue;
+            }
+            watch.is_pending = false;
+            if (num_read > 0) {
+                Dispatch(&watch, num_read);
+                num_callbacks++;
+            }
+            if (!watch.is_removed && !watch.cursor->Good()) {
+                Dispatch(&watch, -1);
+                num_callbacks++;
+                Remove(id);
+            }
+            last_served_id_ = id;
+        }
+
+        is_polling_ = false;
+        EraseRemovedStreams();
+        ArmDueStreams();
+        return num_callbacks;
+    }
+
+    /**
+     * Polls until #Stop() is called or every stream has reached EOF or been removed.
+     */
+    void Run() {
+        stop_ = false;
+        while (!stop_ && !streams_.empty()) {
+            Poll(kRunPollMs);
+        }
+    }
+
+    /**
+     * Makes #Run() return within about 100 ms. May be called from any thread.
+     */
+    void Stop() {
+        stop_ = true;
+    }
+
+    size_t num_streams() const {
+        return streams_.size();
+    }
+
+private:
+    static constexpr int kRunPollMs = 100;
+
+    typedef struct Watch {
+        int64_t id = 0;
+        Callback callback;
+        std::unique_ptr<internal::StreamCursor> cursor;
+        std::vector<char> buffer;
+        std::vector<int> sizes;
+
+        // Whether an XREAD is outstanding, and when the stream may next be read if not.
+        bool is_pending = false;
+        std::chrono::steady_clock::time_point next_read;
+        bool is_removed = false;
+    } Watch;
+
+    /**
+     * Runs the stream's callback on its batch buffer, or with an EOF batch if `num_read` is negative.
+     */
+    void Dispatch(Watch *watch, int64_t num_read) {
+        StreamBatch batch{};
+        batch.stream_id = watch->id;
+        batch.stream_name = &watch->cursor->stream_name();
+        batch.schema = &watch->cursor->schema();
+        batch.data = watch->buffer.data();
+        batch.num_samples = std::max<int64_t>(num_read, 0);
+        batch.sizes = watch->sizes.data();
+        batch.is_eof = num_read < 0;
+        watch->next_read = std::chrono::steady_clock::now()
+                           + std::chrono::milliseconds(options_.min_batch_interval_ms);
+
+        // Streams removed during Poll() are only erased at its end, so the watch outlives its own callback.
+        watch->callback(batch);
+    }
+
+    void ArmDueStreams() {
+        auto now = std::chrono::steady_clock::now();
+        for (auto &entry : streams_) {
+            Watch &watch = *entry.second;
+            if (!watch.is_removed && !watch.is_pending && watch.cursor->Good() && watch.next_read <= now) {
+                watch.cursor->BeginRead(watch.buffer.data(), options_.max_batch_samples, watch.sizes.data());
+                watch.is_pending = true;
+            }
+        }
+    }
+
+    void EraseRemovedStreams() {
+        for (auto it = streams_.begin(); it != streams_.end();) {
+            if (it->second->is_removed) {
+                it = streams_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    const RedisConnection connection_;
+    ReactorOptions options_;
+    internal::SocketPoller poller_;
+
+    std::map<int64_t, std::unique_ptr<Watch>> streams_;
+    std::vector<int64_t> ready_;
+    int64_t next_id_ = 0;
+    int64_t last_served_id_ = -1;
+    bool is_polling_ = false;
+    std::atomic<bool> stop_{false};
+};
+
+}
+
+#endif //PARENT_REACTOR_H
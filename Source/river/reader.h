@@ -8,12 +8,15 @@
 #include <iostream>
 #include <exception>
 #include <sstream>
+#include <chrono>
 #include <cstdio>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <cstring>
 #include <memory>
 #include "schema.h"
+#include "typed_schema.h"
 #include "redis.h"
 
 namespace river {
@@ -73,7 +76,8 @@ public:
      * If EOF has been reached, then #good() will return false, and any attempts to #read() will return -1.
      *
      * @tparam DataT The data type of the buffer. The `sizeof()` of this type should match the stream's sample size as
-     * governed by its schema.
+     * governed by its schema. For TypedSchema<...>::Record buffers this only checks the size; check
+     * TypedSchema::Matches(schema()) once after #initialize() to also check field names and types.
      * @param num_samples _Maximum_ number of samples to read from the underlying stream.
      * @param sizes If given, <return value> entries will be written into this array containing the sizes of each
      * corresponding sample. Particularly useful for VARIABLE_WIDTH_BYTES fields. Pass nullptr to ignore.
@@ -172,6 +176,60 @@ public:
      */
     int64_t Seek(const std::string &key);
 
+    /**
+     * Seeks the internal cursor so that the next read returns the first sample written at or after `time`, given on
+     * the writer's clock (it is converted to server time with #local_minus_server_clock_us(), at millisecond
+     * resolution). Entry IDs carry the server time, so the position is found with ID-bounded range queries per redis
+     * key rather than by reading through the stream.
+     *
+     * As with #Seek(), the cursor never moves backwards.
+     *
+     * @return the number of elements skipped, as #Seek().
+     */
+    inline int64_t SeekToTime(std::chrono::system_clock::time_point time) {
+        if (!is_initialized_) {
+            throw StreamReaderException("Stream reader was not initialized.");
+        }
+        uint64_t server_ms = internal::ServerMillis(time, local_minus_server_clock_us());
+        if (server_ms == 0) {
+            return 0;
+        }
+        std::string before = std::to_string(server_ms - 1) + "-" + std::to_string(UINT64_MAX);
+
+        std::string key = current_stream_key_;
+        std::string last_data_key;
+        while (!key.empty()) {
+            // The last entry of a key is its tombstone once the writer has moved on. If even that was written before
+            // the target time, the target is in a later key.
+            auto last = redis_->Xrevrange(2, key, "+", 0, 0);
+            if (last == nullptr || last->elements == 0) {
+                break;
+            }
+            const redisReply *last_entry = last->element[0];
+            const char *next_stream_key = FindField(last_entry->element[1], "next_stream_key");
+            uint64_t last_ms, last_seq;
+            internal::DecodeCursor(last_entry->element[0]->str, &last_ms, &last_seq);
+            if (next_stream_key == nullptr || last_ms >= server_ms) {
+                auto preceding = redis_->Xrevrange(2, key, before, 0, 0);
+                for (size_t i = 0; preceding != nullptr && i < preceding->elements; i++) {
+                    if (FindField(preceding->element[i]->element[1], "i") != nullptr) {
+                        return Seek(preceding->element[i]->element[0]->str);
+                    }
+                }
+                break;
+            }
+            for (size_t i = 1; i < last->elements; i++) {
+                if (FindField(last->element[i]->element[1], "i") != nullptr) {
+                    last_data_key = last->element[i]->element[0]->str;
+                }
+            }
+            key = next_stream_key;
+        }
+
+        // The target is at the very start of a key, so position after the last sample of the key before it.
+        return last_data_key.empty() ? 0 : Seek(last_data_key);
+    }
+
     /**
      * Whether this stream has been initialized.
      */
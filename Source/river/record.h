@@ -0,0 +1,270 @@
+#ifndef PARENT_RECORD_H
+#define PARENT_RECORD_H
+
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "schema.h"
+#include "layout.h"
+#include "writer.h"
+#include "reader.h"
+
+namespace river {
+
+/**
+ * Records are samples whose schema mixes fixed-width fields with one or more VARIABLE_WIDTH_BYTES fields. On the wire,
+ * each record is a single VARIABLE_WIDTH_BYTES sample holding the fields in schema order: fixed-width fields as raw
+ * bytes, and variable-width fields as a 4-byte little-endian length followed by that many bytes. The logical (record)
+ * schema is stored as JSON in the stream's user metadata so that readers can decode it.
+ */
+namespace internal {
+
+constexpr const char *kRecordSchemaMetadataKey = "river_record_schema";
+constexpr const char *kRecordFieldName = "record";
+constexpr int kRecordLengthPrefixSize = 4;
+
+inline int MaxRecordSize(const StreamLayout &layout) {
+    return layout.sample_size() + kRecordLengthPrefixSize * layout.num_variable_width_fields();
+}
+
+inline void EncodeRecordLength(uint32_t length, char *dst) {
+    dst[0] = static_cast<char>(length & 0xFF);
+    dst[1] = static_cast<char>((length >> 8) & 0xFF);
+    dst[2] = static_cast<char>((length >> 16) & 0xFF);
+    dst[3] = static_cast<char>((length >> 24) & 0xFF);
+}
+
+inline uint32_t DecodeRecordLength(const char *src) {
+    const auto *p = reinterpret_cast<const unsigned char *>(src);
+    return static_cast<uint32_t>(p[0])
+           | (static_cast<uint32_t>(p[1]) << 8)
+           | (static_cast<uint32_t>(p[2]) << 16)
+           | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+}
+
+/**
+ * Writes records of a schema with mixed fixed- and variable-width fields through an existing StreamWriter. Records
+ * are packed into a scratch buffer owned by this object, which only grows to the largest batch seen; there are no
+ * per-sample allocations.
+ */
+class RecordWriter {
+public:
+    /**
+     * @param writer The underlying writer; must outlive this object and must not have been initialized yet.
+     * @param record_schema The logical schema of each record. Any number of its fields may be VARIABLE_WIDTH_BYTES,
+     * whose size gives the maximum length of that field.
+     */
+    RecordWriter(StreamWriter *writer, const StreamSchema &record_schema)
+            : writer_(writer), record_schema_(record_schema), layout_(record_schema) {}
+
+    /**
+     * The schema actually registered with River: a single VARIABLE_WIDTH_BYTES field large enough for any record.
+     */
+    static StreamSchema PhysicalSchema(const StreamSchema &record_schema) {
+        StreamLayout layout(record_schema);
+        return StreamSchema({FieldDefinition(internal::kRecordFieldName,
+                                             FieldDefinition::VARIABLE_WIDTH_BYTES,
+                                             internal::MaxRecordSize(layout))});
+    }
+
+    /**
+     * Initializes the underlying writer with the physical schema, storing the record schema in its user metadata.
+     */
+    void Initialize(const std::string &stream_name,
+                    std::unordered_map<std::string, std::string> user_metadata =
+                    std::unordered_map<std::string, std::string>()) {
+        user_metadata[internal::kRecordSchemaMetadataKey] = record_schema_.ToJson();
+        writer_->Initialize(stream_name, PhysicalSchema(record_schema_), user_metadata);
+    }
+
+    /**
+     * Packs and writes `num_samples` records.
+     *
+     * @param fixed The fixed-width fields of every record: `num_samples * layout().fixed_width_size()` bytes, with each
+     * record's fixed-width fields in schema order (skipping variable-width fields). May be null if there are none.
+     * @param arena The bytes of all variable-width values.
+     * @param offsets `num_samples * layout().num_variable_width_fields() + 1` entries. Value k (record-major, then in
+     * schema order) spans `arena[offsets[k], offsets[k + 1])`.
+     */
+    void Write(const char *fixed, const char *arena, const int64_t *offsets, int64_t num_samples) {
+        if (num_samples <= 0) {
+            return;
+        }
+        const int num_fields = layout_.num_fields();
+        const int num_variable = layout_.num_variable_width_fields();
+
+        // Upper bound on the packed size; the scratch buffer never shrinks so steady state does not allocate.
+        size_t max_bytes = static_cast<size_t>(num_samples) * layout_.fixed_width_size()
+                           + static_cast<size_t>(num_samples) * num_variable * internal::kRecordLengthPrefixSize
+                           + static_cast<size_t>(offsets[num_samples * num_variable] - offsets[0]);
+        if (scratch_.size() < max_bytes) {
+            scratch_.resize(max_bytes);
+        }
+        if (sizes_.size() < static_cast<size_t>(num_samples)) {
+            sizes_.resize(num_samples);
+        }
+
+        char *out = scratch_.data();
+        const char *fixed_in = fixed;
+        const int64_t *value_offset = offsets;
+        for (int64_t i = 0; i < num_samples; i++) {
+            char *record_start = out;
+            for (int f = 0; f < num_fields; f++) {
+                const FieldLayout &field = layout_.field(f);
+                if (field.type != FieldDefinition::VARIABLE_WIDTH_BYTES) {
+                    memcpy(out, fixed_in, field.size);
+                    out += field.size;
+                    fixed_in += field.size;
+                    continue;
+                }
+
+                int64_t length = value_offset[1] - value_offset[0];
+                if (length < 0 || length > field.size) {
+                    std::stringstream ss;
+                    ss << "Value of field " << field.name << " in record " << i << " has length " << length
+                       << " but must be between 0 and " << field.size;
+                    throw StreamWriterException(ss.str());
+                }
+                internal::EncodeRecordLength(static_cast<uint32_t>(length), out);
+                out += internal::kRecordLengthPrefixSize;
+                memcpy(out, arena + value_offset[0], static_cast<size_t>(length));
+                out += length;
+                value_offset++;
+            }
+            sizes_[i] = static_cast<int>(out - record_start);
+        }
+
+        writer_->WriteBytes(scratch_.data(), num_samples, sizes_.data());
+    }
+
+    const StreamLayout &layout() const {
+        return layout_;
+    }
+
+private:
+    StreamWriter *writer_;
+    const StreamSchema record_schema_;
+    const StreamLayout layout_;
+
+    std::vector<char> scratch_;
+    std::vector<int> sizes_;
+};
+
+/**
+ * Reads records written by RecordWriter through an existing StreamReader. Records are read into one contiguous
+ * caller-owned buffer, and the position of every field is returned as an offset into that buffer, so decoding
+ * neither copies nor allocates per sample.
+ */
+class RecordReader {
+public:
+    /**
+     * @param reader An initialized StreamReader whose stream was written by RecordWriter; must outlive this object.
+     */
+    explicit RecordReader(StreamReader *reader)
+            : reader_(reader), layout_(FetchRecordSchema(reader)) {}
+
+    /**
+     * The number of bytes that `buffer` in #Read() needs per record to be safe for any record.
+     */
+    int max_record_size() const {
+        return internal::MaxRecordSize(layout_);
+    }
+
+    /**
+     * Reads up to `num_samples` records. Semantics (blocking, timeout, return value) match StreamReader::ReadBytes.
+     *
+     * @param buffer Receives the packed records; must hold `num_samples * max_record_size()` bytes.
+     * @param field_offsets `num_samples * layout().num_fields()` entries; entry `i * num_fields + f` receives the offset
+     * into `buffer` where the value of field f of record i starts.
+     * @param field_sizes Same shape as field_offsets; receives the size in bytes of each value. May be null.
+     */
+    int64_t Read(char *buffer,
+                 int64_t num_samples,
+                 int64_t *field_offsets,
+                 int *field_sizes = nullptr,
+                 int timeout_ms = -1) {
+        if (sizes_.size() < static_cast<size_t>(num_samples)) {
+            sizes_.resize(num_samples);
+        }
+        int *sizes = sizes_.data();
+        int64_t num_read = reader_->ReadBytes(buffer, num_samples, &sizes, nullptr, timeout_ms);
+        if (num_read <= 0) {
+            return num_read;
+        }
+
+        const int num_fields = layout_.num_fields();
+        int64_t record_start = 0;
+        for (int64_t i = 0; i < num_read; i++) {
+            // Length prefixes come off the wire, so every step is checked against the bytes actually read for this
+            // record before anything is decoded from or handed out beyond them.
+            const int64_t record_end = record_start + sizes[i];
+            int64_t pos = record_start;
+            int64_t *offsets_out = field_offsets + i * num_fields;
+            int *sizes_out = field_sizes == nullptr ? nullptr : field_sizes + i * num_fields;
+            for (int f = 0; f < num_fields; f++) {
+                const FieldLayout &field = layout_.field(f);
+                int64_t size = field.size;
+                if (field.type == FieldDefinition::VARIABLE_WIDTH_BYTES) {
+                    if (pos + internal::kRecordLengthPrefixSize > record_end) {
+                        ThrowMalformed(i, sizes[i], "length prefix of field " + field.name + " is truncated");
+                    }
+                    size = internal::DecodeRecordLength(buffer + pos);
+                    pos += internal::kRecordLengthPrefixSize;
+                    if (size > field.size) {
+                        ThrowMalformed(i, sizes[i], "field " + field.name + " is longer than its schema allows");
+                    }
+                }
+                if (pos + size > record_end) {
+                    ThrowMalformed(i, sizes[i], "field " + field.name + " runs past the end of the record");
+                }
+                offsets_out[f] = pos;
+                if (sizes_out != nullptr) {
+                    sizes_out[f] = static_cast<int>(size);
+                }
+                pos += size;
+            }
+            if (pos != record_end) {
+                std::stringstream ss;
+                ss << "decoded to " << (pos - record_start) << " bytes";
+                ThrowMalformed(i, sizes[i], ss.str());
+            }
+            record_start = record_end;
+        }
+        return num_read;
+    }
+
+    const StreamLayout &layout() const {
+        return layout_;
+    }
+
+private:
+    [[noreturn]] void ThrowMalformed(int64_t record, int size_read, const std::string &reason) const {
+        std::stringstream ss;
+        ss << "Record " << record << " (" << size_read << " bytes read) is malformed: " << reason << " (stream "
+           << reader_->stream_name() << ")";
+        throw StreamReaderException(ss.str());
+    }
+
+    static StreamSchema FetchRecordSchema(StreamReader *reader) {
+        auto metadata = reader->Metadata();
+        auto it = metadata.find(internal::kRecordSchemaMetadataKey);
+        if (it == metadata.end()) {
+            throw StreamReaderException("Stream " + reader->stream_name() + " was not written by a RecordWriter.");
+        }
+        return StreamSchema::FromJson(it->second);
+    }
+
+    StreamReader *reader_;
+    const StreamLayout layout_;
+
+    std::vector<int> sizes_;
+};
+
+}
+
+#endif //PARENT_RECORD_H
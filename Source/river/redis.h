@@ -7,6 +7,7 @@
 
 #include <sstream>
 #include <cstdlib>
+#include <cstring>
 #include <chrono>
 #include <utility>
 #include <memory>
@@ -15,7 +16,11 @@
 #include "hiredis/hiredis.h"
 
 #if defined(_WIN32) || defined(_WIN64)
+#include <winsock2.h>
 #include <windows.h>
+#else
+#include <sys/socket.h>
+#include <sys/types.h>
 #endif
 
 namespace river {
@@ -35,14 +40,90 @@ public:
 namespace internal {
 
 
+/**
+ * Parses a non-negative decimal integer of exactly `len` characters, without requiring NUL termination.
+ */
+inline bool ParseUint64(const char *str, size_t len, uint64_t *out) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned digit = static_cast<unsigned char>(str[i]) - '0';
+        if (digit > 9) {
+            *out = value;
+            return false;
+        }
+        value = value * 10 + digit;
+    }
+    *out = value;
+    return len > 0;
+}
+
+inline bool ParseInt64(const char *str, size_t len, int64_t *out) {
+    bool negative = len > 0 && str[0] == '-';
+    uint64_t value;
+    bool ok = ParseUint64(str + negative, len - negative, &value);
+    *out = negative ? static_cast<int64_t>(0 - value) : static_cast<int64_t>(value);
+    return ok;
+}
+
+/**
+ * Parses a redis stream ID of the form "<left>-<right>" in place.
+ */
+inline bool ParseStreamId(const char *id, size_t len, uint64_t *left, uint64_t *right) {
+    size_t delimiter_index = len;
+    while (delimiter_index > 0 && id[delimiter_index - 1] != '-') {
+        delimiter_index--;
+    }
+    if (delimiter_index == 0) {
+        ParseUint64(id, len, left);
+        *right = 0;
+        return false;
+    }
+    bool left_ok = ParseUint64(id, delimiter_index - 1, left);
+    bool right_ok = ParseUint64(id + delimiter_index, len - delimiter_index, right);
+    return left_ok && right_ok;
+}
+
 inline void DecodeCursor(const char *key, uint64_t *left, uint64_t *right) {
-    // Increment the LSB part of the cursor for the next fetch
-    std::string last_key = std::string(key);
-    unsigned long delimiter_index = last_key.rfind('-');
-    std::string new_left_str = last_key.substr(0, delimiter_index);
-    std::string new_right_str = last_key.substr(delimiter_index + 1);
-    *left = strtoull(new_left_str.c_str(), nullptr, 10);
-    *right = strtoull(new_right_str.c_str(), nullptr, 10);
+    ParseStreamId(key, strlen(key), left, right);
+}
+
+/**
+ * Writes the decimal representation of `value` to `out` (at most 20 characters, not NUL-terminated) and returns its
+ * length.
+ */
+inline size_t FormatInt64(int64_t value, char *out) {
+    char digits[20];
+    size_t n = 0;
+    bool negative = value < 0;
+    uint64_t v = negative ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+    do {
+        digits[n++] = static_cast<char>('0' + v % 10);
+        v /= 10;
+    } while (v > 0);
+
+    size_t len = 0;
+    if (negative) {
+        out[len++] = '-';
+    }
+    while (n > 0) {
+        out[len++] = digits[--n];
+    }
+    return len;
+}
+
+/**
+ * Appends `data` to `out` as a RESP bulk string and returns the position just past it.
+ */
+inline char *AppendBulk(char *out, const char *data, size_t len) {
+    *out++ = '$';
+    out += FormatInt64(static_cast<int64_t>(len), out);
+    *out++ = '\r';
+    *out++ = '\n';
+    memcpy(out, data, len);
+    out += len;
+    *out++ = '\r';
+    *out++ = '\n';
+    return out;
 }
 
 inline std::chrono::system_clock::time_point KeyTimestamp(const char *key) {
@@ -51,6 +132,31 @@ inline std::chrono::system_clock::time_point KeyTimestamp(const char *key) {
     return std::chrono::system_clock::time_point(std::chrono::milliseconds(static_cast<int64_t>(left)));
 }
 
+/**
+ * Converts a time on a writer's local clock to server time in milliseconds, i.e. the left part of the IDs of entries
+ * written at that time.
+ */
+inline uint64_t ServerMillis(std::chrono::system_clock::time_point local_time, int64_t local_minus_server_clock_us) {
+    int64_t local_us = std::chrono::duration_cast<std::chrono::microseconds>(local_time.time_since_epoch()).count();
+    int64_t server_us = local_us - local_minus_server_clock_us;
+    return server_us <= 0 ? 0 : static_cast<uint64_t>(server_us / 1000);
+}
+
+/**
+ * Looks up the value of `field_name` in the [field, value, ...] array of a stream entry reply.
+ */
+inline const char *FindReplyField(const redisReply *fields, const char *field_name, int *len = nullptr) {
+    for (size_t j = 0; j + 1 < fields->elements; j += 2) {
+        if (strcmp(fields->element[j]->str, field_name) == 0) {
+            if (len != nullptr) {
+                *len = static_cast<int>(fields->element[j + 1]->len);
+            }
+            return fields->element[j + 1]->str;
+        }
+    }
+    return nullptr;
+}
+
  class RedisException : public std::exception {
 public:
     explicit RedisException(const std::string &message) {
@@ -135,6 +241,179 @@ public:
         return UniqueRedisReplyPtr(reply);
     }
 
+    /**
+     * Writes already-encoded commands straight to the socket. Unlike SendCommandArgv, this bypasses hiredis' output
+     * buffer, which is freed and reallocated after every flush. Must not be interleaved with pending appended commands.
+     */
+    inline void SendRaw(const char *data, size_t len) {
+        while (len > 0) {
+#if defined(_WIN32) || defined(_WIN64)
+            int written = ::send(static_cast<SOCKET>(_context->fd), data, static_cast<int>(len), 0);
+#elif defined(MSG_NOSIGNAL)
+            ssize_t written = ::send(_context->fd, data, len, MSG_NOSIGNAL);
+#else
+            ssize_t written = ::send(_context->fd, data, len, 0);
+#endif
+            if (written <= 0) {
+                throw RedisException("Failed to write commands to the redis socket.");
+            }
+            data += written;
+            len -= static_cast<size_t>(written);
+        }
+    }
+
+    /**
+     * Consumes the next `num_replies` replies without building reply objects, so once hiredis' read buffer has grown
+     * to its working size this allocates nothing. Returns the number of error replies among them.
+     */
+    inline int64_t DiscardReplies(int64_t num_replies) {
+        redisReader *reader = _context->reader;
+        redisReplyObjectFunctions *fn = reader->fn;
+        size_t maxbuf = reader->maxbuf;
+
+        // Without object functions, hiredis returns the reply type cast to a pointer instead of allocating a reply;
+        // with maxbuf at 0 it never frees and reallocates its read buffer.
+        reader->fn = nullptr;
+        reader->maxbuf = 0;
+
+        int64_t num_errors = 0;
+        int status = REDIS_OK;
+        for (int64_t i = 0; i < num_replies && status == REDIS_OK; i++) {
+            void *reply = nullptr;
+            status = redisGetReply(_context, &reply);
+            if (status == REDIS_OK && reinterpret_cast<size_t>(reply) == REDIS_REPLY_ERROR) {
+                num_errors++;
+            }
+        }
+
+        reader->fn = fn;
+        reader->maxbuf = maxbuf;
+        if (status != REDIS_OK) {
+            std::stringstream ss;
+            ss << "Error from redis when fetching replies: " << _context->errstr;
+            throw RedisException(ss.str());
+        }
+        return num_errors;
+    }
+
+    /**
+     * Reads the next reply, handing each element to `fn` as hiredis parses it (with `privdata` available as
+     * redisReadTask::privdata) instead of building a redisReply tree. As in #DiscardReplies(), the read buffer is kept
+     * at its working size, so with callbacks that do not allocate this allocates nothing.
+     */
+    inline void DecodeReply(redisReplyObjectFunctions *fn, void *privdata) {
+        redisReader *reader = _context->reader;
+        redisReplyObjectFunctions *saved_fn = reader->fn;
+        void *saved_privdata = reader->privdata;
+        size_t maxbuf = reader->maxbuf;
+
+        reader->fn = fn;
+        reader->privdata = privdata;
+        reader->maxbuf = 0;
+
+        void *reply = nullptr;
+        int status = redisGetReply(_context, &reply);
+
+        reader->fn = saved_fn;
+        reader->privdata = saved_privdata;
+        reader->maxbuf = maxbuf;
+        if (status != REDIS_OK) {
+            std::stringstream ss;
+            ss << "Error from redis when fetching reply: " << _context->errstr;
+            throw RedisException(ss.str());
+        }
+    }
+
+    /**
+     * Non-blocking counterpart of #DecodeReply() for event loops: decodes a reply already in the read buffer, or else
+     * reads the socket once and tries again. Call only when a reply is pending and the socket is readable, so the read
+     * cannot block. Returns false if the reply is still incomplete; the partial parse is kept for the next call, which
+     * must pass the same `fn` and `privdata`.
+     */
+    inline bool TryDecodeReply(redisReplyObjectFunctions *fn, void *privdata) {
+        redisReader *reader = _context->reader;
+        redisReplyObjectFunctions *saved_fn = reader->fn;
+        void *saved_privdata = reader->privdata;
+        size_t maxbuf = reader->maxbuf;
+
+        reader->fn = fn;
+        reader->privdata = privdata;
+        reader->maxbuf = 0;
+
+        void *reply = nullptr;
+        int status = redisGetReplyFromReader(_context, &reply);
+        if (status == REDIS_OK && reply == nullptr) {
+            status = redisBufferRead(_context);
+            if (status == REDIS_OK) {
+                status = redisGetReplyFromReader(_context, &reply);
+            }
+        }
+
+        reader->fn = saved_fn;
+        reader->privdata = saved_privdata;
+        reader->maxbuf = maxbuf;
+        if (status != REDIS_OK) {
+            std::stringstream ss;
+            ss << "Error from redis when fetching reply: " << _context->errstr;
+            throw RedisException(ss.str());
+        }
+        return reply != nullptr;
+    }
+
+    /**
+     * Non-blocking counterpart of #DiscardReplies() for event loops: consumes replies already in the read buffer,
+     * reading the socket at most once, until `num_remaining` reaches zero. Call only when the socket is readable.
+     * Error replies are added to `num_errors`. Returns true once all replies have been consumed.
+     */
+    inline bool TryDiscardReplies(int64_t *num_remaining, int64_t *num_errors) {
+        redisReader *reader = _context->reader;
+        redisReplyObjectFunctions *fn = reader->fn;
+        size_t maxbuf = reader->maxbuf;
+        reader->fn = nullptr;
+        reader->maxbuf = 0;
+
+        bool has_read = false;
+        int status = REDIS_OK;
+        while (*num_remaining > 0) {
+            void *reply = nullptr;
+            status = redisGetReplyFromReader(_context, &reply);
+            if (status != REDIS_OK) {
+                break;
+            }
+            if (reply == nullptr) {
+                if (has_read) {
+                    break;
+                }
+                has_read = true;
+                status = redisBufferRead(_context);
+                if (status != REDIS_OK) {
+                    break;
+                }
+                continue;
+            }
+            if (reinterpret_cast<size_t>(reply) == REDIS_REPLY_ERROR) {
+                (*num_errors)++;
+            }
+            (*num_remaining)--;
+        }
+
+        reader->fn = fn;
+        reader->maxbuf = maxbuf;
+        if (status != REDIS_OK) {
+            std::stringstream ss;
+            ss << "Error from redis when fetching replies: " << _context->errstr;
+            throw RedisException(ss.str());
+        }
+        return *num_remaining == 0;
+    }
+
+    /**
+     * The connection's socket, for waiting on it in an event loop.
+     */
+    inline redisFD fd() const {
+        return _context->fd;
+    }
+
     std::vector<std::string> ListStreamNames(const std::string &stream_filter);
 
     void Unlink(const std::string &stream_key);
@@ -8,6 +8,19 @@
 #include "writer.h"
 #include "reader.h"
 #include "schema.h"
+#include "typed_schema.h"
+#include "layout.h"
+#include "record.h"
+#include "columnar.h"
+#include "decoder.h"
+#include "merge.h"
+#include "range.h"
+#include "group.h"
+#include "view.h"
+#include "window.h"
+#include "reactor.h"
+#include "coro.h"
+#include "prefetch.h"
 #include "redis.h"
 
 #endif //PARENT_RIVER_H
@@ -20,6 +20,9 @@ namespace river {
  * a variable-width bytes (e.g. a dynamic-length string or byte array), then specify VARIABLE_WIDTH_BYTES but this must
  * be your only field; this is for simplicity for handling serialization/deserialization. In this case, the size should
  * correspond to the MAX size possible for this field, which is needed when serializing/deserializing.
+ *
+ * To mix fixed-width fields with one or more VARIABLE_WIDTH_BYTES fields in one sample, use RecordWriter and
+ * RecordReader (record.h), which pack such records into a single variable-width field on the wire.
  */
 typedef struct FieldDefinition {
     std::string name;
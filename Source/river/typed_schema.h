@@ -0,0 +1,219 @@
+#ifndef PARENT_TYPED_SCHEMA_H
+#define PARENT_TYPED_SCHEMA_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include "schema.h"
+
+namespace river {
+
+/**
+ * A fixed-width byte array field, e.g. `Field<kName, FixedBytes<16>>`. Maps to FIXED_WIDTH_BYTES of size N.
+ */
+template<int N>
+struct FixedBytes {
+    static_assert(N > 0, "FixedBytes must have a positive size.");
+    char bytes[N];
+};
+
+namespace internal {
+
+template<class T>
+struct FieldTraits {
+    static_assert(sizeof(T) == 0, "Unsupported field type; use double, float, int32_t, int64_t or FixedBytes<N>.");
+};
+
+template<>
+struct FieldTraits<double> {
+    static constexpr FieldDefinition::Type type = FieldDefinition::DOUBLE;
+};
+
+template<>
+struct FieldTraits<float> {
+    static constexpr FieldDefinition::Type type = FieldDefinition::FLOAT;
+};
+
+template<>
+struct FieldTraits<int32_t> {
+    static constexpr FieldDefinition::Type type = FieldDefinition::INT32;
+};
+
+template<>
+struct FieldTraits<int64_t> {
+    static constexpr FieldDefinition::Type type = FieldDefinition::INT64;
+};
+
+template<int N>
+struct FieldTraits<FixedBytes<N>> {
+    static constexpr FieldDefinition::Type type = FieldDefinition::FIXED_WIDTH_BYTES;
+};
+
+constexpr bool NamesEqual(const char *a, const char *b) {
+    while (*a != '\0' && *a == *b) {
+        ++a;
+        ++b;
+    }
+    return *a == *b;
+}
+
+}
+
+/**
+ * A single named, fixed-width field of a TypedSchema. The name must be a `constexpr char[]` with linkage (e.g. an
+ * `inline constexpr char kChannelIndex[] = "channel_index";` at namespace scope) so it can be used as a template
+ * argument.
+ */
+template<const char *Name, class T>
+struct Field {
+    using type = T;
+    static constexpr const char *name = Name;
+    static constexpr FieldDefinition::Type field_type = internal::FieldTraits<T>::type;
+    static constexpr int size = static_cast<int>(sizeof(T));
+};
+
+/**
+ * A schema known at compile time. It generates a packed Record type whose layout matches the serialized sample
+ * exactly, the sample size as a compile-time constant, and the equivalent runtime StreamSchema:
+ *
+ *   inline constexpr char kChannelIndex[] = "channel_index";
+ *   inline constexpr char kSampleNumber[] = "sample_number";
+ *   using SpikeSchema = TypedSchema<Field<kChannelIndex, int32_t>, Field<kSampleNumber, int64_t>>;
+ *
+ *   SpikeSchema::Record spike;
+ *   spike.Set<kChannelIndex>(3);
+ *   writer.Write(&spike, 1);
+ *
+ * Records can be passed directly to StreamWriter::Write and StreamReader::Read; since their size is checked at
+ * compile time, the per-call runtime size check is skipped.
+ */
+template<class... Fields>
+class TypedSchema {
+public:
+    static_assert(sizeof...(Fields) > 0, "A TypedSchema needs at least one field.");
+
+    static constexpr int num_fields = static_cast<int>(sizeof...(Fields));
+    static constexpr int sample_size = (Fields::size + ...);
+
+    template<int I>
+    using FieldAt = std::tuple_element_t<I, std::tuple<Fields...>>;
+
+    static constexpr std::array<const char *, sizeof...(Fields)> names = {Fields::name...};
+    static constexpr std::array<int, sizeof...(Fields)> sizes = {Fields::size...};
+
+private:
+    static constexpr std::array<int, sizeof...(Fields)> ComputeOffsets() {
+        std::array<int, sizeof...(Fields)> ret{};
+        int offset = 0;
+        for (size_t i = 0; i < ret.size(); i++) {
+            ret[i] = offset;
+            offset += sizes[i];
+        }
+        return ret;
+    }
+
+    static constexpr bool HasUniqueNames() {
+        for (size_t i = 0; i < names.size(); i++) {
+            for (size_t j = i + 1; j < names.size(); j++) {
+                if (internal::NamesEqual(names[i], names[j])) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    static_assert(HasUniqueNames(), "Field names within a TypedSchema must be unique.");
+
+public:
+    static constexpr std::array<int, sizeof...(Fields)> offsets = ComputeOffsets();
+
+    /**
+     * Index of the field with the given name. Fails to compile if no such field exists.
+     */
+    template<const char *Name>
+    static constexpr int IndexOf() {
+        constexpr int index = FindIndex(Name);
+        static_assert(index >= 0, "No field with this name exists in the TypedSchema.");
+        return index;
+    }
+
+    /**
+     * A single sample of this schema. Stored as raw bytes so there is never any padding; accessors compile down to
+     * fixed-offset loads and stores.
+     */
+    class Record {
+    public:
+        using TypedSchemaT = TypedSchema;
+
+        template<int I>
+        typename FieldAt<I>::type GetAt() const {
+            typename FieldAt<I>::type value;
+            memcpy(&value, data_ + offsets[I], sizeof(value));
+            return value;
+        }
+
+        template<int I>
+        void SetAt(const typename FieldAt<I>::type &value) {
+            memcpy(data_ + offsets[I], &value, sizeof(value));
+        }
+
+        template<const char *Name>
+        typename FieldAt<IndexOf<Name>()>::type Get() const {
+            return GetAt<IndexOf<Name>()>();
+        }
+
+        template<const char *Name>
+        void Set(const typename FieldAt<IndexOf<Name>()>::type &value) {
+            SetAt<IndexOf<Name>()>(value);
+        }
+
+        const char *data() const {
+            return data_;
+        }
+
+    private:
+        char data_[sample_size];
+    };
+
+    static_assert(sizeof(Record) == sample_size, "Record must not contain any padding.");
+
+    /**
+     * The runtime schema equivalent to this TypedSchema, e.g. to pass to StreamWriter::Initialize().
+     */
+    static StreamSchema Schema() {
+        return StreamSchema({FieldDefinition(Fields::name, Fields::field_type, Fields::size)...});
+    }
+
+    /**
+     * Whether the given runtime schema (e.g. as read from an existing stream) has exactly this layout.
+     */
+    static bool Matches(const StreamSchema &schema) {
+        static constexpr std::array<FieldDefinition::Type, sizeof...(Fields)> types = {Fields::field_type...};
+        if (static_cast<int>(schema.field_definitions.size()) != num_fields) {
+            return false;
+        }
+        for (int i = 0; i < num_fields; i++) {
+            const FieldDefinition &field = schema.field_definitions[i];
+            if (field.name != names[i] || field.type != types[i] || field.size != sizes[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    static constexpr int FindIndex(const char *name) {
+        for (size_t i = 0; i < names.size(); i++) {
+            if (names[i] == name || internal::NamesEqual(names[i], name)) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+};
+
+}
+
+#endif //PARENT_TYPED_SCHEMA_H
@@ -0,0 +1,216 @@
+#ifndef PARENT_VIEW_H
+#define PARENT_VIEW_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "schema.h"
+#include "reader.h"
+#include "decoder.h"
+#include "redis.h"
+
+namespace river {
+
+/**
+ * The bytes of one sample, pointing into memory owned by a ReadView.
+ */
+typedef struct SampleSpan {
+    const char *data;
+    int size;
+} SampleSpan;
+
+/**
+ * A batch of samples read without copying: each span points directly into the redis reply that delivered it, which
+ * the view keeps alive. The spans are valid until #Release() is called, the view is destroyed, or the view is passed
+ * to ViewReader::Read() again. Move-only.
+ */
+class ReadView {
+public:
+    ReadView() = default;
+    ReadView(ReadView &&) = default;
+    ReadView &operator=(ReadView &&) = default;
+    ReadView(const ReadView &) = delete;
+    ReadView &operator=(const ReadView &) = delete;
+
+    int64_t size() const {
+        return static_cast<int64_t>(spans_.size());
+    }
+
+    bool empty() const {
+        return spans_.empty();
+    }
+
+    const SampleSpan &operator[](int64_t i) const {
+        return spans_[i];
+    }
+
+    std::vector<SampleSpan>::const_iterator begin() const {
+        return spans_.begin();
+    }
+
+    std::vector<SampleSpan>::const_iterator end() const {
+        return spans_.end();
+    }
+
+    /**
+     * Frees the replies backing this view; every span is invalid afterwards. The span storage itself is kept for reuse.
+     */
+    void Release() {
+        spans_.clear();
+        replies_.clear();
+    }
+
+private:
+    friend class ViewReader;
+
+    std::vector<SampleSpan> spans_;
+    std::vector<internal::Redis::UniqueRedisReplyPtr> replies_;
+};
+
+/**
+ * Reads a stream into ReadViews rather than caller buffers, for consumers that only inspect or forward samples and so
+ * have no use for a private copy of each batch. Follows the stream across redis keys like StreamReader.
+ */
+class ViewReader {
+public:
+    /**
+     * @param connection: parameters to connect to Redis
+     * @param max_fetch_size: maximum number of samples to fetch per XREAD.
+     */
+    explicit ViewReader(const RedisConnection &connection, int max_fetch_size = 10000)
+            : connection_(connection), max_fetch_size_(std::max(max_fetch_size, 1)) {}
+
+    /**
+     * Initializes this reader to an existing stream, waiting up to `timeout_ms` for it to be created as in
+     * StreamReader::Initialize.
+     */
+    void Initialize(const std::string &stream_name, int timeout_ms = -1) {
+        redis_ = internal::Redis::Create(connection_);
+        stream_name_ = stream_name;
+        auto metadata = internal::FetchStreamMetadata(redis_.get(), stream_name, timeout_ms);
+        schema_ = std::make_unique<StreamSchema>(StreamSchema::FromJson(metadata->at("schema")));
+        sample_size_ = schema_->sample_size();
+        has_variable_width_field_ = schema_->has_variable_width_field();
+        stream_key_ = metadata->at("first_stream_key");
+        is_initialized_ = true;
+    }
+
+    /**
+     * Reads up to `num_samples` samples into `view`, releasing whatever it held before. Blocking, timeout and EOF
+     * semantics match StreamReader::ReadBytes.
+     *
+     * @return the number of samples in the view, or -1 on EOF.
+     */
+    int64_t Read(ReadView *view, int64_t num_samples, int timeout_ms = -1) {
+        if (!is_initialized_) {
+            throw StreamReaderException("View reader was not initialized.");
+        }
+        view->Release();
+        if (is_eof_) {
+            return -1;
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeout_ms, 0));
+        while (view->size() < num_samples) {
+            int block_ms = 0;
+            if (timeout_ms > 0) {
+                auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        deadline - std::chrono::steady_clock::now()).count();
+                if (remaining <= 0) {
+                    break;
+                }
+                block_ms = static_cast<int>(remaining);
+            }
+
+            int64_t count = std::min<int64_t>(num_samples - view->size(), max_fetch_size_);
+            auto reply = redis_->Xread(count, block_ms, stream_key_, cursor_left_, cursor_right_);
+            if (reply == nullptr || reply->type != REDIS_REPLY_ARRAY || reply->elements == 0) {
+                continue;
+            }
+            const redisReply *entries = reply->element[0]->element[1];
+            std::string next_stream_key;
+            for (size_t i = 0; i < entries->elements; i++) {
+                const redisReply *entry = entries->element[i];
+                internal::DecodeCursor(entry->element[0]->str, &cursor_left_, &cursor_right_);
+                const redisReply *fields = entry->element[1];
+
+                int len = 0;
+                const char *val = internal::FindReplyField(fields, "val", &len);
+                if (val != nullptr) {
+                    if (has_variable_width_field_ ? len > sample_size_ : len != sample_size_) {
+                        std::stringstream ss;
+                        ss << "Sample payload of " << len << " bytes does not match sample size " << sample_size_
+                           << " (stream " << stream_name_ << ")";
+                        throw StreamReaderException(ss.str());
+                    }
+                    view->spans_.push_back(SampleSpan{val, len});
+                } else if (internal::FindReplyField(fields, "eof") != nullptr) {
+                    is_eof_ = true;
+                    break;
+                } else if (const char *next = internal::FindReplyField(fields, "next_stream_key")) {
+                    next_stream_key = next;
+                    break;
+                }
+            }
+            view->replies_.push_back(std::move(reply));
+
+            if (!next_stream_key.empty()) {
+                stream_key_ = next_stream_key;
+                cursor_left_ = 0;
+                cursor_right_ = 0;
+            }
+            if (is_eof_) {
+                break;
+            }
+        }
+
+        num_samples_read_ += view->size();
+        if (view->empty() && is_eof_) {
+            return -1;
+        }
+        return view->size();
+    }
+
+    bool Good() const {
+        return is_initialized_ && !is_eof_;
+    }
+
+    const StreamSchema &schema() const {
+        return *schema_;
+    }
+
+    const std::string &stream_name() const {
+        return stream_name_;
+    }
+
+    int64_t total_samples_read() const {
+        return num_samples_read_;
+    }
+
+private:
+    const RedisConnection connection_;
+    const int max_fetch_size_;
+    std::unique_ptr<internal::Redis> redis_;
+
+    std::string stream_name_;
+    std::unique_ptr<StreamSchema> schema_;
+    int sample_size_ = 0;
+    bool has_variable_width_field_ = false;
+    bool is_initialized_ = false;
+    bool is_eof_ = false;
+    int64_t num_samples_read_ = 0;
+
+    // XREAD is exclusive of the cursor, which is the ID of the last entry consumed.
+    std::string stream_key_;
+    uint64_t cursor_left_ = 0;
+    uint64_t cursor_right_ = 0;
+};
+
+}
+
+#endif //PARENT_VIEW_H
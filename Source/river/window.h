@@ -0,0 +1,193 @@
+#ifndef PARENT_WINDOW_H
+#define PARENT_WINDOW_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "schema.h"
+#include "reader.h"
+#include "decoder.h"
+#include "range.h"
+#include "redis.h"
+
+namespace river {
+
+/**
+ * Keeps the last `window` of a stream locally, for dashboards that redraw the most recent few seconds of a stream.
+ * #Initialize() loads the window once; after that each #Update() only reads the samples appended since the previous
+ * call and drops those that have aged out, instead of rereading the whole window.
+ *
+ * Age is measured on the server clock carried by each sample's entry ID (millisecond resolution), relative to the
+ * newest sample in the window. Fixed-width streams only.
+ */
+class LatestWindow {
+public:
+    /**
+     * @param connection: parameters to connect to Redis
+     * @param window: how much of the stream to keep
+     * @param capacity_samples: maximum number of samples kept; the oldest are dropped first if the window holds more.
+     */
+    LatestWindow(const RedisConnection &connection, std::chrono::milliseconds window, int64_t capacity_samples)
+            : connection_(connection), window_ms_(static_cast<uint64_t>(std::max<int64_t>(window.count(), 0))),
+              capacity_(std::max<int64_t>(capacity_samples, 1)), cursor_(connection) {}
+
+    /**
+     * Initializes this window to an existing stream, waiting up to `timeout_ms` for it to be created as in
+     * StreamReader::Initialize, and loads the samples written in the last `window`.
+     */
+    void Initialize(const std::string &stream_name, int timeout_ms = -1) {
+        RangeReader range(connection_);
+        range.Initialize(stream_name, timeout_ms);
+        if (range.schema().has_variable_width_field()) {
+            throw StreamReaderException("LatestWindow does not support variable-width streams: " + stream_name);
+        }
+        cursor_.Initialize(stream_name, timeout_ms);
+        sample_size_ = cursor_.schema().sample_size();
+        data_.assign(static_cast<size_t>(capacity_ * sample_size_), 0);
+        id_ms_.assign(static_cast<size_t>(capacity_), 0);
+        head_ = 0;
+        count_ = 0;
+
+        // Start the cursor just before the first sample in the window, on the writer's clock like SampleAtTime.
+        auto now = std::chrono::system_clock::now();
+        int64_t first = range.SampleAtTime(now - std::chrono::milliseconds(window_ms_));
+        first = std::max(first, range.num_samples() - capacity_);
+        std::string key;
+        internal::EntryId after;
+        range.Position(first, &key, &after);
+        cursor_.Reposition(key, after.left, after.right);
+        is_initialized_ = true;
+        Update(1);
+    }
+
+    /**
+     * Reads every sample appended since the last update, waiting up to `timeout_ms` for one if there are none yet, and
+     * drops samples that are now older than the window.
+     *
+     * @return the number of new samples, or -1 once the stream has hit EOF and no new samples remain.
+     */
+    int64_t Update(int timeout_ms = 1) {
+        if (!is_initialized_) {
+            throw StreamReaderException("Latest window was not initialized.");
+        }
+        int64_t num_new = Drain(1);
+        if (num_new == 0 && timeout_ms > 1) {
+            num_new = ReadRun(1, timeout_ms);
+            if (num_new > 0) {
+                num_new += std::max<int64_t>(Drain(1), 0);
+            }
+        }
+        if (num_new < 0) {
+            return -1;
+        }
+
+        // Age out from the oldest end.
+        if (count_ > 0) {
+            uint64_t newest_ms = id_ms_[(head_ + count_ - 1) % capacity_];
+            while (count_ > 0 && id_ms_[head_] + window_ms_ < newest_ms) {
+                head_ = (head_ + 1) % capacity_;
+                count_--;
+            }
+        }
+        return num_new;
+    }
+
+    /**
+     * Number of samples in the window.
+     */
+    int64_t size() const {
+        return count_;
+    }
+
+    /**
+     * The `i`th sample in the window, oldest first. Valid until the next #Update().
+     */
+    const char *sample(int64_t i) const {
+        return data_.data() + ((head_ + i) % capacity_) * sample_size_;
+    }
+
+    /**
+     * Server time in milliseconds at which the `i`th sample in the window was written.
+     */
+    uint64_t time_ms(int64_t i) const {
+        return id_ms_[(head_ + i) % capacity_];
+    }
+
+    /**
+     * Copies the window into `buffer`, oldest first; `buffer` must hold `size() * schema().sample_size()` bytes.
+     */
+    int64_t CopyTo(char *buffer) const {
+        int64_t first_run = std::min(count_, capacity_ - head_);
+        memcpy(buffer, sample(0), static_cast<size_t>(first_run * sample_size_));
+        memcpy(buffer + first_run * sample_size_, data_.data(),
+               static_cast<size_t>((count_ - first_run) * sample_size_));
+        return count_;
+    }
+
+    bool Good() const {
+        return is_initialized_ && cursor_.Good();
+    }
+
+    const StreamSchema &schema() const {
+        return cursor_.schema();
+    }
+
+    const std::string &stream_name() const {
+        return cursor_.stream_name();
+    }
+
+private:
+    /**
+     * Reads until the stream has no more samples within `wait_ms`. Returns -1 on EOF with nothing read.
+     */
+    int64_t Drain(int wait_ms) {
+        int64_t num_new = 0;
+        while (true) {
+            int64_t run = capacity_ - (head_ + count_) % capacity_;
+            int64_t n = ReadRun(run, wait_ms);
+            if (n < 0) {
+                return num_new == 0 ? -1 : num_new;
+            }
+            num_new += n;
+            if (n < run) {
+                return num_new;
+            }
+        }
+    }
+
+    /**
+     * Reads up to `max_samples` samples straight into the ring, in its contiguous run after the newest sample. When
+     * the ring is full the run covers the oldest samples, which are overwritten.
+     */
+    int64_t ReadRun(int64_t max_samples, int wait_ms) {
+        int64_t tail = (head_ + count_) % capacity_;
+        int64_t n = cursor_.ReadBytes(data_.data() + tail * sample_size_, max_samples, nullptr, wait_ms,
+                                      id_ms_.data() + tail);
+        if (n > 0) {
+            int64_t overwritten = std::max<int64_t>(count_ + n - capacity_, 0);
+            head_ = (head_ + overwritten) % capacity_;
+            count_ += n - overwritten;
+        }
+        return n;
+    }
+
+    const RedisConnection connection_;
+    const uint64_t window_ms_;
+    const int64_t capacity_;
+    internal::StreamCursor cursor_;
+    bool is_initialized_ = false;
+    int sample_size_ = 0;
+
+    std::vector<char> data_;
+    std::vector<uint64_t> id_ms_;
+    int64_t head_ = 0;
+    int64_t count_ = 0;
+};
+
+}
+
+#endif //PARENT_WINDOW_H
@@ -1,13 +1,16 @@
 #ifndef RIVER_WRITER_H
 #define RIVER_WRITER_H
 
+#include <algorithm>
 #include <cstdio>
 #include <iostream>
 #include <mutex>
 #include <cstring>
 #include <unordered_map>
 #include <memory>
+#include <vector>
 #include "schema.h"
+#include "typed_schema.h"
 #include "redis.h"
 
 namespace river {
@@ -32,6 +35,96 @@ class StreamExistsException : public StreamWriterException {
     using StreamWriterException::StreamWriterException;
 };
 
+/**
+ * Preallocated command buffer for StreamWriter::WriteBytes(data, num_samples, scratch). Size it once for the largest
+ * batch that will be written; batches of up to that many samples are then written without any heap allocations. A
+ * WriteScratch should only be used with one StreamWriter.
+ */
+class WriteScratch {
+public:
+    WriteScratch(int64_t capacity_samples, int sample_size)
+            : capacity_samples_(capacity_samples > 0 ? capacity_samples : 1),
+              bytes_per_sample_(BytesPerSample(sample_size)),
+              commands_(static_cast<size_t>(capacity_samples_) * bytes_per_sample_) {}
+
+    int64_t capacity_samples() const {
+        return capacity_samples_;
+    }
+
+    /**
+     * Bytes preallocated per sample of capacity, for budgeting memory before constructing a WriteScratch.
+     */
+    static size_t BytesPerSample(int sample_size) {
+        return static_cast<size_t>(sample_size) + kMaxCommandOverhead;
+    }
+
+    /**
+     * Longest stream name whose redis stream keys ("<stream_name>-<idx>") fit in the preallocated key buffer.
+     */
+    static constexpr size_t kMaxStreamNameLength = 276;
+
+    /**
+     * Encodes `num_samples` (at most capacity_samples()) XADD commands for the redis stream key
+     * "<stream_name>-<stream_key_idx>" into the command buffer and returns the number of bytes used; see commands().
+     * Allocation-free. Throws StreamWriterException if the stream name is longer than kMaxStreamNameLength, rather
+     * than writing to a different key than the library's own writes.
+     */
+    size_t FormatXadds(const std::string &stream_name,
+                       int stream_key_idx,
+                       int64_t first_sample_index,
+                       const char *data,
+                       int64_t num_samples,
+                       int sample_size) {
+        if (stream_key_idx != stream_key_idx_ || stream_name.size() != stream_key_name_len_
+            || memcmp(stream_key_, stream_name.data(), stream_key_name_len_) != 0) {
+            if (stream_name.size() > kMaxStreamNameLength) {
+                throw StreamWriterException("Stream name " + stream_name + " is too long for preallocated writes.");
+            }
+            size_t name_len = stream_name.size();
+            memcpy(stream_key_, stream_name.data(), name_len);
+            stream_key_[name_len] = '-';
+            stream_key_len_ = name_len + 1 + internal::FormatInt64(stream_key_idx, stream_key_ + name_len + 1);
+            stream_key_idx_ = stream_key_idx;
+            stream_key_name_len_ = name_len;
+        }
+
+        char *out = commands_.data();
+        char index_str[24];
+        for (int64_t i = 0; i < num_samples; i++) {
+            memcpy(out, "*7\r\n$4\r\nXADD\r\n", 14);
+            out = internal::AppendBulk(out + 14, stream_key_, stream_key_len_);
+            memcpy(out, "$1\r\n*\r\n$1\r\ni\r\n", 14);
+            out = internal::AppendBulk(out + 14, index_str, internal::FormatInt64(first_sample_index + i, index_str));
+            memcpy(out, "$3\r\nval\r\n", 9);
+            out = internal::AppendBulk(out + 9, data + i * sample_size, sample_size);
+        }
+        return static_cast<size_t>(out - commands_.data());
+    }
+
+    /**
+     * The commands encoded by the last call to #FormatXadds().
+     */
+    const char *commands() const {
+        return commands_.data();
+    }
+
+private:
+    friend class StreamWriter;
+
+    // Upper bound on the RESP framing of one XADD, including a stream key of up to kMaxStreamNameLength + 21
+    // characters.
+    static constexpr size_t kMaxCommandOverhead = 384;
+
+    const int64_t capacity_samples_;
+    const size_t bytes_per_sample_;
+    std::vector<char> commands_;
+
+    char stream_key_[kMaxStreamNameLength + 24];
+    size_t stream_key_len_ = 0;
+    size_t stream_key_name_len_ = 0;
+    int stream_key_idx_ = -1;
+};
+
 /**
  * The main entry point for River for writing a new stream. Streams are defined by a schema and a stream name, both of
  * which are given in the `initialize()` call. All samples written to this stream must belong to the same schema. Once
@@ -69,6 +162,8 @@ public:
      * written to redis according to each sample size. If the schema has only fixed-width fields, then the data buffer
      * will be advanced according to the fixed-width size given in #initialize(); otherwise (i.e. if it has variable-
      * width fields), the sizes buffer is necessary to determine the size of each sample.
+     *
+     * If DataT is a TypedSchema<...>::Record, initialize with TypedSchema::Schema() so the two agree.
      */
     template <class DataT>
     void Write(DataT *data, int64_t num_samples, const int *sizes = nullptr) {
@@ -84,6 +179,23 @@ public:
      */
     void WriteBytes(const char *data, int64_t num_samples, const int *sizes = nullptr);
 
+    /**
+     * Writes raw bytes of a fixed-width schema like #WriteBytes(), but encodes the commands into the given
+     * preallocated scratch buffer and consumes the replies without building reply objects. Once the scratch buffer
+     * and the connection's read buffer are warm, this performs no heap allocations, except for the rare sample next
+     * to a rollover to the next redis stream key.
+     *
+     * Unlike #WriteBytes(), the XADDs are encoded here rather than in the library, so this path depends on two private
+     * details of the library's writer: data entries go to redis stream key "<stream name>-<idx>", and the writer rolls
+     * over to the next key, writing a tombstone, every `keys_per_redis_stream` samples. Samples at a rollover are
+     * left to the library; a library version that changes either detail must update #SendScratchBatch() to match.
+     *
+     * If redis rejects any of a batch's XADDs, this throws StreamWriterException after counting the whole batch as
+     * written: the accepted samples are already in redis, so their sample indexes must not be reused, and the rejected
+     * ones are lost, leaving gaps in the indexes rather than duplicates.
+     */
+    void WriteBytes(const char *data, int64_t num_samples, WriteScratch &scratch);
+
     /**
      * A copy of the stream's schema that was provided on initialize().
      */
@@ -121,8 +233,21 @@ public:
     void Stop();
 
 private:
+    friend class AsyncStreamWriter;
+
     int64_t ComputeLocalMinusServerClocks();
 
+    /**
+     * Sends the XADDs for the next run of samples of WriteBytes(data, num_samples, scratch) and returns how many
+     * samples it covers. If `is_pending`, their replies are still to be consumed and passed to #FinishScratchBatch();
+     * otherwise the run (a sample next to a rollover) has already been written synchronously.
+     *
+     * Mirrors the library writer's key format and rollover rule; see WriteBytes(data, num_samples, scratch).
+     */
+    int64_t SendScratchBatch(const char *data, int64_t num_samples, WriteScratch &scratch, bool *is_pending);
+
+    void FinishScratchBatch(int64_t num_samples, int64_t num_errors);
+
     std::unique_ptr<internal::Redis> redis_;
 
     const int redis_batch_size_;
@@ -140,6 +265,61 @@ private:
     int last_stream_key_idx_;
 };
 
+inline void StreamWriter::WriteBytes(const char *data, int64_t num_samples, WriteScratch &scratch) {
+    while (num_samples > 0) {
+        bool is_pending;
+        int64_t n = SendScratchBatch(data, num_samples, scratch, &is_pending);
+        if (is_pending) {
+            FinishScratchBatch(n, redis_->DiscardReplies(n));
+        }
+        data += n * sample_size_;
+        num_samples -= n;
+    }
+}
+
+inline int64_t StreamWriter::SendScratchBatch(const char *data,
+                                              int64_t num_samples,
+                                              WriteScratch &scratch,
+                                              bool *is_pending) {
+    if (!is_initialized_) {
+        throw StreamWriterException("Stream is not yet initialized. Call #Initialize() first.");
+    }
+    if (is_stopped_) {
+        throw StreamWriterException("Stream has already been stopped. Do not reuse these objects.");
+    }
+    if (has_variable_width_field_) {
+        throw StreamWriterException("Preallocated writes only support schemas without variable-width fields.");
+    }
+
+    // Samples next to a rollover to the next redis stream key go through the regular path, which also writes the
+    // tombstone entry that moves readers on to the new key.
+    int64_t position = total_samples_written_ % keys_per_redis_stream_;
+    int64_t before_rollover = keys_per_redis_stream_ - 1 - position;
+    if (before_rollover <= 0 || (position == 0 && total_samples_written_ > 0)) {
+        WriteBytes(data, 1);
+        *is_pending = false;
+        return 1;
+    }
+
+    int64_t n = std::min({num_samples, before_rollover, scratch.capacity_samples()});
+    size_t len = scratch.FormatXadds(
+            stream_name_, last_stream_key_idx_, total_samples_written_, data, n, sample_size_);
+    redis_->SendRaw(scratch.commands_.data(), len);
+    *is_pending = true;
+    return n;
+}
+
+inline void StreamWriter::FinishScratchBatch(int64_t num_samples, int64_t num_errors) {
+    // The accepted XADDs are in redis whether or not some failed, so their indexes are spent either way.
+    total_samples_written_ += num_samples;
+    if (num_errors > 0) {
+        std::stringstream ss;
+        ss << "Redis returned " << num_errors << " errors when writing " << num_samples << " samples to stream "
+           << stream_name_;
+        throw StreamWriterException(ss.str());
+    }
+}
+
 }
 
 #endif //RIVER_WRITER_H
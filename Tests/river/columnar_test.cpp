@@ -0,0 +1,137 @@
+//
+// Checks that the frame interleaving kernels used for continuous export agree with their scalar definitions: every
+// int16 output of InterleaveFramesInt16 must equal QuantizeInt16(value * inv_scale), whether it came from the SIMD
+// tiles or the scalar tails, and InterleaveFrames must copy floats bit for bit. Needs no Redis server.
+//
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include "columnar.h"
+
+static int num_failures = 0;
+
+static void Check(bool condition, const char *what, int num_channels, int64_t num_frames, int64_t i, int c) {
+    if (!condition) {
+        std::fprintf(stderr, "FAILED: %s (channels %d, frames %lld, frame %lld, channel %d)\n", what, num_channels,
+                     static_cast<long long>(num_frames), static_cast<long long>(i), c);
+        num_failures++;
+    }
+}
+
+static void Check(bool condition, const char *what) {
+    Check(condition, what, 0, 0, 0, 0);
+}
+
+// Values that are easy to get wrong: NaN, infinities, out of int16 range, and exact halves (ties to even).
+static const float kSpecialValues[] = {
+        std::numeric_limits<float>::quiet_NaN(),
+        std::numeric_limits<float>::infinity(),
+        -std::numeric_limits<float>::infinity(),
+        40000.0f, -40000.0f, 32767.5f, -32768.5f, 32768.0f, -32769.0f, 1e30f, -1e30f,
+        0.5f, 1.5f, 2.5f, -0.5f, -1.5f, -2.5f, 32766.5f, -32767.5f,
+        0.0f, -0.0f, 1.0f, -1.0f, 123.25f, -4567.75f,
+};
+static const int kNumSpecialValues = sizeof(kSpecialValues) / sizeof(kSpecialValues[0]);
+
+// Powers of two keep value * inv_scale exact, so ties stay ties after scaling.
+static const float kInvScales[] = {1.0f, 2.0f, 0.25f, 1.0f, 0.5f, 4.0f, 1.0f, 0.125f, 1.0f};
+
+static std::vector<std::vector<float>> MakeChannels(int num_channels, int64_t num_frames) {
+    std::vector<std::vector<float>> channels(num_channels, std::vector<float>(static_cast<size_t>(num_frames)));
+    int k = 0;
+    for (int64_t i = 0; i < num_frames; i++) {
+        for (int c = 0; c < num_channels; c++) {
+            // Cycle through the special values so each lands in both SIMD tiles and scalar tails.
+            channels[c][i] = kSpecialValues[k++ % kNumSpecialValues];
+            if ((i + c) % 5 == 4) {
+                channels[c][i] = static_cast<float>(c * 1000 + i) * 0.37f - 300.0f;
+            }
+        }
+    }
+    return channels;
+}
+
+static void CheckInt16(int num_channels, int64_t num_frames) {
+    auto channels = MakeChannels(num_channels, num_frames);
+    std::vector<const float *> pointers;
+    for (const auto &channel : channels) {
+        pointers.push_back(channel.data());
+    }
+
+    const int64_t first_sample = -7;
+    const int64_t sample_step = 3;
+    const size_t stride = sizeof(int64_t) + sizeof(int16_t) * num_channels;
+    std::vector<char> frames(stride * static_cast<size_t>(num_frames) + 1);
+    river::internal::InterleaveFramesInt16(pointers.data(), kInvScales, num_channels, num_frames, first_sample,
+                                           frames.data(), sample_step);
+
+    for (int64_t i = 0; i < num_frames; i++) {
+        int64_t sample_number;
+        memcpy(&sample_number, frames.data() + i * stride, sizeof(sample_number));
+        Check(sample_number == first_sample + i * sample_step, "int16 frame sample number", num_channels, num_frames,
+              i, -1);
+        for (int c = 0; c < num_channels; c++) {
+            int16_t value;
+            memcpy(&value, frames.data() + i * stride + sizeof(int64_t) + c * sizeof(int16_t), sizeof(value));
+            int16_t expected = river::internal::QuantizeInt16(channels[c][i] * kInvScales[c]);
+            Check(value == expected, "int16 value matches QuantizeInt16", num_channels, num_frames, i, c);
+        }
+    }
+}
+
+static void CheckFloat(int num_channels, int64_t num_frames) {
+    auto channels = MakeChannels(num_channels, num_frames);
+    std::vector<const float *> pointers;
+    for (const auto &channel : channels) {
+        pointers.push_back(channel.data());
+    }
+
+    const int64_t first_sample = int64_t{1} << 33;
+    const int64_t sample_step = 30;
+    const size_t stride = sizeof(int64_t) + sizeof(float) * num_channels;
+    std::vector<char> frames(stride * static_cast<size_t>(num_frames) + 1);
+    river::internal::InterleaveFrames(pointers.data(), num_channels, num_frames, first_sample, frames.data(),
+                                      sample_step);
+
+    for (int64_t i = 0; i < num_frames; i++) {
+        int64_t sample_number;
+        memcpy(&sample_number, frames.data() + i * stride, sizeof(sample_number));
+        Check(sample_number == first_sample + i * sample_step, "float frame sample number", num_channels, num_frames,
+              i, -1);
+        for (int c = 0; c < num_channels; c++) {
+            Check(memcmp(frames.data() + i * stride + sizeof(int64_t) + c * sizeof(float), &channels[c][i],
+                         sizeof(float)) == 0,
+                  "float value round-trips", num_channels, num_frames, i, c);
+        }
+    }
+}
+
+int main() {
+    // The scalar definition itself: ties to even, saturation, and NaN as the SIMD conversion gives it.
+    using river::internal::QuantizeInt16;
+    Check(QuantizeInt16(std::numeric_limits<float>::quiet_NaN()) == INT16_MIN, "QuantizeInt16(NaN)");
+    Check(QuantizeInt16(std::numeric_limits<float>::infinity()) == INT16_MAX, "QuantizeInt16(inf)");
+    Check(QuantizeInt16(-std::numeric_limits<float>::infinity()) == INT16_MIN, "QuantizeInt16(-inf)");
+    Check(QuantizeInt16(40000.0f) == INT16_MAX && QuantizeInt16(-40000.0f) == INT16_MIN, "QuantizeInt16 saturates");
+    Check(QuantizeInt16(0.5f) == 0 && QuantizeInt16(1.5f) == 2 && QuantizeInt16(2.5f) == 2, "QuantizeInt16 ties");
+    Check(QuantizeInt16(-0.5f) == 0 && QuantizeInt16(-1.5f) == -2 && QuantizeInt16(-2.5f) == -2,
+          "QuantizeInt16 negative ties");
+    Check(QuantizeInt16(32766.5f) == 32766, "QuantizeInt16 tie near the top of the range");
+
+    // Channel and frame counts that are not multiples of 4 exercise the SIMD tiles and both scalar tails together.
+    for (int num_channels : {1, 3, 4, 5, 7, 9}) {
+        for (int64_t num_frames : {0, 1, 3, 4, 11, 29}) {
+            CheckInt16(num_channels, num_frames);
+            CheckFloat(num_channels, num_frames);
+        }
+    }
+
+    if (num_failures == 0) {
+        std::printf("columnar_test: ok\n");
+    }
+    return num_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+//
+// Checks that the preallocated XADD encoding used by RiverWriterThread is correct and makes no heap allocations once
+// its WriteScratch exists. Needs no Redis server.
+//
+// This covers the encoding only. StreamWriter::SendScratchBatch/FinishScratchBatch, Redis::SendRaw/DiscardReplies and
+// the RiverWriterThread flush loop are not exercised: StreamWriter and Redis are constructed by the prebuilt River
+// library, and the reply parsing is hiredis', and the repository ships both only as Windows binaries. Their
+// allocation behaviour is untested.
+//
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include "writer.h"
+
+static std::atomic<int64_t> num_allocations{0};
+
+void *operator new(size_t size) {
+    num_allocations++;
+    if (void *p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+    std::free(p);
+}
+
+static int num_failures = 0;
+
+static void Check(bool condition, const char *what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAILED: %s\n", what);
+        num_failures++;
+    }
+}
+
+static std::string Bulk(const std::string &s) {
+    return "$" + std::to_string(s.size()) + "\r\n" + s + "\r\n";
+}
+
+static std::string ExpectedXadd(const std::string &key, int64_t index, const std::string &value) {
+    return "*7\r\n" + Bulk("XADD") + Bulk(key) + Bulk("*") + Bulk("i") + Bulk(std::to_string(index)) + Bulk("val")
+           + Bulk(value);
+}
+
+int main() {
+    const int sample_size = 16;
+    const int capacity = 4096;
+    const std::string stream_name = "Red-123";
+
+    std::vector<char> data(static_cast<size_t>(capacity) * sample_size);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<char>(i * 7);
+    }
+
+    river::WriteScratch scratch(capacity, sample_size);
+
+    // Encoding of a small batch, byte for byte.
+    size_t len = scratch.FormatXadds(stream_name, 0, 41, data.data(), 2, sample_size);
+    std::string expected = ExpectedXadd(stream_name + "-0", 41, std::string(data.data(), sample_size))
+                           + ExpectedXadd(stream_name + "-0", 42, std::string(data.data() + sample_size, sample_size));
+    Check(std::string(scratch.commands(), len) == expected, "XADD encoding");
+
+    // Full batches, across key changes and large or negative indexes, allocate nothing.
+    num_allocations = 0;
+    size_t total = 0;
+    for (int key = 0; key < 3; key++) {
+        total += scratch.FormatXadds(stream_name, key, int64_t{1} << 40, data.data(), capacity, sample_size);
+        total += scratch.FormatXadds(stream_name, key, -1, data.data(), capacity, sample_size);
+    }
+    char digits[24];
+    char bulk[64];
+    total += river::internal::FormatInt64(INT64_MIN, digits);
+    total += static_cast<size_t>(river::internal::AppendBulk(bulk, "abc", 3) - bulk);
+    int64_t allocations = num_allocations;
+    Check(allocations == 0, "FormatXadds/FormatInt64/AppendBulk allocate nothing");
+    Check(total > 0, "batches were encoded");
+
+    Check(std::string(digits, river::internal::FormatInt64(INT64_MIN, digits)) == "-9223372036854775808",
+          "FormatInt64(INT64_MIN)");
+
+    // A name whose keys would not fit must be rejected, not truncated.
+    bool threw = false;
+    try {
+        scratch.FormatXadds(std::string(river::WriteScratch::kMaxStreamNameLength + 1, 'x'), 0, 0, data.data(), 1,
+                            sample_size);
+    } catch (const river::StreamWriterException &) {
+        threw = true;
+    }
+    Check(threw, "overlong stream name throws");
+
+    std::string longest(river::WriteScratch::kMaxStreamNameLength, 'y');
+    len = scratch.FormatXadds(longest, 2147483647, 0, data.data(), 1, sample_size);
+    Check(std::string(scratch.commands(), len)
+          == ExpectedXadd(longest + "-2147483647", 0, std::string(data.data(), sample_size)),
+          "longest stream name is encoded in full");
+
+    if (num_failures == 0) {
+        std::printf("write_scratch_test: ok\n");
+    }
+    return num_failures == 0 ? 0 : 1;
+}